@@ -2,7 +2,7 @@
 -- Systems
 
 CREATE TABLE Accounts(
-  id SERIAL PRIMARY KEY,
+  id BIGINT PRIMARY KEY,
   created_at INTEGER NOT NULL,
   active BOOLEAN DEFAULT true,
   username VARCHAR(64) UNIQUE NOT NULL,
@@ -11,5 +11,4 @@ CREATE TABLE Accounts(
   last_name VARCHAR(64) NOT NULL
 );
 
-CREATE INDEX idx_created_at ON Accounts(created_at);
 CREATE INDEX idx_username ON Accounts(username);
@@ -9,11 +9,14 @@
 using namespace gen;
 
 namespace account_service {
-class Client : public BaseClient<TAccountServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TAccountServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TAccountServiceClient>(ip_address, port, conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TAccountServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   TAccount authenticate_user(const TRequestMetadata& request_metadata,
                              const std::string& username,
@@ -35,21 +38,21 @@ class Client : public BaseClient<TAccountServiceClient> {
   }
 
   TAccount retrieve_standard_account(const TRequestMetadata& request_metadata,
-                                     const int32_t account_id) {
+                                     const int64_t account_id) {
     TAccount _return;
     _client->retrieve_standard_account(_return, request_metadata, account_id);
     return _return;
   }
 
   TAccount retrieve_expanded_account(const TRequestMetadata& request_metadata,
-                                     const int32_t account_id) {
+                                     const int64_t account_id) {
     TAccount _return;
     _client->retrieve_expanded_account(_return, request_metadata, account_id);
     return _return;
   }
 
   TAccount update_account(const TRequestMetadata& request_metadata,
-                          const int32_t account_id, const std::string& password,
+                          const int64_t account_id, const std::string& password,
                           const std::string& first_name,
                           const std::string& last_name) {
     TAccount _return;
@@ -59,7 +62,7 @@ class Client : public BaseClient<TAccountServiceClient> {
   }
 
   void delete_account(const TRequestMetadata& request_metadata,
-                      const int32_t account_id) {
+                      const int64_t account_id) {
     _client->delete_account(request_metadata, account_id);
   }
 
@@ -71,5 +74,15 @@ class Client : public BaseClient<TAccountServiceClient> {
     _client->list_accounts(_return, request_metadata, query, limit, offset);
     return _return;
   }
+
+  TAccountPage list_accounts_page(const TRequestMetadata& request_metadata,
+                                  const TAccountQuery& query,
+                                  const int32_t limit,
+                                  const std::string& cursor) {
+    TAccountPage _return;
+    _client->list_accounts_page(_return, request_metadata, query, limit,
+                                cursor);
+    return _return;
+  }
 };
 }  // namespace account_service
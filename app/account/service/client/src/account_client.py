@@ -7,9 +7,14 @@ from buzzblog.base_client import BaseClient
 
 class Client(BaseClient):
 
-  def __init__(self, ip_address, port, timeout=30000, connection_pool=None):
+  def __init__(self,
+               ip_address,
+               port,
+               timeout=30000,
+               connection_pool=None,
+               framed=False):
     super().__init__(TAccountService.Client, ip_address, port, timeout,
-                     connection_pool)
+                     connection_pool, framed)
 
   def authenticate_user(self, request_metadata, username, password):
     return self._tclient.authenticate_user(request_metadata=request_metadata,
@@ -49,3 +54,9 @@ class Client(BaseClient):
                                        query=query,
                                        limit=limit,
                                        offset=offset)
+
+  def list_accounts_page(self, request_metadata, query, limit, cursor):
+    return self._tclient.list_accounts_page(request_metadata=request_metadata,
+                                            query=query,
+                                            limit=limit,
+                                            cursor=cursor)
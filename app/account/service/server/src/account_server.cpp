@@ -1,18 +1,20 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
 #include <buzzblog/gen/TAccountService.h>
+#include <buzzblog/id_generator.h>
 #include <buzzblog/microservice_connected_server.h>
 #include <buzzblog/postgres_connected_server.h>
+#include <buzzblog/slow_query_log.h>
+#include <buzzblog/thrift_server.h>
 #include <buzzblog/utils.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
 #include <cxxopts.hpp>
-#include <future>
 #include <string>
 
 using namespace apache::thrift;
@@ -27,6 +29,8 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
                                public TAccountServiceIf {
  private:
   std::shared_ptr<spdlog::logger> _rpc_logger;
+  // Max number of items (e.g., accounts of a list) expanded at once.
+  int _max_parallelism;
   std::shared_ptr<spdlog::logger> _query_logger;
 
   bool validate_attributes(const std::string& username,
@@ -39,12 +43,76 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
             last_name.size() > 0 && last_name.size() <= 32);
   }
 
-  std::string build_where_clause(const TAccountQuery& query) {
-    std::ostringstream where_clause;
-    where_clause << "active = true";
-    if (query.__isset.username)
-      where_clause << " AND username = '" << query.username << "'";
-    return where_clause.str();
+  // Retrieves the follow, post, and like activity of an account concurrently.
+  Task<TAccount> expand_account(const TRequestMetadata& request_metadata,
+                                TAccount account, const std::string lf) {
+    auto activity = co_await when_all(
+        CO_RPC_WRAPPER<bool>(
+            co_rpc_check_follow(request_metadata, account.id,
+                                request_metadata.requester_id),
+            _rpc_logger,
+            "ls=account lf=" + lf + " rs=follow rf=check_follow rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<int32_t>(
+            co_rpc_count_followers(request_metadata, account.id), _rpc_logger,
+            "ls=account lf=" + lf + " rs=follow rf=count_followers rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<int32_t>(
+            co_rpc_count_followees(request_metadata, account.id), _rpc_logger,
+            "ls=account lf=" + lf + " rs=follow rf=count_followees rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<int32_t>(
+            co_rpc_count_posts_by_author(request_metadata, account.id),
+            _rpc_logger,
+            "ls=account lf=" + lf + " rs=post rf=count_posts_by_author rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<int32_t>(
+            co_rpc_count_likes_by_account(request_metadata, account.id),
+            _rpc_logger,
+            "ls=account lf=" + lf + " rs=like rf=count_likes_by_account rid=" +
+                request_metadata.id));
+
+    // Build account (expanded mode).
+    account.__set_follows_you(std::get<0>(activity));
+    account.__set_n_followers(std::get<1>(activity));
+    account.__set_n_following(std::get<2>(activity));
+    account.__set_n_posts(std::get<3>(activity));
+    account.__set_n_likes(std::get<4>(activity));
+    co_return account;
+  }
+
+  // Also checks whether the requester follows a listed account.
+  Task<TAccount> expand_listed_account(const TRequestMetadata& request_metadata,
+                                       TAccount account) {
+    auto res = co_await when_all(
+        CO_RPC_WRAPPER<bool>(
+            co_rpc_check_follow(request_metadata, request_metadata.requester_id,
+                                account.id),
+            _rpc_logger,
+            "ls=account lf=list_accounts rs=follow rf=check_follow rid=" +
+                request_metadata.id),
+        expand_account(request_metadata, account, "list_accounts"));
+    auto expanded = std::get<1>(res);
+    expanded.followed_by_you = std::get<0>(res);
+    co_return expanded;
+  }
+
+  // Builds listed accounts (expanded mode) from their rows, retrieving their
+  // follow, post, and like activity a bounded number of accounts at a time.
+  std::vector<TAccount> expand_listed_accounts(
+      const TRequestMetadata& request_metadata, const pqxx::result& db_res) {
+    std::vector<Task<TAccount>> accounts;
+    for (auto row : db_res) {
+      TAccount account;
+      account.id = row["id"].as<int64_t>();
+      account.created_at = row["created_at"].as<int>();
+      account.active = row["active"].as<bool>();
+      account.username = row["username"].as<std::string>();
+      account.first_name = row["first_name"].as<std::string>();
+      account.last_name = row["last_name"].as<std::string>();
+      accounts.push_back(expand_listed_account(request_metadata, account));
+    }
+    return sync_wait(when_all(std::move(accounts), _max_parallelism));
   }
 
  public:
@@ -57,7 +125,7 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
                          const int postgres_connection_pool_allow_ephemeral,
                          const std::string& postgres_user,
                          const std::string& postgres_password,
-                         const int logging)
+                         const int max_parallelism, const int logging)
       : MicroserviceConnectedServer(
             "account", backend_filepath, microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
@@ -66,34 +134,91 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
                                 postgres_connection_pool_min_size,
                                 postgres_connection_pool_max_size,
                                 postgres_connection_pool_allow_ephemeral != 0,
-                                postgres_user, postgres_password, logging) {
+                                postgres_user, postgres_password, false,
+                                logging) {
+    _max_parallelism = max_parallelism;
     if (logging) {
-      _rpc_logger = spdlog::basic_logger_mt("rpc_logger", "/tmp/rpc.log");
-      _rpc_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
-      _query_logger = spdlog::basic_logger_mt("query_logger", "/tmp/query.log");
-      _query_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _rpc_logger = get_logger("rpc_logger", "/tmp/rpc.log");
+      _query_logger = get_logger("query_logger", "/tmp/query.log");
     } else {
       _rpc_logger = nullptr;
       _query_logger = nullptr;
     }
+
+    // Declare prepared statements. Ids are generated by the service and sort by
+    // creation time.
+    prepare("authenticate_user",
+            "SELECT id, created_at, active, password, first_name, last_name "
+            "FROM Accounts "
+            "WHERE username = $1",
+            READ_QUERY);
+    prepare("create_account",
+            "INSERT INTO Accounts (id, created_at, username, password, "
+            "first_name, last_name) "
+            "VALUES ($1, extract(epoch from now()), $2, $3, $4, $5) "
+            "RETURNING id, created_at",
+            WRITE_QUERY);
+    prepare("retrieve_standard_account",
+            "SELECT created_at, active, username, first_name, last_name "
+            "FROM Accounts "
+            "WHERE id = $1",
+            READ_QUERY);
+    prepare("update_account",
+            "UPDATE Accounts "
+            "SET password = $1, first_name = $2, last_name = $3 "
+            "WHERE id = $4 "
+            "RETURNING created_at, active, username",
+            WRITE_QUERY);
+    prepare("delete_account",
+            "UPDATE Accounts "
+            "SET active = FALSE "
+            "WHERE id = $1 "
+            "RETURNING id",
+            WRITE_QUERY);
+    prepare("list_accounts",
+            "SELECT id, created_at, active, username, first_name, last_name "
+            "FROM Accounts "
+            "WHERE active = true "
+            "ORDER BY id DESC "
+            "LIMIT $1 "
+            "OFFSET $2",
+            READ_QUERY);
+    prepare("list_accounts_by_username",
+            "SELECT id, created_at, active, username, first_name, last_name "
+            "FROM Accounts "
+            "WHERE active = true AND username = $1 "
+            "ORDER BY id DESC "
+            "LIMIT $2 "
+            "OFFSET $3",
+            READ_QUERY);
+    prepare("list_accounts_before",
+            "SELECT id, created_at, active, username, first_name, last_name "
+            "FROM Accounts "
+            "WHERE active = true AND id < $1 "
+            "ORDER BY id DESC "
+            "LIMIT $2",
+            READ_QUERY);
+    prepare("list_accounts_by_username_before",
+            "SELECT id, created_at, active, username, first_name, last_name "
+            "FROM Accounts "
+            "WHERE active = true AND username = $1 AND id < $2 "
+            "ORDER BY id DESC "
+            "LIMIT $3",
+            READ_QUERY);
   }
 
   void authenticate_user(TAccount& _return,
                          const TRequestMetadata& request_metadata,
                          const std::string& username,
                          const std::string& password) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT id, created_at, active, password, first_name, last_name "
-        "FROM Accounts "
-        "WHERE username = '%s'";
-    sprintf(query_str, query_fmt, username.c_str());
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TAccountServiceHandler::run_query, this, std::ref(query_str),
-                  "account"),
+        [&] {
+          return run_prepared("authenticate_user", "account", request_metadata,
+                              "authenticate_user", username);
+        },
         _query_logger,
         "ls=account lf=authenticate_user db=account qt=select rid=" +
             request_metadata.id);
@@ -110,7 +235,7 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
       throw TAccountInvalidCredentialsException();
 
     // Build account (standard mode).
-    _return.id = db_res[0][0].as<int>();
+    _return.id = db_res[0][0].as<int64_t>();
     _return.created_at = db_res[0][1].as<int>();
     _return.active = true;
     _return.username = username;
@@ -124,35 +249,31 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
                       const std::string& username, const std::string& password,
                       const std::string& first_name,
                       const std::string& last_name) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Validate attributes.
     if (!validate_attributes(username, password, first_name, last_name))
       throw TAccountInvalidAttributesException();
 
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "INSERT INTO Accounts (created_at, username, password, first_name, "
-        "last_name) "
-        "VALUES (extract(epoch from now()), '%s', '%s', '%s', '%s') "
-        "RETURNING id, created_at";
-    sprintf(query_str, query_fmt, username.c_str(), password.c_str(),
-            first_name.c_str(), last_name.c_str());
-
     // Execute query.
     pqxx::result db_res;
     try {
       db_res = RPC_WRAPPER<pqxx::result>(
-          std::bind(&TAccountServiceHandler::run_query, this,
-                    std::ref(query_str), "account"),
+          [&] {
+            return run_prepared(
+                "create_account", "account", request_metadata, "create_account",
+                IdGenerator::instance().next(), username, password, first_name,
+                last_name);
+          },
           _query_logger,
           "ls=account lf=create_account db=account qt=insert rid=" +
               request_metadata.id);
-    } catch (pqxx::sql_error& e) {
+    } catch (pqxx::unique_violation& e) {
       throw TAccountUsernameAlreadyExistsException();
     }
 
     // Build account (standard mode).
-    _return.id = db_res[0][0].as<int>();
+    _return.id = db_res[0][0].as<int64_t>();
     _return.created_at = db_res[0][1].as<int>();
     _return.active = true;
     _return.username = username;
@@ -163,19 +284,16 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_standard_account(TAccount& _return,
                                  const TRequestMetadata& request_metadata,
-                                 int32_t account_id) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT created_at, active, username, first_name, last_name "
-        "FROM Accounts "
-        "WHERE id = %d";
-    sprintf(query_str, query_fmt, account_id);
+                                 int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TAccountServiceHandler::run_query, this, std::ref(query_str),
-                  "account"),
+        [&] {
+          return run_prepared("retrieve_standard_account", "account",
+                              request_metadata, "retrieve_standard_account",
+                              account_id);
+        },
         _query_logger,
         "ls=account lf=retrieve_standard_account db=account qt=select rid=" +
             request_metadata.id);
@@ -206,75 +324,24 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_expanded_account(TAccount& _return,
                                  const TRequestMetadata& request_metadata,
-                                 int32_t account_id) {
+                                 int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Retrieve standard account.
     retrieve_standard_account(_return, request_metadata, account_id);
 
-    // Retrieve follow activity in separate threads.
-    auto follows_you_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<bool>(
-          std::bind(&TAccountServiceHandler::rpc_check_follow, this,
-                    std::ref(request_metadata), std::ref(account_id),
-                    std::ref(request_metadata.requester_id)),
-          _rpc_logger,
-          "ls=account lf=retrieve_expanded_account rs=follow rf=check_follow "
-          "rid=" +
-              request_metadata.id);
-    });
-    auto n_followers_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<int32_t>(
-          std::bind(&TAccountServiceHandler::rpc_count_followers, this,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_logger,
-          "ls=account lf=retrieve_expanded_account rs=follow "
-          "rf=count_followers rid=" +
-              request_metadata.id);
-    });
-    auto n_following_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<int32_t>(
-          std::bind(&TAccountServiceHandler::rpc_count_followees, this,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_logger,
-          "ls=account lf=retrieve_expanded_account rs=follow "
-          "rf=count_followees rid=" +
-              request_metadata.id);
-    });
-
-    // Retrieve post activity in a separate thread.
-    auto n_posts_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<int32_t>(
-          std::bind(&TAccountServiceHandler::rpc_count_posts_by_author, this,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_logger,
-          "ls=account lf=retrieve_expanded_account rs=post "
-          "rf=count_posts_by_author rid=" +
-              request_metadata.id);
-    });
-
-    // Retrieve like activity in a separate thread.
-    auto n_likes_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<int32_t>(
-          std::bind(&TAccountServiceHandler::rpc_count_likes_by_account, this,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_logger,
-          "ls=account lf=retrieve_expanded_account rs=like "
-          "rf=count_likes_by_account rid=" +
-              request_metadata.id);
-    });
-
-    // Build account (expanded mode).
-    _return.__set_follows_you(follows_you_future.get());
-    _return.__set_n_followers(n_followers_future.get());
-    _return.__set_n_following(n_following_future.get());
-    _return.__set_n_posts(n_posts_future.get());
-    _return.__set_n_likes(n_likes_future.get());
+    // Retrieve follow, post, and like activity.
+    _return = sync_wait(
+        expand_account(request_metadata, _return, "retrieve_expanded_account"));
   }
 
   void update_account(TAccount& _return,
                       const TRequestMetadata& request_metadata,
-                      const int32_t account_id, const std::string& password,
+                      const int64_t account_id, const std::string& password,
                       const std::string& first_name,
                       const std::string& last_name) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Check if requester is authorized.
     if (request_metadata.requester_id != account_id)
       throw TAccountNotAuthorizedException();
@@ -285,20 +352,13 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
     if (!validate_attributes("john.doe", password, first_name, last_name))
       throw TAccountInvalidAttributesException();
 
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "UPDATE Accounts "
-        "SET password = '%s', first_name = '%s', last_name = '%s' "
-        "WHERE id = %d "
-        "RETURNING created_at, active, username";
-    sprintf(query_str, query_fmt, password.c_str(), first_name.c_str(),
-            last_name.c_str(), account_id);
-
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TAccountServiceHandler::run_query, this, std::ref(query_str),
-                  "account"),
+        [&] {
+          return run_prepared("update_account", "account", request_metadata,
+                              "update_account", password, first_name,
+                              last_name, account_id);
+        },
         _query_logger,
         "ls=account lf=update_account db=account qt=update rid=" +
             request_metadata.id);
@@ -317,24 +377,19 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
   }
 
   void delete_account(const TRequestMetadata& request_metadata,
-                      const int32_t account_id) {
+                      const int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Check if requester is authorized.
     if (request_metadata.requester_id != account_id)
       throw TAccountNotAuthorizedException();
 
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "UPDATE Accounts "
-        "SET active = FALSE "
-        "WHERE id = %d "
-        "RETURNING id";
-    sprintf(query_str, query_fmt, account_id);
-
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TAccountServiceHandler::run_query, this, std::ref(query_str),
-                  "account"),
+        [&] {
+          return run_prepared("delete_account", "account", request_metadata,
+                              "delete_account", account_id);
+        },
         _query_logger,
         "ls=account lf=delete_account db=account qt=update rid=" +
             request_metadata.id);
@@ -347,121 +402,52 @@ class TAccountServiceHandler : public MicroserviceConnectedServer,
                      const TRequestMetadata& request_metadata,
                      const TAccountQuery& query, const int32_t limit,
                      const int32_t offset) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT id, created_at, active, username, first_name, last_name "
-        "FROM Accounts "
-        "WHERE %s "
-        "ORDER BY created_at DESC "
-        "LIMIT %d "
-        "OFFSET %d";
-    sprintf(query_str, query_fmt, build_where_clause(query).c_str(), limit,
-            offset);
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TAccountServiceHandler::run_query, this, std::ref(query_str),
-                  "account"),
+        [&] {
+          if (query.__isset.username)
+            return run_prepared("list_accounts_by_username", "account",
+                                request_metadata, "list_accounts",
+                                query.username, limit, offset);
+          return run_prepared("list_accounts", "account", request_metadata,
+                              "list_accounts", limit, offset);
+        },
         _query_logger,
         "ls=account lf=list_accounts db=account qt=select rid=" +
             request_metadata.id);
 
-    // Retrieve follow activity in separate threads.
-    std::vector<std::future<bool>> follows_you_futures;
-    for (auto row : db_res) {
-      follows_you_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<bool>(
-            std::bind(&TAccountServiceHandler::rpc_check_follow, this,
-                      std::ref(request_metadata), row["id"].as<int>(),
-                      std::ref(request_metadata.requester_id)),
-            _rpc_logger,
-            "ls=account lf=list_accounts rs=follow rf=check_follow rid=" +
-                request_metadata.id);
-      }));
-    }
-    std::vector<std::future<bool>> followed_by_you_futures;
-    for (auto row : db_res) {
-      followed_by_you_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<bool>(
-            std::bind(&TAccountServiceHandler::rpc_check_follow, this,
-                      std::ref(request_metadata),
-                      std::ref(request_metadata.requester_id),
-                      row["id"].as<int>()),
-            _rpc_logger,
-            "ls=account lf=list_accounts rs=follow rf=check_follow rid=" +
-                request_metadata.id);
-      }));
-    }
-    std::vector<std::future<int>> n_followers_futures;
-    for (auto row : db_res) {
-      n_followers_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<int32_t>(
-            std::bind(&TAccountServiceHandler::rpc_count_followers, this,
-                      std::ref(request_metadata), row["id"].as<int>()),
-            _rpc_logger,
-            "ls=account lf=list_accounts rs=follow rf=count_followers rid=" +
-                request_metadata.id);
-      }));
-    }
-    std::vector<std::future<int>> n_following_futures;
-    for (auto row : db_res) {
-      n_following_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<int32_t>(
-            std::bind(&TAccountServiceHandler::rpc_count_followees, this,
-                      std::ref(request_metadata), row["id"].as<int>()),
-            _rpc_logger,
-            "ls=account lf=list_accounts rs=follow rf=count_followees rid=" +
-                request_metadata.id);
-      }));
-    }
+    _return = expand_listed_accounts(request_metadata, db_res);
+  }
 
-    // Retrieve post activity in separate threads.
-    std::vector<std::future<int>> n_posts_futures;
-    for (auto row : db_res) {
-      n_posts_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<int32_t>(
-            std::bind(&TAccountServiceHandler::rpc_count_posts_by_author, this,
-                      std::ref(request_metadata), row["id"].as<int>()),
-            _rpc_logger,
-            "ls=account lf=list_accounts rs=post rf=count_posts_by_author "
-            "rid=" +
-                request_metadata.id);
-      }));
-    }
+  void list_accounts_page(TAccountPage& _return,
+                          const TRequestMetadata& request_metadata,
+                          const TAccountQuery& query, const int32_t limit,
+                          const std::string& cursor) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
-    // Retrieve like activity in separate threads.
-    std::vector<std::future<int>> n_likes_futures;
-    for (auto row : db_res) {
-      n_likes_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<int32_t>(
-            std::bind(&TAccountServiceHandler::rpc_count_likes_by_account, this,
-                      std::ref(request_metadata), row["id"].as<int>()),
-            _rpc_logger,
-            "ls=account lf=list_accounts rs=like rf=count_likes_by_account "
-            "rid=" +
-                request_metadata.id);
-      }));
-    }
+    // Execute query.
+    auto before_id = decode_cursor(cursor);
+    auto db_res = RPC_WRAPPER<pqxx::result>(
+        [&] {
+          if (query.__isset.username)
+            return run_prepared("list_accounts_by_username_before", "account",
+                                request_metadata, "list_accounts_page",
+                                query.username, before_id, limit);
+          return run_prepared("list_accounts_before", "account",
+                              request_metadata, "list_accounts_page", before_id,
+                              limit);
+        },
+        _query_logger,
+        "ls=account lf=list_accounts_page db=account qt=select rid=" +
+            request_metadata.id);
 
-    // Build accounts.
-    for (auto i = 0; i < db_res.size(); i++) {
-      // Build account (expanded mode).
-      TAccount account;
-      account.id = db_res[i]["id"].as<int>();
-      account.created_at = db_res[i]["created_at"].as<int>();
-      account.active = db_res[i]["active"].as<bool>();
-      account.username = db_res[i]["username"].as<std::string>();
-      account.first_name = db_res[i]["first_name"].as<std::string>();
-      account.last_name = db_res[i]["last_name"].as<std::string>();
-      account.followed_by_you = followed_by_you_futures[i].get();
-      account.__set_follows_you(follows_you_futures[i].get());
-      account.__set_n_followers(n_followers_futures[i].get());
-      account.__set_n_following(n_following_futures[i].get());
-      account.__set_n_posts(n_posts_futures[i].get());
-      account.__set_n_likes(n_likes_futures[i].get());
-      _return.push_back(account);
-    }
+    // Build page.
+    _return.accounts = expand_listed_accounts(request_metadata, db_res);
+    if (limit > 0 && int32_t(db_res.size()) == limit)
+      _return.__set_next_cursor(
+          encode_cursor(db_res[db_res.size() - 1]["id"].as<int64_t>()));
   }
 };
 
@@ -473,6 +459,17 @@ int main(int argc, char** argv) {
       ("port", "", cxxopts::value<int>())
       ("threads", "", cxxopts::value<int>()->default_value("0"))
       ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("max_parallelism", "", cxxopts::value<int>()->default_value("16"))
+      ("rpc_event_loops", "", cxxopts::value<int>()->default_value("1"))
       ("backend_filepath", "",
           cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
       ("microservice_connection_pool_min_size", "",
@@ -491,6 +488,10 @@ int main(int argc, char** argv) {
           cxxopts::value<std::string>()->default_value("postgres"))
       ("postgres_password", "",
           cxxopts::value<std::string>()->default_value("postgres"))
+      ("slow_query_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("slow_query_explains_per_s", "",
+          cxxopts::value<int>()->default_value("1"))
+      ("node_id", "", cxxopts::value<std::string>())
       ("logging", "", cxxopts::value<int>()->default_value("1"));
 
   // Parse command-line arguments.
@@ -499,6 +500,15 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
+  int max_parallelism = result["max_parallelism"].as<int>();
+  int rpc_event_loops = result["rpc_event_loops"].as<int>();
   std::string backend_filepath = result["backend_filepath"].as<std::string>();
   int microservice_connection_pool_min_size =
       result["microservice_connection_pool_min_size"].as<int>();
@@ -514,27 +524,35 @@ int main(int argc, char** argv) {
       result["postgres_connection_pool_allow_ephemeral"].as<int>();
   std::string postgres_user = result["postgres_user"].as<std::string>();
   std::string postgres_password = result["postgres_password"].as<std::string>();
+  int slow_query_ms = result["slow_query_ms"].as<int>();
+  int slow_query_explains_per_s = result["slow_query_explains_per_s"].as<int>();
+  std::string node_id = result["node_id"].as<std::string>();
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(
-      std::make_shared<TAccountServiceProcessor>(
-          std::make_shared<TAccountServiceHandler>(
-              backend_filepath, microservice_connection_pool_min_size,
-              microservice_connection_pool_max_size,
-              microservice_connection_pool_allow_ephemeral,
-              postgres_connection_pool_min_size,
-              postgres_connection_pool_max_size,
-              postgres_connection_pool_allow_ephemeral, postgres_user,
-              postgres_password, logging)),
-      socket, std::make_shared<TBufferedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  SlowQueryLog::configure(slow_query_ms, slow_query_explains_per_s, logging);
+  IdGenerator::configure(IdGenerator::parse_node_id(node_id));
+  EventLoop::configure(rpc_event_loops);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TAccountServiceProcessor>(
+            std::make_shared<TAccountServiceHandler>(
+                backend_filepath, microservice_connection_pool_min_size,
+                microservice_connection_pool_max_size,
+                microservice_connection_pool_allow_ephemeral,
+                postgres_connection_pool_min_size,
+                postgres_connection_pool_max_size,
+                postgres_connection_pool_allow_ephemeral, postgres_user,
+                postgres_password, max_parallelism, logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
@@ -191,6 +191,42 @@ class TestService(unittest.TestCase):
       self.assertEqual(1, len(retrieved_accounts))
       self.assertEqual(account.id, retrieved_accounts[0].id)
 
+  def test_list_accounts_page(self):
+    with AccountClient(IP_ADDRESS, ACCOUNT_PORT) as client:
+      # Create accounts.
+      accounts = [
+          client.create_account(TRequestMetadata(id=random_id()), random_id(),
+                                "passwd", "George", "Burdell") for i in range(3)
+      ]
+      # Walk the first pages of all accounts and check that they start with
+      # these accounts, newest first.
+      query = TAccountQuery()
+      limit = 2
+      first_page = client.list_accounts_page(
+          TRequestMetadata(id=random_id(), requester_id=self._account.id),
+          query, limit, "")
+      self.assertEqual([accounts[2].id, accounts[1].id],
+                       [account.id for account in first_page.accounts])
+      self.assertIsNotNone(first_page.next_cursor)
+      second_page = client.list_accounts_page(
+          TRequestMetadata(id=random_id(), requester_id=self._account.id),
+          query, limit, first_page.next_cursor)
+      self.assertEqual(accounts[0].id, second_page.accounts[0].id)
+      # Check that the last page has no cursor.
+      query = TAccountQuery(username=accounts[0].username)
+      last_page = client.list_accounts_page(
+          TRequestMetadata(id=random_id(), requester_id=self._account.id),
+          query, limit, "")
+      self.assertEqual([accounts[0].id],
+                       [account.id for account in last_page.accounts])
+      self.assertIsNone(last_page.next_cursor)
+      # Check that invalid cursors are rejected.
+      with self.assertRaises(TInvalidCursorException):
+        client.list_accounts_page(
+            TRequestMetadata(id=random_id(), requester_id=self._account.id),
+            query, limit, "not a cursor")
+
+
 
 if __name__ == "__main__":
   unittest.main()
@@ -2,6 +2,7 @@
 # Systems
 
 import os
+import time
 
 import flask
 import flask_httpauth
@@ -27,6 +28,7 @@ def setup_app():
     app.rpc_logger.set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v")
   else:
     app.rpc_logger = None
+  app.request_timeout_ms = int(os.getenv("request_timeout_ms") or 0)
   return app
 
 
@@ -34,9 +36,51 @@ app = setup_app()
 auth = flask_httpauth.HTTPBasicAuth()
 
 
+# Returns the metadata of the current request, with a deadline if request
+# timeouts are enabled, with the criticality given by the client, if any
+# ("critical", "default", or "sheddable"), and with the time of the last write
+# of the client, if any (see record_last_write).
+def new_request_metadata(**kwargs):
+  if app.request_timeout_ms > 0:
+    kwargs["deadline"] = int(time.time() * 1000) + app.request_timeout_ms
+  if "criticality" in flask.request.args:
+    kwargs["criticality"] = TRequestCriticality._NAMES_TO_VALUES.get(
+        flask.request.args["criticality"].upper(), TRequestCriticality.DEFAULT)
+  if flask.request.cookies.get("last_write", "").isdigit():
+    kwargs["last_write"] = int(flask.request.cookies["last_write"])
+  return TRequestMetadata(id=flask.request.args["request_id"], **kwargs)
+
+
+@app.after_request
+def record_last_write(response):
+  """Hands the time of a successful write to the client in a cookie, so that
+  its next requests carry it to whichever gateway and service replicas serve
+  them, and their reads go to primary databases while replicas lag behind."""
+  if flask.request.method != "GET" and response.status_code < 400:
+    response.set_cookie("last_write", str(int(time.time() * 1000)))
+  return response
+
+
+@app.errorhandler(TServiceOverloadedException)
+def service_overloaded(e):
+  return ({}, 503)
+
+
+@app.errorhandler(TInvalidCursorException)
+def invalid_cursor(e):
+  return ({}, 400)
+
+
+def paginated(response, next_cursor):
+  """Adds the cursor of the next page, if any, to a list response."""
+  if next_cursor is not None:
+    response.headers["X-Next-Cursor"] = next_cursor
+  return response
+
+
 @auth.verify_password
 def verify_password(username, password):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   try:
     account = RPC_WRAPPER(
         app.rpc_logger,
@@ -52,7 +96,7 @@ def verify_password(username, password):
 
 @app.route("/account", methods=["POST"])
 def create_account():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   params = flask.request.get_json()
   try:
     username = params["username"]
@@ -89,7 +133,7 @@ def create_account():
 
 @app.route("/account/<int:account_id>", methods=["GET"])
 def retrieve_account(account_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   try:
     account = RPC_WRAPPER(
         app.rpc_logger,
@@ -120,8 +164,7 @@ def retrieve_account(account_id):
 @app.route("/account/<int:account_id>", methods=["PUT"])
 @auth.login_required
 def update_account(account_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   params = flask.request.get_json()
   try:
     password = params["password"]
@@ -160,8 +203,7 @@ def update_account(account_id):
 @app.route("/account/<int:account_id>", methods=["DELETE"])
 @auth.login_required
 def delete_account(account_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   try:
     RPC_WRAPPER(
         app.rpc_logger,
@@ -178,7 +220,7 @@ def delete_account(account_id):
 
 @app.route("/account", methods=["GET"])
 def list_accounts():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   limit = int(flask.request.args["limit"]) \
       if "limit" in flask.request.args else 32
   offset = int(flask.request.args["offset"]) \
@@ -186,15 +228,28 @@ def list_accounts():
   username = flask.request.args["username"] \
       if "username" in flask.request.args else None
   query = TAccountQuery(username=username)
-  accounts = RPC_WRAPPER(
-      app.rpc_logger,
-      "ls=apigateway lf=list_accounts rs=account rf=list_accounts rid=%s" %
-      request_metadata.id)(app.rpc.list_accounts,
-                           request_metadata=request_metadata,
-                           query=query,
-                           limit=limit,
-                           offset=offset)
-  return flask.jsonify([{
+  next_cursor = None
+  if "cursor" in flask.request.args:
+    page = RPC_WRAPPER(
+        app.rpc_logger,
+        "ls=apigateway lf=list_accounts rs=account rf=list_accounts_page "
+        "rid=%s" % request_metadata.id)(
+            app.rpc.list_accounts_page,
+            request_metadata=request_metadata,
+            query=query,
+            limit=limit,
+            cursor=flask.request.args["cursor"])
+    accounts, next_cursor = page.accounts, page.next_cursor
+  else:
+    accounts = RPC_WRAPPER(
+        app.rpc_logger,
+        "ls=apigateway lf=list_accounts rs=account rf=list_accounts rid=%s" %
+        request_metadata.id)(app.rpc.list_accounts,
+                             request_metadata=request_metadata,
+                             query=query,
+                             limit=limit,
+                             offset=offset)
+  return paginated(flask.jsonify([{
       "object": "account",
       "mode": "expanded",
       "id": account.id,
@@ -209,14 +264,13 @@ def list_accounts():
       "n_following": account.n_following,
       "n_posts": account.n_posts,
       "n_likes": account.n_likes
-  } for account in accounts])
+  } for account in accounts]), next_cursor)
 
 
 @app.route("/follow", methods=["POST"])
 @auth.login_required
 def follow_account():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   params = flask.request.get_json()
   try:
     account_id = params["account_id"]
@@ -243,7 +297,7 @@ def follow_account():
 
 @app.route("/follow/<int:follow_id>", methods=["GET"])
 def retrieve_follow(follow_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   try:
     follow = RPC_WRAPPER(
         app.rpc_logger,
@@ -286,8 +340,7 @@ def retrieve_follow(follow_id):
 @app.route("/follow/<int:follow_id>", methods=["DELETE"])
 @auth.login_required
 def delete_follow(follow_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   try:
     RPC_WRAPPER(
         app.rpc_logger,
@@ -304,7 +357,7 @@ def delete_follow(follow_id):
 
 @app.route("/follow", methods=["GET"])
 def list_follows():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   limit = int(flask.request.args["limit"]) \
       if "limit" in flask.request.args else 32
   offset = int(flask.request.args["offset"]) \
@@ -315,17 +368,30 @@ def list_follows():
       if "followee_id" in flask.request.args else None
   query = TFollowQuery(follower_id=follower_id, followee_id=followee_id)
   try:
-    follows = RPC_WRAPPER(
-        app.rpc_logger,
-        "ls=apigateway lf=list_follows rs=follow rf=list_follows rid=%s" %
-        request_metadata.id)(app.rpc.list_follows,
-                             request_metadata=request_metadata,
-                             query=query,
-                             limit=limit,
-                             offset=offset)
+    next_cursor = None
+    if "cursor" in flask.request.args:
+      page = RPC_WRAPPER(
+          app.rpc_logger,
+          "ls=apigateway lf=list_follows rs=follow rf=list_follows_page "
+          "rid=%s" % request_metadata.id)(
+              app.rpc.list_follows_page,
+              request_metadata=request_metadata,
+              query=query,
+              limit=limit,
+              cursor=flask.request.args["cursor"])
+      follows, next_cursor = page.follows, page.next_cursor
+    else:
+      follows = RPC_WRAPPER(
+          app.rpc_logger,
+          "ls=apigateway lf=list_follows rs=follow rf=list_follows rid=%s" %
+          request_metadata.id)(app.rpc.list_follows,
+                               request_metadata=request_metadata,
+                               query=query,
+                               limit=limit,
+                               offset=offset)
   except TAccountNotFoundException:
     return ({}, 400)
-  return flask.jsonify([{
+  return paginated(flask.jsonify([{
       "object": "follow",
       "mode": "expanded",
       "id": follow.id,
@@ -352,14 +418,13 @@ def list_follows():
           "first_name": follow.followee.first_name,
           "last_name": follow.followee.last_name
       }
-  } for follow in follows])
+  } for follow in follows]), next_cursor)
 
 
 @app.route("/post", methods=["POST"])
 @auth.login_required
 def create_post():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   params = flask.request.get_json()
   try:
     text = params["text"]
@@ -387,7 +452,7 @@ def create_post():
 
 @app.route("/post/<int:post_id>", methods=["GET"])
 def retrieve_post(post_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   try:
     post = RPC_WRAPPER(
         app.rpc_logger,
@@ -422,8 +487,7 @@ def retrieve_post(post_id):
 @app.route("/post/<int:post_id>", methods=["DELETE"])
 @auth.login_required
 def delete_post(post_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   try:
     RPC_WRAPPER(
         app.rpc_logger,
@@ -440,7 +504,7 @@ def delete_post(post_id):
 
 @app.route("/post", methods=["GET"])
 def list_posts():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   limit = int(flask.request.args["limit"]) \
       if "limit" in flask.request.args else 32
   offset = int(flask.request.args["offset"]) \
@@ -449,17 +513,30 @@ def list_posts():
       if "author_id" in flask.request.args else None
   query = TPostQuery(author_id=author_id)
   try:
-    posts = RPC_WRAPPER(
-        app.rpc_logger,
-        "ls=apigateway lf=list_posts rs=post rf=list_posts rid=%s" %
-        request_metadata.id)(app.rpc.list_posts,
-                             request_metadata=request_metadata,
-                             query=query,
-                             limit=limit,
-                             offset=offset)
+    next_cursor = None
+    if "cursor" in flask.request.args:
+      page = RPC_WRAPPER(
+          app.rpc_logger,
+          "ls=apigateway lf=list_posts rs=post rf=list_posts_page "
+          "rid=%s" % request_metadata.id)(
+              app.rpc.list_posts_page,
+              request_metadata=request_metadata,
+              query=query,
+              limit=limit,
+              cursor=flask.request.args["cursor"])
+      posts, next_cursor = page.posts, page.next_cursor
+    else:
+      posts = RPC_WRAPPER(
+          app.rpc_logger,
+          "ls=apigateway lf=list_posts rs=post rf=list_posts rid=%s" %
+          request_metadata.id)(app.rpc.list_posts,
+                               request_metadata=request_metadata,
+                               query=query,
+                               limit=limit,
+                               offset=offset)
   except TAccountNotFoundException:
     return ({}, 400)
-  return flask.jsonify([{
+  return paginated(flask.jsonify([{
       "object": "post",
       "mode": "expanded",
       "id": post.id,
@@ -478,14 +555,13 @@ def list_posts():
           "last_name": post.author.last_name
       },
       "n_likes": post.n_likes
-  } for post in posts])
+  } for post in posts]), next_cursor)
 
 
 @app.route("/like", methods=["POST"])
 @auth.login_required
 def like_post():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   params = flask.request.get_json()
   try:
     post_id = params["post_id"]
@@ -512,7 +588,7 @@ def like_post():
 
 @app.route("/like/<int:like_id>", methods=["GET"])
 def retrieve_like(like_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   try:
     like = RPC_WRAPPER(
         app.rpc_logger,
@@ -565,8 +641,7 @@ def retrieve_like(like_id):
 @app.route("/like/<int:like_id>", methods=["DELETE"])
 @auth.login_required
 def delete_like(like_id):
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"],
-                                      requester_id=auth.current_user().id)
+  request_metadata = new_request_metadata(requester_id=auth.current_user().id)
   try:
     RPC_WRAPPER(
         app.rpc_logger,
@@ -583,7 +658,7 @@ def delete_like(like_id):
 
 @app.route("/like", methods=["GET"])
 def list_likes():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   limit = int(flask.request.args["limit"]) \
       if "limit" in flask.request.args else 32
   offset = int(flask.request.args["offset"]) \
@@ -594,19 +669,32 @@ def list_likes():
       if "post_id" in flask.request.args else None
   query = TLikeQuery(account_id=account_id, post_id=post_id)
   try:
-    likes = RPC_WRAPPER(
-        app.rpc_logger,
-        "ls=apigateway lf=list_likes rs=like rf=list_likes rid=%s" %
-        request_metadata.id)(app.rpc.list_likes,
-                             request_metadata=request_metadata,
-                             query=query,
-                             limit=limit,
-                             offset=offset)
+    next_cursor = None
+    if "cursor" in flask.request.args:
+      page = RPC_WRAPPER(
+          app.rpc_logger,
+          "ls=apigateway lf=list_likes rs=like rf=list_likes_page "
+          "rid=%s" % request_metadata.id)(
+              app.rpc.list_likes_page,
+              request_metadata=request_metadata,
+              query=query,
+              limit=limit,
+              cursor=flask.request.args["cursor"])
+      likes, next_cursor = page.likes, page.next_cursor
+    else:
+      likes = RPC_WRAPPER(
+          app.rpc_logger,
+          "ls=apigateway lf=list_likes rs=like rf=list_likes rid=%s" %
+          request_metadata.id)(app.rpc.list_likes,
+                               request_metadata=request_metadata,
+                               query=query,
+                               limit=limit,
+                               offset=offset)
   except TAccountNotFoundException:
     return ({}, 400)
   except TPostNotFoundException:
     return ({}, 400)
-  return flask.jsonify([{
+  return paginated(flask.jsonify([{
       "object": "like",
       "mode": "expanded",
       "id": like.id,
@@ -643,12 +731,12 @@ def list_likes():
           },
           "n_likes": like.post.n_likes
       }
-  } for like in likes])
+  } for like in likes]), next_cursor)
 
 
 @app.route("/trending", methods=["GET"])
 def list_trending_hashtags():
-  request_metadata = TRequestMetadata(id=flask.request.args["request_id"])
+  request_metadata = new_request_metadata()
   limit = int(flask.request.args["limit"]) \
       if "limit" in flask.request.args else 10
   return flask.jsonify(
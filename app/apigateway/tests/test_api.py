@@ -293,6 +293,30 @@ class TestService(unittest.TestCase):
     response = r.json()
     self.assertEqual(0, len(response))
 
+  def test_list_posts_cursor_200(self):
+    r = requests.get("http://{url}/post".format(url=URL),
+                     params={
+                         "request_id": random_id(),
+                         "author_id": self._accounts[0]["id"],
+                         "limit": 1,
+                         "cursor": ""
+                     })
+    self.assertEqual(200, r.status_code)
+    response = r.json()
+    self.assertEqual(1, len(response))
+    self.assertEqual(self._posts[1]["id"], response[0]["id"])
+    r = requests.get("http://{url}/post".format(url=URL),
+                     params={
+                         "request_id": random_id(),
+                         "author_id": self._accounts[0]["id"],
+                         "limit": 1,
+                         "cursor": r.headers["X-Next-Cursor"]
+                     })
+    self.assertEqual(200, r.status_code)
+    response = r.json()
+    self.assertEqual(1, len(response))
+    self.assertEqual(self._posts[0]["id"], response[0]["id"])
+
   def test_like_post_200(self):
     r = requests.post("http://{url}/like".format(url=URL),
                       auth=HTTPBasicAuth(self._accounts[0]["username"],
@@ -0,0 +1,228 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef ADMISSION_CONTROL__H
+#define ADMISSION_CONTROL__H
+
+#include <buzzblog/gen/buzzblog_types.h>
+#include <buzzblog/shard.h>
+#include <buzzblog/utils.h>
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+class AdmissionController;
+
+/* Admission of a request, which counts as in flight until it is destroyed.
+ * Handler methods called by other handler methods of the same request (on the
+ * same thread) are admitted along with it.
+ */
+class AdmissionTicket {
+ private:
+  // Counter of requests in flight, or nullptr for nested admissions.
+  std::atomic<int>* _in_flight;
+  bool _active;
+
+  static int& depth() {
+    static thread_local int depth = 0;
+    return depth;
+  }
+
+  friend class AdmissionController;
+
+ public:
+  AdmissionTicket(std::atomic<int>* in_flight) {
+    _in_flight = in_flight;
+    _active = true;
+    depth()++;
+  }
+
+  AdmissionTicket(AdmissionTicket&& other) noexcept {
+    _in_flight = other._in_flight;
+    _active = other._active;
+    other._active = false;
+  }
+
+  AdmissionTicket(const AdmissionTicket&) = delete;
+  AdmissionTicket& operator=(const AdmissionTicket&) = delete;
+  AdmissionTicket& operator=(AdmissionTicket&&) = delete;
+
+  ~AdmissionTicket() {
+    if (!_active) return;
+    depth()--;
+    if (_in_flight) (*_in_flight)--;
+  }
+};
+
+/* Admission controller of a shard of the process (see PerShard). Requests are
+ * rejected with TServiceOverloadedException as soon as they arrive when the
+ * load of the shard is too high, instead of queueing up behind exhausted
+ * connection pools. The load is the highest of the following ratios (limits
+ * of 0 are disabled):
+ *   - requests in flight to `max_in_flight`;
+ *   - threads waiting for a connection, over all pools, to `max_backlog`;
+ *   - recent average time waited for a connection, over the slowest pool, to
+ *     `max_wait_ms`.
+ * Requests are admitted while the load is at most 1, with room for twice as
+ * much load for CRITICAL requests and half as much for SHEDDABLE ones.
+ */
+class AdmissionController {
+ private:
+  struct Pool {
+    std::function<int()> backlog;
+    std::function<double()> wait_time;
+  };
+
+  static constexpr int kMaxPools = 1024;
+
+  int _max_in_flight;
+  int _max_backlog;
+  double _max_wait;
+  // Pools are only appended, so that admissions read them without locking.
+  std::unique_ptr<Pool[]> _pools;
+  std::atomic<int> _n_pools;
+  std::mutex _mutex;
+  bool _stop;
+  std::condition_variable _stop_condition;
+  // Metrics.
+  std::atomic<int> _in_flight;
+  std::atomic<long> _n_admitted;
+  std::atomic<long> _n_rejected;
+  std::thread _metrics_thread;
+  std::shared_ptr<spdlog::logger> _admission_logger;
+
+  static PerShard<AdmissionController>& global() {
+    static PerShard<AdmissionController> controllers(
+        [] { return std::make_unique<AdmissionController>(0, 0, 0, 0); });
+    return controllers;
+  }
+
+  static double max_load(const gen::TRequestCriticality::type criticality) {
+    switch (criticality) {
+      case gen::TRequestCriticality::CRITICAL:
+        return 2;
+      case gen::TRequestCriticality::SHEDDABLE:
+        return 0.5;
+      default:
+        return 1;
+    }
+  }
+
+  int backlog() {
+    int backlog = 0;
+    int n_pools = _n_pools.load();
+    for (int i = 0; i < n_pools; i++) backlog += _pools[i].backlog();
+    return backlog;
+  }
+
+  double wait_time() {
+    double wait_time = 0;
+    int n_pools = _n_pools.load();
+    for (int i = 0; i < n_pools; i++)
+      wait_time = std::max(wait_time, _pools[i].wait_time());
+    return wait_time;
+  }
+
+  double load(const int in_flight) {
+    double load = 0;
+    if (_max_in_flight > 0)
+      load = std::max(load, double(in_flight) / _max_in_flight);
+    if (_max_backlog > 0)
+      load = std::max(load, double(backlog()) / _max_backlog);
+    if (_max_wait > 0) load = std::max(load, wait_time() / _max_wait);
+    return load;
+  }
+
+  void run_metrics() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stop_condition.wait_for(lock, std::chrono::seconds(1),
+                                     [this] { return _stop; }))
+      _admission_logger->info("if={} bl={} wt={} ad={} rj={}",
+                              _in_flight.load(), backlog(), wait_time(),
+                              _n_admitted.load(), _n_rejected.load());
+  }
+
+ public:
+  AdmissionController(const int max_in_flight, const int max_backlog,
+                      const int max_wait_ms, const int logging) {
+    _max_in_flight = max_in_flight;
+    _max_backlog = max_backlog;
+    _max_wait = max_wait_ms / 1000.0;
+    _pools.reset(new Pool[kMaxPools]);
+    _n_pools = 0;
+    _stop = false;
+    _in_flight = 0;
+    _n_admitted = 0;
+    _n_rejected = 0;
+
+    // Periodically log metrics.
+    if (logging) {
+      _admission_logger = get_logger("admission_logger", "/tmp/admission.log");
+      _metrics_thread = std::thread(&AdmissionController::run_metrics, this);
+    } else {
+      _admission_logger = nullptr;
+    }
+  }
+
+  ~AdmissionController() {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _stop_condition.notify_all();
+    if (_metrics_thread.joinable()) _metrics_thread.join();
+  }
+
+  /* Sets the limits of the admission controllers of all shards. Must be
+   * called once, before any request is served.
+   */
+  static void configure(const int max_in_flight, const int max_backlog,
+                        const int max_wait_ms, const int logging) {
+    global().configure([=] {
+      return std::make_unique<AdmissionController>(max_in_flight, max_backlog,
+                                                   max_wait_ms, logging);
+    });
+  }
+
+  // Returns the admission controller of the calling thread's shard.
+  static AdmissionController& instance() { return global().get(); }
+
+  /* Adds a connection pool whose backlog (number of waiting threads) and
+   * recent wait time (in seconds) count towards the load.
+   */
+  void add_pool(std::function<int()> backlog,
+                std::function<double()> wait_time) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    int n_pools = _n_pools.load();
+    if (n_pools == kMaxPools) throw std::length_error("Too many pools");
+    _pools[n_pools] = {backlog, wait_time};
+    _n_pools = n_pools + 1;
+  }
+
+  /* Admits a request or throws TServiceOverloadedException. */
+  AdmissionTicket admit(const gen::TRequestMetadata& request_metadata) {
+    // Nested handler calls belong to an admitted request.
+    if (AdmissionTicket::depth() > 0) return AdmissionTicket(nullptr);
+    int in_flight = ++_in_flight;
+    auto criticality = request_metadata.__isset.criticality
+                           ? request_metadata.criticality
+                           : gen::TRequestCriticality::DEFAULT;
+    if (load(in_flight) > max_load(criticality)) {
+      _in_flight--;
+      _n_rejected++;
+      throw gen::TServiceOverloadedException();
+    }
+    _n_admitted++;
+    return AdmissionTicket(&_in_flight);
+  }
+};
+
+#endif
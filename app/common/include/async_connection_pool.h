@@ -0,0 +1,314 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef ASYNC_CONNECTION_POOL__H
+#define ASYNC_CONNECTION_POOL__H
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <buzzblog/async_rpc.h>
+#include <buzzblog/deadline.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <sys/socket.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TTransportException.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+
+/* Pool of non-blocking connections to a microservice, used to call it from
+ * coroutines. Requests are serialized with the `send_*` method of the
+ * generated Thrift client T into a memory buffer and written to the socket
+ * by an event loop, which also reads the response and parses it with the
+ * matching `recv_*` method. Coroutines waiting for a connection or a response
+ * do not hold a thread.
+ */
+template <typename T>
+class AsyncConnectionPool {
+ private:
+  struct Connection {
+    int fd;
+    EventLoop* loop;
+    std::shared_ptr<TMemoryBuffer> out_buffer;
+    std::shared_ptr<TMemoryBuffer> in_buffer;
+    std::shared_ptr<T> client;
+    std::string in_data;
+
+    ~Connection() { close(fd); }
+  };
+
+  // Suspends a coroutine until a connection (or a slot to open one) is free.
+  struct Acquire {
+    AsyncConnectionPool* pool;
+    std::unique_ptr<Connection> conn;
+    std::coroutine_handle<> handle;
+    int backlog_len;
+
+    bool await_ready() { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      return !pool->try_acquire(this);
+    }
+
+    std::unique_ptr<Connection> await_resume() { return std::move(conn); }
+  };
+
+  std::string _local_service_name;
+  std::string _remote_service_name;
+  std::vector<std::pair<std::string, int>> _servers;
+  int _pool_current_size;
+  int _pool_min_size;
+  int _pool_max_size;
+  int _backlog_len;
+  int _next_server;
+  bool _allow_ephemeral;
+  bool _framed;
+  std::deque<std::unique_ptr<Connection>> _conn_pool;
+  std::deque<Acquire*> _waiters;
+  std::mutex _conn_pool_mutex;
+  std::shared_ptr<spdlog::logger> _rpc_conn_logger;
+
+  // Returns false if the coroutine must wait for a connection.
+  bool try_acquire(Acquire* acquire) {
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    if (_pool_max_size == 0) return true;
+    if (_pool_current_size < _pool_min_size) {
+      _pool_current_size++;
+    } else if (_conn_pool.size() > 0) {
+      acquire->conn = std::move(_conn_pool.front());
+      _conn_pool.pop_front();
+    } else if (_pool_current_size < _pool_max_size || _allow_ephemeral) {
+      _pool_current_size++;
+    } else {
+      acquire->backlog_len = ++_backlog_len;
+      _waiters.push_back(acquire);
+      return false;
+    }
+    return true;
+  }
+
+  void release(std::unique_ptr<Connection> conn) {
+    if (_pool_max_size == 0) return;
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    if (conn == nullptr) _pool_current_size--;
+    if (_waiters.size() > 0) {
+      // Hand the connection (or a slot to open one) to the next waiter.
+      auto waiter = _waiters.front();
+      _waiters.pop_front();
+      _backlog_len--;
+      if (conn == nullptr) _pool_current_size++;
+      auto loop = conn ? conn->loop : EventLoop::next();
+      waiter->conn = std::move(conn);
+      lock.unlock();
+      loop->post(waiter->handle);
+      return;
+    }
+    if (conn == nullptr) return;
+    if (_pool_current_size > _pool_max_size ||
+        (_pool_current_size > _pool_min_size && _conn_pool.size() > 1))
+      _pool_current_size--;
+    else
+      _conn_pool.push_back(std::move(conn));
+  }
+
+  Task<std::unique_ptr<Connection>> open() {
+    std::pair<std::string, int> server;
+    {
+      std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+      server = _servers[_next_server++ % int(_servers.size())];
+    }
+    // Resolve server address.
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addr;
+    if (getaddrinfo(server.first.c_str(), std::to_string(server.second).c_str(),
+                    &hints, &addr) != 0)
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not resolve " + server.first);
+    auto conn = std::make_unique<Connection>();
+    conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int rc = conn->fd < 0 ? -1 : connect(conn->fd, addr->ai_addr,
+                                         addr->ai_addrlen);
+    freeaddrinfo(addr);
+    if (rc < 0 && errno != EINPROGRESS)
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "connect() failed: " +
+                                    std::string(strerror(errno)));
+    int one = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn->loop = EventLoop::next();
+    conn->loop->add(conn->fd);
+
+    // Wait for the connection to be established.
+    if (rc < 0) {
+      co_await conn->loop->writable(conn->fd);
+      int error = 0;
+      socklen_t len = sizeof(error);
+      getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len);
+      if (error != 0)
+        throw TTransportException(TTransportException::NOT_OPEN,
+                                  "connect() failed: " +
+                                      std::string(strerror(error)));
+    }
+
+    // Bind a Thrift client to in-memory transports.
+    conn->out_buffer = std::make_shared<TMemoryBuffer>();
+    conn->in_buffer = std::make_shared<TMemoryBuffer>();
+    conn->client = std::make_shared<T>(
+        std::make_shared<TBinaryProtocol>(conn->in_buffer),
+        std::make_shared<TBinaryProtocol>(conn->out_buffer));
+    co_return conn;
+  }
+
+ public:
+  AsyncConnectionPool(const std::string& local_service_name,
+                      const std::string& remote_service_name,
+                      const std::vector<std::pair<std::string, int>>& servers,
+                      const int pool_min_size, const int pool_max_size,
+                      const bool allow_ephemeral, const bool framed,
+                      std::shared_ptr<spdlog::logger> rpc_conn_logger) {
+    _local_service_name = local_service_name;
+    _remote_service_name = remote_service_name;
+    _servers = servers;
+    _pool_min_size = pool_min_size;
+    _pool_max_size = pool_max_size;
+    _allow_ephemeral = allow_ephemeral;
+    _framed = framed;
+    _rpc_conn_logger = rpc_conn_logger;
+    _pool_current_size = 0;
+    _backlog_len = 0;
+    _next_server = 0;
+
+    // Validate connection pool parameters.
+    assert(_pool_min_size >= 0);
+    assert(_pool_max_size >= 0);
+    assert(_pool_max_size >= _pool_min_size);
+  }
+
+  // Number of coroutines waiting for a connection.
+  int backlog() {
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    return _backlog_len;
+  }
+
+  /* Calls a remote procedure: `send` writes the request with the client's
+   * `send_*` method and `recv` parses the response with its `recv_*` method.
+   * The call is abandoned if `deadline_ms` (see deadline.h) passes before the
+   * request is sent.
+   */
+  template <typename R>
+  Task<R> call(const int64_t deadline_ms, std::function<void(T&)> send,
+               std::function<R(T&)> recv) {
+    // Get a connection.
+    remaining_ms(deadline_ms);
+    auto start_time = std::chrono::steady_clock::now();
+    Acquire acquire{this, nullptr, nullptr, 0};
+    auto conn = co_await acquire;
+    std::optional<R> res;
+    std::exception_ptr exception;
+    bool broken = false;
+    try {
+      remaining_ms(deadline_ms);
+      if (conn == nullptr) conn = co_await open();
+      std::chrono::duration<double> latency =
+          std::chrono::steady_clock::now() - start_time;
+      if (_rpc_conn_logger)
+        _rpc_conn_logger->info("ls={} rs={} bl={} lat={}", _local_service_name,
+                               _remote_service_name, acquire.backlog_len,
+                               latency.count());
+
+      // Serialize request.
+      uint8_t* buf;
+      uint32_t len;
+      conn->out_buffer->resetBuffer();
+      send(*conn->client);
+      conn->out_buffer->getBuffer(&buf, &len);
+      std::string request;
+      if (_framed) {
+        uint32_t frame_len = htonl(len);
+        request.append(reinterpret_cast<char*>(&frame_len), 4);
+      }
+      request.append(reinterpret_cast<char*>(buf), len);
+
+      // Send request.
+      size_t sent = 0;
+      while (sent < request.size()) {
+        auto n = ::send(conn->fd, request.data() + sent, request.size() - sent,
+                        MSG_NOSIGNAL);
+        if (n >= 0)
+          sent += n;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+          co_await conn->loop->writable(conn->fd);
+        else
+          throw TTransportException(TTransportException::NOT_OPEN,
+                                    "send() failed: " +
+                                        std::string(strerror(errno)));
+      }
+
+      // Receive and parse response.
+      conn->in_data.clear();
+      while (!res) {
+        co_await conn->loop->readable(conn->fd);
+        char chunk[16384];
+        ssize_t n;
+        while ((n = ::recv(conn->fd, chunk, sizeof(chunk), 0)) > 0)
+          conn->in_data.append(chunk, n);
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+          throw TTransportException(TTransportException::END_OF_FILE,
+                                    "Connection closed by " +
+                                        _remote_service_name);
+        auto data = reinterpret_cast<uint8_t*>(conn->in_data.data());
+        uint32_t size = conn->in_data.size();
+        if (_framed) {
+          // Wait for the whole frame.
+          if (size < 4) continue;
+          uint32_t frame_len;
+          memcpy(&frame_len, data, 4);
+          if (size - 4 < ntohl(frame_len)) continue;
+          conn->in_buffer->resetBuffer(data + 4, ntohl(frame_len));
+          res.emplace(recv(*conn->client));
+        } else {
+          // Without framing, parse until the response is complete.
+          conn->in_buffer->resetBuffer(data, size);
+          try {
+            res.emplace(recv(*conn->client));
+          } catch (const TTransportException& e) {
+            if (e.getType() != TTransportException::END_OF_FILE) throw;
+          }
+        }
+      }
+    } catch (const TTransportException&) {
+      broken = true;
+      exception = std::current_exception();
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    // Broken connections are closed and replaced.
+    if (broken) conn = nullptr;
+    release(std::move(conn));
+    if (exception) std::rethrow_exception(exception);
+    co_return std::move(*res);
+  }
+};
+
+#endif
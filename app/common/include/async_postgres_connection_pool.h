@@ -0,0 +1,568 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef ASYNC_POSTGRES_CONNECTION_POOL__H
+#define ASYNC_POSTGRES_CONNECTION_POOL__H
+
+#include <assert.h>
+#include <buzzblog/async_rpc.h>
+#include <buzzblog/deadline.h>
+#include <postgresql/libpq-fe.h>
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <pqxx/pqxx>
+#include <set>
+#include <string>
+#include <vector>
+
+/* Field of a row of an AsyncPostgresResult. */
+class AsyncPostgresField {
+ private:
+  std::shared_ptr<PGresult> _res;
+  int _row;
+  int _column;
+
+ public:
+  AsyncPostgresField(std::shared_ptr<PGresult> res, const int row,
+                     const int column) {
+    _res = res;
+    _row = row;
+    _column = column;
+  }
+
+  bool is_null() const { return PQgetisnull(_res.get(), _row, _column); }
+
+  const char* c_str() const { return PQgetvalue(_res.get(), _row, _column); }
+
+  /* Converts the value of the field like pqxx::field::as. Throws
+   * pqxx::conversion_error if the value is null.
+   */
+  template <typename T>
+  T as() const {
+    if (is_null())
+      throw pqxx::conversion_error("Null value in column " +
+                                   std::string(PQfname(_res.get(), _column)));
+    T value;
+    pqxx::from_string(c_str(), value);
+    return value;
+  }
+};
+
+/* Row of an AsyncPostgresResult. */
+class AsyncPostgresRow {
+ private:
+  std::shared_ptr<PGresult> _res;
+  int _row;
+
+ public:
+  AsyncPostgresRow(std::shared_ptr<PGresult> res, const int row) {
+    _res = res;
+    _row = row;
+  }
+
+  AsyncPostgresField operator[](const int column) const {
+    return AsyncPostgresField(_res, _row, column);
+  }
+
+  AsyncPostgresField operator[](const std::string& column) const {
+    int number = PQfnumber(_res.get(), column.c_str());
+    if (number < 0) throw pqxx::argument_error("Unknown column: " + column);
+    return AsyncPostgresField(_res, _row, number);
+  }
+};
+
+/* Result of a statement run on an AsyncPostgresConnectionPool. Offers the
+ * part of the pqxx::result interface that handlers use (e.g.,
+ * `res[0]["id"].as<int64_t>()`), over the result returned by libpq. Copies
+ * share the same rows.
+ */
+class AsyncPostgresResult {
+ private:
+  std::shared_ptr<PGresult> _res;
+
+ public:
+  class const_iterator {
+   private:
+    const AsyncPostgresResult* _result;
+    size_t _index;
+
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = AsyncPostgresRow;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = AsyncPostgresRow;
+
+    const_iterator(const AsyncPostgresResult* result, const size_t index) {
+      _result = result;
+      _index = index;
+    }
+
+    AsyncPostgresRow operator*() const { return (*_result)[_index]; }
+
+    const_iterator& operator++() {
+      _index++;
+      return *this;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return _index == other._index;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return _index != other._index;
+    }
+  };
+
+  AsyncPostgresResult() {}
+
+  // Takes ownership of a result returned by libpq.
+  explicit AsyncPostgresResult(PGresult* res) { _res.reset(res, PQclear); }
+
+  size_t size() const { return _res ? PQntuples(_res.get()) : 0; }
+
+  bool empty() const { return size() == 0; }
+
+  // Number of rows inserted, updated, or deleted by the statement.
+  size_t affected_rows() const {
+    return _res ? std::atoll(PQcmdTuples(_res.get())) : 0;
+  }
+
+  AsyncPostgresRow operator[](const size_t row) const {
+    return AsyncPostgresRow(_res, row);
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  const_iterator end() const { return const_iterator(this, size()); }
+};
+
+/* Pool of non-blocking libpq connections to a database, used to run
+ * statements from coroutines. A statement is sent with PQsendQueryPrepared
+ * and an event loop (see async_rpc.h) resumes the coroutine when the socket
+ * of its connection becomes readable, until the result is complete. Neither
+ * waiting for a connection nor waiting for the database holds a thread, so a
+ * few event loop threads keep as many statements in flight as the pool has
+ * connections. Errors are thrown as the pqxx exceptions of blocking
+ * connections: pqxx::broken_connection, or the subclass of pqxx::sql_error
+ * that libpqxx throws for the SQLSTATE of the error (e.g.,
+ * pqxx::unique_violation for 23505).
+ */
+class AsyncPostgresConnectionPool {
+ private:
+  struct Connection {
+    PGconn* conn;
+    int fd;
+    EventLoop* loop;
+    // Statement timeout of the session (in milliseconds, 0 means none).
+    int64_t statement_timeout_ms;
+    // Statements prepared on the connection.
+    std::set<std::string> prepared;
+
+    ~Connection() { PQfinish(conn); }
+  };
+
+  // Suspends a coroutine until a connection (or a slot to open one) is free.
+  struct Acquire {
+    AsyncPostgresConnectionPool* pool;
+    std::unique_ptr<Connection> conn;
+    std::coroutine_handle<> handle;
+    int backlog_len;
+
+    bool await_ready() { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      return !pool->try_acquire(this);
+    }
+
+    std::unique_ptr<Connection> await_resume() { return std::move(conn); }
+  };
+
+  std::string _local_service_name;
+  std::string _dbname;
+  std::string _conn_cstr;
+  int _pool_current_size;
+  int _pool_min_size;
+  int _pool_max_size;
+  int _backlog_len;
+  // Moving average of the time waited for a connection (in seconds), updated
+  // only by coroutines that wait, and time (in ms) of the last update.
+  double _wait_time;
+  int64_t _last_wait_time;
+  bool _allow_ephemeral;
+  std::deque<std::unique_ptr<Connection>> _conn_pool;
+  std::deque<Acquire*> _waiters;
+  std::mutex _conn_pool_mutex;
+  std::shared_ptr<spdlog::logger> _query_conn_logger;
+
+  // Returns false if the coroutine must wait for a connection.
+  bool try_acquire(Acquire* acquire) {
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    if (_pool_max_size == 0) return true;
+    if (_pool_current_size < _pool_min_size) {
+      _pool_current_size++;
+    } else if (_conn_pool.size() > 0) {
+      acquire->conn = std::move(_conn_pool.front());
+      _conn_pool.pop_front();
+    } else if (_pool_current_size < _pool_max_size || _allow_ephemeral) {
+      _pool_current_size++;
+    } else {
+      acquire->backlog_len = ++_backlog_len;
+      _waiters.push_back(acquire);
+      return false;
+    }
+    return true;
+  }
+
+  void release(std::unique_ptr<Connection> conn) {
+    if (_pool_max_size == 0) return;
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    if (conn == nullptr) _pool_current_size--;
+    if (_waiters.size() > 0) {
+      // Hand the connection (or a slot to open one) to the next waiter.
+      auto waiter = _waiters.front();
+      _waiters.pop_front();
+      _backlog_len--;
+      if (conn == nullptr) _pool_current_size++;
+      auto loop = conn ? conn->loop : EventLoop::next();
+      waiter->conn = std::move(conn);
+      lock.unlock();
+      loop->post(waiter->handle);
+      return;
+    }
+    if (conn == nullptr) return;
+    if (_pool_current_size > _pool_max_size ||
+        (_pool_current_size > _pool_min_size && _conn_pool.size() > 1))
+      _pool_current_size--;
+    else
+      _conn_pool.push_back(std::move(conn));
+  }
+
+  // Returns the current time of the steady clock in milliseconds.
+  static int64_t steady_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Averages the time waited for a connection like LockFreeConnectionPool.
+  void record_wait(const double sample) {
+    const double alpha = 0.2;
+    int64_t now = steady_now_ms();
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    bool stale = now - _last_wait_time > 1000;
+    _last_wait_time = now;
+    _wait_time = stale ? sample : alpha * sample + (1 - alpha) * _wait_time;
+  }
+
+  // Throws the pqxx exception for an error reported by the server, picking
+  // the subclass of pqxx::sql_error as libpqxx does for blocking connections.
+  [[noreturn]] static void throw_sql_error(const std::string& error,
+                                           const std::string& command,
+                                           const std::string& sqlstate) {
+    const char* state = sqlstate.empty() ? nullptr : sqlstate.c_str();
+    auto sqlclass = sqlstate.substr(0, 2);
+    if (sqlstate == "23001")
+      throw pqxx::restrict_violation(error, command, state);
+    if (sqlstate == "23502")
+      throw pqxx::not_null_violation(error, command, state);
+    if (sqlstate == "23503")
+      throw pqxx::foreign_key_violation(error, command, state);
+    if (sqlstate == "23505")
+      throw pqxx::unique_violation(error, command, state);
+    if (sqlstate == "23514")
+      throw pqxx::check_violation(error, command, state);
+    if (sqlstate == "42501")
+      throw pqxx::insufficient_privilege(error, command, state);
+    if (sqlstate == "42601") throw pqxx::syntax_error(error, command, state);
+    if (sqlstate == "42703")
+      throw pqxx::undefined_column(error, command, state);
+    if (sqlstate == "42883")
+      throw pqxx::undefined_function(error, command, state);
+    if (sqlstate == "42P01")
+      throw pqxx::undefined_table(error, command, state);
+    if (sqlstate == "53100") throw pqxx::disk_full(error, command, state);
+    if (sqlstate == "53200") throw pqxx::out_of_memory(error, command, state);
+    if (sqlstate == "53300") throw pqxx::too_many_connections(error);
+    if (sqlclass == "0A")
+      throw pqxx::feature_not_supported(error, command, state);
+    if (sqlclass == "22") throw pqxx::data_exception(error, command, state);
+    if (sqlclass == "23")
+      throw pqxx::integrity_constraint_violation(error, command, state);
+    if (sqlclass == "24")
+      throw pqxx::invalid_cursor_state(error, command, state);
+    if (sqlclass == "26")
+      throw pqxx::invalid_sql_statement_name(error, command, state);
+    if (sqlclass == "34")
+      throw pqxx::invalid_cursor_name(error, command, state);
+    if (sqlclass == "53")
+      throw pqxx::insufficient_resources(error, command, state);
+    // Others, such as statement timeouts (57014), are plain SQL errors.
+    throw pqxx::sql_error(error, command, state);
+  }
+
+  // Waits for a connection, logging and averaging the time waited.
+  Task<std::unique_ptr<Connection>> acquire() {
+    auto start_time = std::chrono::steady_clock::now();
+    Acquire waiter{this, nullptr, nullptr, 0};
+    auto conn = co_await waiter;
+    std::chrono::duration<double> latency =
+        std::chrono::steady_clock::now() - start_time;
+    if (waiter.backlog_len > 0) record_wait(latency.count());
+    if (_query_conn_logger)
+      _query_conn_logger->info("ls={} db={} bl={} lat={}", _local_service_name,
+                               _dbname, waiter.backlog_len, latency.count());
+    co_return conn;
+  }
+
+  Task<std::unique_ptr<Connection>> open() {
+    auto conn = std::make_unique<Connection>();
+    conn->conn = PQconnectStart(_conn_cstr.c_str());
+    conn->fd = -1;
+    conn->loop = EventLoop::next();
+    conn->statement_timeout_ms = 0;
+    if (conn->conn == nullptr)
+      throw pqxx::broken_connection("Out of memory connecting to " + _dbname);
+
+    // Wait for the socket between steps of the connection. libpq replaces the
+    // socket when it tries another address of the host.
+    auto status = PGRES_POLLING_WRITING;
+    while (status != PGRES_POLLING_OK) {
+      if (status == PGRES_POLLING_FAILED)
+        throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+      if (PQsocket(conn->conn) != conn->fd) {
+        conn->fd = PQsocket(conn->conn);
+        conn->loop->add(conn->fd);
+      }
+      if (status == PGRES_POLLING_READING)
+        co_await conn->loop->readable(conn->fd);
+      else
+        co_await conn->loop->writable(conn->fd);
+      status = PQconnectPoll(conn->conn);
+    }
+    if (PQsetnonblocking(conn->conn, 1) != 0)
+      throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+    co_return conn;
+  }
+
+  // Sends a command queued on a connection by a PQsend* function, given what
+  // the function returned, and returns its result once complete.
+  Task<AsyncPostgresResult> finish(Connection& conn, const int queued,
+                                   const std::string command) {
+    if (!queued) throw pqxx::broken_connection(PQerrorMessage(conn.conn));
+    int flushed;
+    while ((flushed = PQflush(conn.conn)) == 1)
+      co_await conn.loop->writable(conn.fd);
+    if (flushed < 0) throw pqxx::broken_connection(PQerrorMessage(conn.conn));
+
+    // Read results until there are no more. Errors are thrown once all of
+    // them are read, so that the connection is left idle.
+    AsyncPostgresResult res;
+    std::string error;
+    std::string sqlstate;
+    while (true) {
+      while (PQisBusy(conn.conn)) {
+        co_await conn.loop->readable(conn.fd);
+        if (!PQconsumeInput(conn.conn))
+          throw pqxx::broken_connection(PQerrorMessage(conn.conn));
+      }
+      PGresult* next = PQgetResult(conn.conn);
+      if (next == nullptr) break;
+      res = AsyncPostgresResult(next);
+      auto status = PQresultStatus(next);
+      if (error.empty() && status != PGRES_COMMAND_OK &&
+          status != PGRES_TUPLES_OK) {
+        error = PQresultErrorMessage(next);
+        auto state = PQresultErrorField(next, PG_DIAG_SQLSTATE);
+        if (state) sqlstate = state;
+      }
+    }
+    if (PQstatus(conn.conn) != CONNECTION_OK)
+      throw pqxx::broken_connection(PQerrorMessage(conn.conn));
+    if (!error.empty()) throw_sql_error(error, command, sqlstate);
+    co_return res;
+  }
+
+ public:
+  AsyncPostgresConnectionPool(
+      const std::string& local_service_name, const std::string& dbname,
+      const std::string& conn_cstr, const int pool_min_size,
+      const int pool_max_size, const bool allow_ephemeral,
+      std::shared_ptr<spdlog::logger> query_conn_logger) {
+    _local_service_name = local_service_name;
+    _dbname = dbname;
+    _conn_cstr = conn_cstr;
+    _pool_min_size = pool_min_size;
+    _pool_max_size = pool_max_size;
+    _allow_ephemeral = allow_ephemeral;
+    _query_conn_logger = query_conn_logger;
+    _pool_current_size = 0;
+    _backlog_len = 0;
+    _wait_time = 0;
+    _last_wait_time = 0;
+
+    // Validate connection pool parameters.
+    assert(_pool_min_size >= 0);
+    assert(_pool_max_size >= 0);
+    assert(_pool_max_size >= _pool_min_size);
+  }
+
+  // Number of coroutines waiting for a connection.
+  int backlog() {
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    return _backlog_len;
+  }
+
+  // Recent average time waited for a connection (in seconds), or 0 if no
+  // coroutine waited in the last second.
+  double wait_time() {
+    int64_t now = steady_now_ms();
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    return now - _last_wait_time > 1000 ? 0 : _wait_time;
+  }
+
+  /* Runs a statement with the given parameter values. Each connection
+   * prepares the statement under `name` the first time it runs it, and sets
+   * the statement timeout of its session to the time left until
+   * `deadline_ms` (see deadline.h) when it changes. The statement runs
+   * outside of a transaction block. The call is abandoned if the deadline
+   * passes before the statement is sent.
+   */
+  Task<AsyncPostgresResult> exec_prepared(
+      const int64_t deadline_ms, const std::string name,
+      const std::string definition, const std::vector<std::string> params) {
+    // Get a connection.
+    remaining_ms(deadline_ms);
+    auto conn = co_await acquire();
+    std::optional<AsyncPostgresResult> res;
+    std::exception_ptr exception;
+    try {
+      if (conn == nullptr) conn = co_await open();
+
+      // Each of these commands takes a round trip, but only the first time.
+      int64_t timeout_ms = statement_timeout_ms(deadline_ms);
+      if (conn->statement_timeout_ms != timeout_ms) {
+        auto set_timeout =
+            "SET statement_timeout = " + std::to_string(timeout_ms);
+        co_await finish(*conn, PQsendQuery(conn->conn, set_timeout.c_str()),
+                        set_timeout);
+        conn->statement_timeout_ms = timeout_ms;
+      }
+      if (conn->prepared.count(name) == 0) {
+        co_await finish(*conn,
+                        PQsendPrepare(conn->conn, name.c_str(),
+                                      definition.c_str(), 0, nullptr),
+                        definition);
+        conn->prepared.insert(name);
+      }
+
+      // Run statement.
+      std::vector<const char*> values;
+      for (const auto& param : params) values.push_back(param.c_str());
+      res.emplace(co_await finish(
+          *conn,
+          PQsendQueryPrepared(conn->conn, name.c_str(), values.size(),
+                              values.data(), nullptr, nullptr, 0),
+          definition));
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    // Connections left broken or in the middle of a command are closed and
+    // replaced.
+    if (conn && (PQstatus(conn->conn) != CONNECTION_OK ||
+                 PQtransactionStatus(conn->conn) != PQTRANS_IDLE))
+      conn = nullptr;
+    release(std::move(conn));
+    if (exception) std::rethrow_exception(exception);
+    co_return std::move(*res);
+  }
+
+  /* Runs a `COPY ... TO STDOUT` command and passes each row of its output, as
+   * sent by the server, to `consume` as it arrives, so that memory use does
+   * not depend on the size of the output. `consume` runs on the event loop
+   * thread of the connection. The command runs without a statement timeout.
+   * Returns the number of rows copied.
+   */
+  Task<int64_t> copy_out(const std::string command,
+                         std::function<void(const char*, int)> consume) {
+    // Get a connection.
+    auto conn = co_await acquire();
+    int64_t n_rows = 0;
+    std::exception_ptr exception;
+    try {
+      if (conn == nullptr) conn = co_await open();
+      if (conn->statement_timeout_ms != 0) {
+        std::string set_timeout = "SET statement_timeout = 0";
+        co_await finish(*conn, PQsendQuery(conn->conn, set_timeout.c_str()),
+                        set_timeout);
+        conn->statement_timeout_ms = 0;
+      }
+
+      // Send the command, and wait for the server to start copying or fail.
+      if (!PQsendQuery(conn->conn, command.c_str()))
+        throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+      int flushed;
+      while ((flushed = PQflush(conn->conn)) == 1)
+        co_await conn->loop->writable(conn->fd);
+      if (flushed < 0)
+        throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+      while (PQisBusy(conn->conn)) {
+        co_await conn->loop->readable(conn->fd);
+        if (!PQconsumeInput(conn->conn))
+          throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+      }
+      std::unique_ptr<PGresult, decltype(&PQclear)> started(
+          PQgetResult(conn->conn), PQclear);
+      bool copying = PQresultStatus(started.get()) == PGRES_COPY_OUT;
+      if (copying) {
+        // Read rows as they arrive.
+        char* buffer;
+        int size;
+        while ((size = PQgetCopyData(conn->conn, &buffer, 1)) != -1) {
+          if (size == -2)
+            throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+          if (size == 0) {
+            co_await conn->loop->readable(conn->fd);
+            if (!PQconsumeInput(conn->conn))
+              throw pqxx::broken_connection(PQerrorMessage(conn->conn));
+            continue;
+          }
+          std::unique_ptr<char, decltype(&PQfreemem)> row(buffer, PQfreemem);
+          consume(row.get(), size);
+        }
+      }
+      // Read the outcome of the command, which is an error if it did not
+      // start copying.
+      auto res = co_await finish(*conn, 1, command);
+      if (!copying) {
+        auto sqlstate = PQresultErrorField(started.get(), PG_DIAG_SQLSTATE);
+        throw_sql_error(PQresultErrorMessage(started.get()), command,
+                        sqlstate ? sqlstate : "");
+      }
+      n_rows = res.affected_rows();
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    // Connections left broken or in the middle of a command are closed and
+    // replaced.
+    if (conn && (PQstatus(conn->conn) != CONNECTION_OK ||
+                 PQtransactionStatus(conn->conn) != PQTRANS_IDLE))
+      conn = nullptr;
+    release(std::move(conn));
+    if (exception) std::rethrow_exception(exception);
+    co_return n_rows;
+  }
+};
+
+#endif
@@ -0,0 +1,400 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef ASYNC_RPC__H
+#define ASYNC_RPC__H
+
+#include <buzzblog/shard.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/* Coroutine producing a value of type T. A task starts running when it is
+ * awaited and resumes its awaiter when it completes. Exceptions thrown by the
+ * task are rethrown in the awaiter.
+ */
+template <typename T>
+class Task {
+ public:
+  struct promise_type {
+    std::optional<T> value;
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation;
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> handle) noexcept {
+        return handle.promise().continuation;
+      }
+      void await_resume() noexcept {}
+    };
+
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_value(T v) { value.emplace(std::move(v)); }
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  Task(Task&& other) noexcept : _handle(std::exchange(other._handle, {})) {}
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() {
+    if (_handle) _handle.destroy();
+  }
+
+  bool await_ready() { return false; }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) {
+    _handle.promise().continuation = continuation;
+    return _handle;
+  }
+
+  T await_resume() {
+    if (_handle.promise().exception)
+      std::rethrow_exception(_handle.promise().exception);
+    return std::move(*_handle.promise().value);
+  }
+
+ private:
+  std::coroutine_handle<promise_type> _handle;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+};
+
+namespace detail {
+// Coroutine that starts immediately and destroys itself when it completes.
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Resumes the awaiter once all `n` running tasks have arrived.
+class WhenAllCounter {
+ private:
+  std::atomic<int> _count;
+  std::coroutine_handle<> _continuation;
+  std::mutex _mutex;
+  std::exception_ptr _exception;
+
+ public:
+  explicit WhenAllCounter(const int n) : _count(n + 1) {}
+
+  void set_exception(std::exception_ptr exception) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_exception) _exception = exception;
+  }
+
+  bool failed() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _exception != nullptr;
+  }
+
+  void arrive() {
+    if (--_count == 0) _continuation.resume();
+  }
+
+  bool await_ready() { return false; }
+
+  bool await_suspend(std::coroutine_handle<> continuation) {
+    _continuation = continuation;
+    return --_count > 0;
+  }
+
+  void await_resume() {
+    if (_exception) std::rethrow_exception(_exception);
+  }
+};
+
+template <typename T>
+Detached run_into(Task<T>& task, std::optional<T>& result,
+                  WhenAllCounter& counter) {
+  try {
+    result.emplace(co_await task);
+  } catch (...) {
+    counter.set_exception(std::current_exception());
+  }
+  counter.arrive();
+}
+
+template <typename T>
+Detached run_lane(std::vector<Task<T>>& tasks,
+                  std::vector<std::optional<T>>& results,
+                  std::atomic<size_t>& next, WhenAllCounter& counter) {
+  for (size_t i = next++; i < tasks.size() && !counter.failed(); i = next++) {
+    auto& task = tasks[i];
+    try {
+      results[i].emplace(co_await task);
+    } catch (...) {
+      counter.set_exception(std::current_exception());
+    }
+  }
+  counter.arrive();
+}
+
+template <typename Tasks, typename Results, std::size_t... I>
+void run_all(Tasks& tasks, Results& results, WhenAllCounter& counter,
+             std::index_sequence<I...>) {
+  (run_into(std::get<I>(tasks), std::get<I>(results), counter), ...);
+}
+
+template <typename T>
+struct SyncWaitState {
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool done = false;
+  std::optional<T> value;
+  std::exception_ptr exception;
+};
+
+template <typename T>
+Detached run_sync(Task<T> task, SyncWaitState<T>& state) {
+  std::optional<T> value;
+  std::exception_ptr exception;
+  try {
+    value.emplace(co_await task);
+  } catch (...) {
+    exception = std::current_exception();
+  }
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.value = std::move(value);
+  state.exception = exception;
+  state.done = true;
+  state.condition.notify_one();
+}
+}  // namespace detail
+
+/* Runs the given tasks concurrently and returns their results once all of
+ * them complete. If any task throws, the first exception is rethrown.
+ */
+template <typename... T>
+Task<std::tuple<T...>> when_all(Task<T>... tasks) {
+  std::tuple<Task<T>...> pending(std::move(tasks)...);
+  std::tuple<std::optional<T>...> results;
+  detail::WhenAllCounter counter(sizeof...(T));
+  detail::run_all(pending, results, counter, std::index_sequence_for<T...>{});
+  co_await counter;
+  co_return std::apply(
+      [](auto&... result) { return std::tuple<T...>(std::move(*result)...); },
+      results);
+}
+
+/* Runs the given tasks with at most `max_parallelism` of them running at once
+ * and returns their results in order.
+ */
+template <typename T>
+Task<std::vector<T>> when_all(std::vector<Task<T>> tasks,
+                              const int max_parallelism) {
+  std::vector<std::optional<T>> results(tasks.size());
+  std::atomic<size_t> next(0);
+  int n_lanes = std::min(int(tasks.size()), std::max(1, max_parallelism));
+  detail::WhenAllCounter counter(n_lanes);
+  for (int i = 0; i < n_lanes; i++)
+    detail::run_lane(tasks, results, next, counter);
+  co_await counter;
+  std::vector<T> values;
+  values.reserve(results.size());
+  for (auto& result : results) values.push_back(std::move(*result));
+  co_return values;
+}
+
+/* Blocks the calling thread until the given task completes. Used by Thrift
+ * handlers, which are synchronous, to run coroutines.
+ */
+template <typename T>
+T sync_wait(Task<T> task) {
+  detail::SyncWaitState<T> state;
+  detail::run_sync(std::move(task), state);
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.condition.wait(lock, [&] { return state.done; });
+  if (state.exception) std::rethrow_exception(state.exception);
+  return std::move(*state.value);
+}
+
+/* Thread that waits for socket events with epoll and resumes the coroutines
+ * waiting for them. Coroutines can also be scheduled to be resumed by the
+ * loop from any thread.
+ */
+class EventLoop {
+ private:
+  int _epoll_fd;
+  int _wakeup_fd;
+  bool _stop;
+  std::mutex _mutex;
+  std::vector<std::coroutine_handle<>> _ready;
+  std::thread _thread;
+
+  // Event loops of a shard, used in turn.
+  struct Loops {
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::atomic<unsigned int> next;
+  };
+
+  static PerShard<Loops>& global() {
+    static PerShard<Loops> loops([] { return make_loops(1); });
+    return loops;
+  }
+
+  static std::unique_ptr<Loops> make_loops(const int n_loops) {
+    auto loops = std::make_unique<Loops>();
+    for (int i = 0; i < std::max(1, n_loops); i++)
+      loops->loops.push_back(std::make_unique<EventLoop>());
+    loops->next = 0;
+    return loops;
+  }
+
+  void run() {
+    epoll_event events[64];
+    while (true) {
+      int n_events = epoll_wait(_epoll_fd, events, 64, -1);
+      for (int i = 0; i < n_events; i++) {
+        if (events[i].data.ptr == nullptr) {
+          uint64_t value;
+          if (read(_wakeup_fd, &value, sizeof(value)) < 0) continue;
+        } else {
+          static_cast<IoAwaiter*>(events[i].data.ptr)->handle.resume();
+        }
+      }
+      // Resume scheduled coroutines.
+      std::vector<std::coroutine_handle<>> ready;
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_stop) return;
+        ready.swap(_ready);
+      }
+      for (auto handle : ready) handle.resume();
+    }
+  }
+
+  void wakeup() {
+    uint64_t value = 1;
+    if (write(_wakeup_fd, &value, sizeof(value)) < 0)
+      throw std::runtime_error("Failed to wake up event loop");
+  }
+
+ public:
+  // Suspends a coroutine until a socket is ready for reading or writing.
+  struct IoAwaiter {
+    EventLoop* loop;
+    int fd;
+    uint32_t events;
+    std::coroutine_handle<> handle;
+
+    bool await_ready() { return false; }
+
+    void await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      epoll_event event;
+      event.events = events | EPOLLONESHOT;
+      event.data.ptr = this;
+      if (epoll_ctl(loop->_epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0)
+        throw std::runtime_error("Failed to wait for socket events");
+    }
+
+    void await_resume() {}
+  };
+
+  EventLoop() {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_epoll_fd < 0 || _wakeup_fd < 0)
+      throw std::runtime_error("Failed to create event loop");
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event);
+    _stop = false;
+    _thread = std::thread(&EventLoop::run, this);
+  }
+
+  ~EventLoop() {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    wakeup();
+    _thread.join();
+    close(_wakeup_fd);
+    close(_epoll_fd);
+  }
+
+  /* Sets the number of event loops of every shard, which are started by the
+   * first thread of the shard that needs one. Must be called once, before any
+   * request is served.
+   */
+  static void configure(const int n_loops) {
+    global().configure([=] { return make_loops(n_loops); });
+  }
+
+  // Returns one of the event loops of the calling thread's shard (in turn).
+  static EventLoop* next() {
+    auto& loops = global().get();
+    return loops.loops[loops.next++ % loops.loops.size()].get();
+  }
+
+  // Registers a socket to be waited on with `readable` and `writable`.
+  void add(const int fd) {
+    epoll_event event;
+    event.events = EPOLLONESHOT;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+      throw std::runtime_error("Failed to add socket to event loop");
+  }
+
+  IoAwaiter readable(const int fd) {
+    return IoAwaiter{this, fd, EPOLLIN | EPOLLRDHUP, nullptr};
+  }
+
+  IoAwaiter writable(const int fd) {
+    return IoAwaiter{this, fd, EPOLLOUT, nullptr};
+  }
+
+  // Schedules a suspended coroutine to be resumed by this loop.
+  void post(std::coroutine_handle<> handle) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _ready.push_back(handle);
+    }
+    wakeup();
+  }
+};
+
+template <typename U>
+Task<U> CO_RPC_WRAPPER(Task<U> rpc, std::shared_ptr<spdlog::logger> logger,
+                       const std::string logline) {
+  auto start_time = std::chrono::steady_clock::now();
+  U ret = co_await rpc;
+  std::chrono::duration<double> latency =
+      std::chrono::steady_clock::now() - start_time;
+  if (logger)
+    logger->info((logline + std::string(" lat={}")).c_str(), latency.count());
+  co_return ret;
+}
+
+#endif
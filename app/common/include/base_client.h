@@ -4,23 +4,58 @@
 #ifndef BASE_CLIENT__H
 #define BASE_CLIENT__H
 
+#include <thrift/async/TConcurrentClientSyncInfo.h>
 #include <thrift/protocol/TBinaryProtocol.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TTransportUtils.h>
+#include <thrift/transport/TVirtualTransport.h>
 
 #include <memory>
 #include <string>
+#include <type_traits>
 
 using namespace apache::thrift;
+using namespace apache::thrift::async;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::transport;
 
+/* Socket that closes itself when a read or write fails (e.g., on timeout) or
+ * the server closes the connection, so that a response left unread is never
+ * taken for the response to a later request.
+ */
+class ClientSocket : public TVirtualTransport<ClientSocket, TSocket> {
+ public:
+  ClientSocket(const std::string& host, const int port)
+      : TVirtualTransport<ClientSocket, TSocket>(host, port) {}
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    try {
+      uint32_t n = TSocket::read(buf, len);
+      if (n == 0) close();
+      return n;
+    } catch (...) {
+      close();
+      throw;
+    }
+  }
+
+  void write(const uint8_t* buf, uint32_t len) {
+    try {
+      TSocket::write(buf, len);
+    } catch (...) {
+      close();
+      throw;
+    }
+  }
+};
+
 template <typename T>
 class BaseClient {
  private:
   std::string _ip_address;
   int _port;
-  std::shared_ptr<TSocket> _socket;
+  int _timeout_ms;
+  std::shared_ptr<ClientSocket> _socket;
   std::shared_ptr<TTransport> _transport;
   std::shared_ptr<TProtocol> _protocol;
 
@@ -28,19 +63,41 @@ class BaseClient {
   std::shared_ptr<T> _client;
 
   BaseClient(const std::string& ip_address, const int port,
-             const int conn_timeout_ms) {
+             const int conn_timeout_ms, const bool framed) {
     _ip_address = ip_address;
     _port = port;
-    _socket = std::make_shared<TSocket>(ip_address, port);
+    _timeout_ms = 0;
+    _socket = std::make_shared<ClientSocket>(ip_address, port);
     _socket->setConnTimeout(conn_timeout_ms);
-    _transport = std::make_shared<TBufferedTransport>(_socket);
+    // Servers in nonblocking mode only accept the framed transport.
+    if (framed)
+      _transport = std::make_shared<TFramedTransport>(_socket);
+    else
+      _transport = std::make_shared<TBufferedTransport>(_socket);
     _protocol = std::make_shared<TBinaryProtocol>(_transport);
-    _client = std::make_shared<T>(_protocol);
+    // Concurrent clients synchronize the threads sharing the connection.
+    if constexpr (std::is_constructible<
+                      T, std::shared_ptr<TProtocol>,
+                      std::shared_ptr<TConcurrentClientSyncInfo>>::value)
+      _client = std::make_shared<T>(
+          _protocol, std::make_shared<TConcurrentClientSyncInfo>());
+    else
+      _client = std::make_shared<T>(_protocol);
     _transport->open();
   }
 
   ~BaseClient() { close(); }
 
+  bool is_open() { return _transport->isOpen(); }
+
+  // Sets the send and receive timeouts of the socket (0 disables them).
+  void set_timeout(const int timeout_ms) {
+    if (timeout_ms == _timeout_ms) return;
+    _socket->setSendTimeout(timeout_ms);
+    _socket->setRecvTimeout(timeout_ms);
+    _timeout_ms = timeout_ms;
+  }
+
   void close() {
     if (_transport->isOpen()) _transport->close();
   }
@@ -0,0 +1,73 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef DEADLINE__H
+#define DEADLINE__H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/* Deadlines are absolute times in milliseconds since the Unix epoch, so that
+ * they keep their meaning when passed from one service to another. A deadline
+ * of 0 means that there is no deadline.
+ */
+
+/* Thrown when work for a request is abandoned because its deadline passed. */
+class DeadlineExceededException : public std::runtime_error {
+ public:
+  DeadlineExceededException() : std::runtime_error("Deadline exceeded") {}
+};
+
+int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/* Returns the time left until the deadline (in milliseconds, at least 1), or 0
+ * if there is no deadline. Throws DeadlineExceededException if it passed.
+ */
+int64_t remaining_ms(const int64_t deadline_ms) {
+  if (deadline_ms <= 0) return 0;
+  int64_t remaining = deadline_ms - now_ms();
+  if (remaining <= 0) throw DeadlineExceededException();
+  return remaining;
+}
+
+/* Returns the statement timeout of a query bounded by the deadline (in
+ * milliseconds), or 0 if there is no deadline. The time left is rounded down
+ * to a multiple of the largest power of two up to an eighth of it, so that
+ * queries of requests with similar deadlines share the timeout a connection
+ * already has, and still end before the deadline. Throws
+ * DeadlineExceededException if the deadline passed.
+ */
+int64_t statement_timeout_ms(const int64_t deadline_ms) {
+  int64_t remaining = remaining_ms(deadline_ms);
+  if (remaining == 0) return 0;
+  int64_t step = 1;
+  while (step * 16 <= remaining) step *= 2;
+  return remaining - remaining % step;
+}
+
+/* Returns the deadline of work done on behalf of several requests: the latest
+ * of their deadlines, or 0 if any of them has none.
+ */
+int64_t latest_deadline(const std::vector<int64_t>& deadlines_ms) {
+  int64_t latest = 0;
+  for (auto deadline_ms : deadlines_ms) {
+    if (deadline_ms <= 0) return 0;
+    latest = std::max(latest, deadline_ms);
+  }
+  return latest;
+}
+
+/* Returns the deadline carried by request metadata, or 0 if it has none. */
+template <typename M>
+int64_t get_deadline(const M& request_metadata) {
+  return request_metadata.__isset.deadline ? request_metadata.deadline : 0;
+}
+
+#endif
@@ -0,0 +1,271 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef EXECUTOR__H
+#define EXECUTOR__H
+
+#include <buzzblog/shard.h>
+#include <buzzblog/utils.h>
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Pool of worker threads of a shard of the process (see PerShard) that run
+ * the fan-out work of request handlers (e.g., one RPC per row of a list).
+ * Each worker has its own task queue: a worker pops tasks from the back of
+ * its own queue and, when that queue is empty, steals tasks from the front of
+ * other workers' queues. When the total number of queued tasks reaches
+ * `max_queue_depth`, new tasks run on the submitting thread instead, which
+ * throttles callers.
+ */
+class Executor {
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::vector<std::thread> _threads;
+  int _max_parallelism;
+  int _max_queue_depth;
+  bool _stop;
+  std::mutex _idle_mutex;
+  std::condition_variable _idle_condition;
+  std::atomic<int> _n_idle;
+  std::atomic<unsigned int> _next_worker;
+  // Metrics.
+  std::atomic<int> _queue_depth;
+  std::atomic<long> _n_executed;
+  std::atomic<long> _n_stolen;
+  std::atomic<long> _n_inline;
+  std::thread _metrics_thread;
+  std::shared_ptr<spdlog::logger> _executor_logger;
+
+  static int& worker_index() {
+    static thread_local int index = -1;
+    return index;
+  }
+
+  static PerShard<Executor>& global() {
+    static PerShard<Executor> executors([] {
+      return std::make_unique<Executor>(
+          std::max(1u, std::thread::hardware_concurrency()), 16, 4096, 0);
+    });
+    return executors;
+  }
+
+  bool pop_task(const int index, std::function<void()>& task) {
+    // Pop from the back of this worker's own queue.
+    {
+      auto& worker = *_workers[index];
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      if (!worker.tasks.empty()) {
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+      }
+    }
+    // Steal from the front of other workers' queues.
+    for (int i = 1; i < int(_workers.size()); i++) {
+      auto& victim = *_workers[(index + i) % _workers.size()];
+      std::unique_lock<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        _n_stolen++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run_worker(const int index) {
+    worker_index() = index;
+    std::function<void()> task;
+    while (true) {
+      if (pop_task(index, task)) {
+        _queue_depth--;
+        task();
+        task = nullptr;
+        _n_executed++;
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(_idle_mutex);
+      _n_idle++;
+      _idle_condition.wait(lock,
+                           [this] { return _stop || _queue_depth.load() > 0; });
+      _n_idle--;
+      if (_stop) return;
+    }
+  }
+
+  void run_metrics() {
+    std::unique_lock<std::mutex> lock(_idle_mutex);
+    while (!_idle_condition.wait_for(lock, std::chrono::seconds(1),
+                                     [this] { return _stop; }))
+      _executor_logger->info("qd={} ex={} st={} in={}", _queue_depth.load(),
+                             _n_executed.load(), _n_stolen.load(),
+                             _n_inline.load());
+  }
+
+ public:
+  Executor(const int n_threads, const int max_parallelism,
+           const int max_queue_depth, const int logging) {
+    _max_parallelism = max_parallelism;
+    _max_queue_depth = max_queue_depth;
+    _stop = false;
+    _n_idle = 0;
+    _next_worker = 0;
+    _queue_depth = 0;
+    _n_executed = 0;
+    _n_stolen = 0;
+    _n_inline = 0;
+
+    // Start workers.
+    for (int i = 0; i < n_threads; i++)
+      _workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < n_threads; i++)
+      _threads.emplace_back(&Executor::run_worker, this, i);
+
+    // Periodically log metrics.
+    if (logging) {
+      _executor_logger = get_logger("executor_logger", "/tmp/executor.log");
+      _metrics_thread = std::thread(&Executor::run_metrics, this);
+    } else {
+      _executor_logger = nullptr;
+    }
+  }
+
+  ~Executor() {
+    {
+      std::unique_lock<std::mutex> lock(_idle_mutex);
+      _stop = true;
+    }
+    _idle_condition.notify_all();
+    for (auto& thread : _threads) thread.join();
+    if (_metrics_thread.joinable()) _metrics_thread.join();
+  }
+
+  /* Sets the size and limits of the executors of all shards. Must be called
+   * once, before any request is served.
+   */
+  static void configure(const int n_threads, const int max_parallelism,
+                        const int max_queue_depth, const int logging) {
+    global().configure([=] {
+      return std::make_unique<Executor>(
+          std::max(1, n_threads), std::max(1, max_parallelism),
+          std::max(1, max_queue_depth), logging);
+    });
+  }
+
+  // Returns the executor of the calling thread's shard.
+  static Executor& instance() { return global().get(); }
+
+  // Default max number of tasks of a single request running at once.
+  int max_parallelism() { return _max_parallelism; }
+
+  void submit(std::function<void()> task) {
+    if (_queue_depth.load() >= _max_queue_depth) {
+      // Executor is saturated: run the task on the caller's thread.
+      _n_inline++;
+      task();
+      return;
+    }
+    int index = worker_index();
+    if (index < 0) index = _next_worker++ % _workers.size();
+    {
+      auto& worker = *_workers[index];
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      worker.tasks.push_back(std::move(task));
+    }
+    _queue_depth++;
+    if (_n_idle.load() > 0) {
+      // Synchronize with workers going idle so that the wakeup is not lost.
+      { std::unique_lock<std::mutex> lock(_idle_mutex); }
+      _idle_condition.notify_one();
+    }
+  }
+};
+
+/* Set of tasks submitted on behalf of a single request. At most
+ * `max_parallelism` of them run at once; the others wait in the group until
+ * a running task finishes. Destroying the group discards tasks that have not
+ * started and waits for running ones, so tasks may safely capture the
+ * handler's stack by reference.
+ */
+class TaskGroup {
+ private:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::function<void()>> pending;
+    int n_running;
+    int max_parallelism;
+  };
+
+  Executor& _executor;
+  std::shared_ptr<State> _state;
+
+  static void run(std::shared_ptr<State> state, std::function<void()> task) {
+    // Keep draining the group's pending tasks with this worker.
+    while (task) {
+      task();
+      std::unique_lock<std::mutex> lock(state->mutex);
+      if (state->pending.empty()) {
+        task = nullptr;
+        state->n_running--;
+        state->condition.notify_all();
+      } else {
+        task = std::move(state->pending.front());
+        state->pending.pop_front();
+      }
+    }
+  }
+
+ public:
+  TaskGroup() : TaskGroup(Executor::instance().max_parallelism()) {}
+
+  TaskGroup(const int max_parallelism) : _executor(Executor::instance()) {
+    _state = std::make_shared<State>();
+    _state->n_running = 0;
+    _state->max_parallelism = std::max(1, max_parallelism);
+  }
+
+  ~TaskGroup() {
+    std::unique_lock<std::mutex> lock(_state->mutex);
+    _state->pending.clear();
+    _state->condition.wait(lock, [this] { return _state->n_running == 0; });
+  }
+
+  template <typename F>
+  std::future<decltype(std::declval<F>()())> submit(F&& f) {
+    auto task = std::make_shared<std::packaged_task<decltype(f())()>>(
+        std::forward<F>(f));
+    auto future = task->get_future();
+    std::function<void()> closure = [task] { (*task)(); };
+    {
+      std::unique_lock<std::mutex> lock(_state->mutex);
+      if (_state->n_running >= _state->max_parallelism) {
+        _state->pending.push_back(std::move(closure));
+        return future;
+      }
+      _state->n_running++;
+    }
+    auto state = _state;
+    _executor.submit([state, closure] { run(state, closure); });
+    return future;
+  }
+};
+
+#endif
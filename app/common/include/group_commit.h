@@ -0,0 +1,116 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef GROUP_COMMIT__H
+#define GROUP_COMMIT__H
+
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Merges rows submitted concurrently by different threads into batches that
+ * are committed at once, e.g., with one multi-row INSERT in one transaction,
+ * so that the database syncs its log once per batch instead of once per row.
+ * The first thread to submit a row to a batch leads it: it waits up to
+ * `window_us` microseconds for other rows (or until the batch holds
+ * `max_batch_size` rows), commits the batch, and hands every thread the result
+ * of its own row. If committing a batch fails, all of its threads get the
+ * error.
+ */
+template <typename Row, typename Result>
+class GroupCommitter {
+ private:
+  struct Batch {
+    std::vector<Row> rows;
+    std::vector<Result> results;
+    std::exception_ptr error;
+    bool done;
+    std::condition_variable done_condition;
+  };
+
+  std::string _label;
+  std::chrono::microseconds _window;
+  size_t _max_batch_size;
+  std::function<std::vector<Result>(const std::vector<Row>&)> _commit;
+  std::shared_ptr<spdlog::logger> _group_commit_logger;
+  // Batch that accepts rows, if any.
+  std::shared_ptr<Batch> _open_batch;
+  std::mutex _mutex;
+  std::condition_variable _full_condition;
+
+  void commit(Batch* batch) {
+    auto start_time = std::chrono::steady_clock::now();
+    try {
+      batch->results = _commit(batch->rows);
+    } catch (...) {
+      batch->error = std::current_exception();
+    }
+    std::chrono::duration<double> latency =
+        std::chrono::steady_clock::now() - start_time;
+    if (_group_commit_logger)
+      _group_commit_logger->info("{} bs={} lat={}", _label, batch->rows.size(),
+                                 latency.count());
+  }
+
+ public:
+  /* `commit` commits a batch of rows and returns the result of each row, in
+   * order. `label` prefixes the lines logged for every batch.
+   */
+  GroupCommitter(
+      const std::string& label, const int window_us, const int max_batch_size,
+      std::function<std::vector<Result>(const std::vector<Row>&)> commit,
+      std::shared_ptr<spdlog::logger> group_commit_logger) {
+    _label = label;
+    _window = std::chrono::microseconds(window_us);
+    _max_batch_size = std::max(1, max_batch_size);
+    _commit = commit;
+    _group_commit_logger = group_commit_logger;
+  }
+
+  /* Submits a row and waits until its batch is committed. Returns the result
+   * of the row or throws the error of the batch.
+   */
+  Result submit(const Row& row) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto batch = _open_batch;
+    bool leader = !batch;
+    if (leader) {
+      batch = std::make_shared<Batch>();
+      batch->done = false;
+      _open_batch = batch;
+    }
+    size_t index = batch->rows.size();
+    batch->rows.push_back(row);
+    if (batch->rows.size() >= _max_batch_size) {
+      // Close the batch and let its leader commit it right away.
+      _open_batch = nullptr;
+      if (!leader) _full_condition.notify_all();
+    }
+
+    if (leader) {
+      _full_condition.wait_for(lock, _window,
+                               [&] { return _open_batch != batch; });
+      if (_open_batch == batch) _open_batch = nullptr;
+      lock.unlock();
+      commit(batch.get());
+      lock.lock();
+      batch->done = true;
+      batch->done_condition.notify_all();
+    } else {
+      batch->done_condition.wait(lock, [&] { return batch->done; });
+    }
+
+    if (batch->error) std::rethrow_exception(batch->error);
+    return batch->results.at(index);
+  }
+};
+
+#endif
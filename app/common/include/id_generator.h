@@ -0,0 +1,136 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef ID_GENERATOR__H
+#define ID_GENERATOR__H
+
+#include <buzzblog/deadline.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+/* Process-wide generator of 64-bit ids that sort by creation time (Snowflake
+ * ids), so that services assign ids to rows before inserting them and rows
+ * are ordered by creation time along their primary key. From the most
+ * significant bit down, an id holds:
+ *   - a 0 sign bit;
+ *   - 41 bits of milliseconds since kEpochMs (about 69 years);
+ *   - 10 bits of node id, unique to each server generating ids;
+ *   - 12 bits of sequence number within the millisecond.
+ * Ids of a node are strictly increasing. When the clock goes backwards, or
+ * more than 4096 ids are generated in a millisecond, ids are taken from the
+ * following milliseconds instead of waiting for the clock.
+ */
+class IdGenerator {
+ private:
+  static constexpr int kNodeBits = 10;
+  static constexpr int kSequenceBits = 12;
+  static constexpr int64_t kMaxSequence = int64_t(1) << kSequenceBits;
+  // 2022-01-01T00:00:00Z.
+  static constexpr int64_t kEpochMs = 1640995200000;
+
+  int64_t _node_id;
+  std::mutex _mutex;
+  // Millisecond and sequence number of the last generated id.
+  int64_t _last_ms;
+  int64_t _last_sequence;
+
+  static std::unique_ptr<IdGenerator>& global() {
+    static std::unique_ptr<IdGenerator> generator;
+    return generator;
+  }
+
+ public:
+  static constexpr int kMaxNodeId = (1 << kNodeBits) - 1;
+
+  IdGenerator(const int node_id) {
+    if (node_id < 0 || node_id > kMaxNodeId)
+      throw std::invalid_argument("Invalid node id: " +
+                                  std::to_string(node_id));
+    _node_id = node_id;
+    _last_ms = 0;
+    _last_sequence = -1;
+  }
+
+  /* Creates the process-wide id generator. Must be called once, before any
+   * request is served, with a node id unique to this server.
+   */
+  static void configure(const int node_id) {
+    global() = std::make_unique<IdGenerator>(node_id);
+  }
+
+  /* Returns the process-wide id generator. There is no default node id, as
+   * servers sharing it would generate the same ids.
+   */
+  static IdGenerator& instance() {
+    if (!global())
+      throw std::logic_error("The id generator has no node id (see configure)");
+    return *global();
+  }
+
+  /* Returns the node id given by the `node_id` option of a server: a number,
+   * or "hostname" for the number that ends the hostname of the server (e.g.,
+   * 3 for "post-3", as Kubernetes names the pods of a StatefulSet).
+   */
+  static int parse_node_id(const std::string& node_id) {
+    std::string number = node_id;
+    if (node_id == "hostname") {
+      char hostname[256] = "";
+      gethostname(hostname, sizeof(hostname) - 1);
+      number = hostname;
+      auto start = number.find_last_not_of("0123456789");
+      number = start == std::string::npos ? number : number.substr(start + 1);
+      if (number.empty())
+        throw std::invalid_argument("Hostname " + std::string(hostname) +
+                                    " does not end with a node id");
+    }
+    if (number.empty() || number.size() > 4 ||
+        number.find_first_not_of("0123456789") != std::string::npos)
+      throw std::invalid_argument("Invalid node id: " + node_id +
+                                  " (expected 0-1023 or \"hostname\")");
+    return std::stoi(number);
+  }
+
+  /* Returns the smallest id that can be generated at a time (in milliseconds
+   * since the Unix epoch), so that rows created from that time on are those
+   * with greater or equal ids.
+   */
+  static int64_t min_id_at(const int64_t time_ms) {
+    return std::max(time_ms - kEpochMs, int64_t(0))
+           << (kNodeBits + kSequenceBits);
+  }
+
+  /* Returns a new id. If `n_shards` is greater than 1, the id is congruent to
+   * `shard` modulo `n_shards`, so that the shard of a row can be found from
+   * its id (which skips up to `n_shards - 1` sequence numbers).
+   */
+  int64_t next(const int shard = 0, const int n_shards = 1) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    int64_t ms = std::max(now_ms() - kEpochMs, _last_ms);
+    int64_t sequence = ms == _last_ms ? _last_sequence + 1 : 0;
+    while (true) {
+      if (sequence >= kMaxSequence) {
+        ms++;
+        sequence = 0;
+      }
+      int64_t id = (ms << (kNodeBits + kSequenceBits)) |
+                   (_node_id << kSequenceBits) | sequence;
+      // Skip to the next sequence number of the shard.
+      int64_t skip =
+          ((shard - id % n_shards) % n_shards + n_shards) % n_shards;
+      if (sequence + skip < kMaxSequence) {
+        _last_ms = ms;
+        _last_sequence = sequence + skip;
+        return id + skip;
+      }
+      sequence = kMaxSequence;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,454 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef LOCKFREE_CONNECTION_POOL__H
+#define LOCKFREE_CONNECTION_POOL__H
+
+#include <assert.h>
+#include <buzzblog/deadline.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Returns a new identifier for a connection pool, used to index per-thread
+ * caches.
+ */
+size_t next_connection_pool_id() {
+  static std::atomic<size_t> next_id(0);
+  return next_id++;
+}
+
+/* Process-wide thread that resizes connection pools every second. */
+class ConnectionPoolSizer {
+ private:
+  std::map<size_t, std::function<void()>> _pools;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _stop;
+  std::thread _thread;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_condition.wait_for(lock, std::chrono::seconds(1),
+                                [this] { return _stop; }))
+      for (const auto& it : _pools) it.second();
+  }
+
+ public:
+  ConnectionPoolSizer() {
+    _stop = false;
+    _thread = std::thread(&ConnectionPoolSizer::run, this);
+  }
+
+  ~ConnectionPoolSizer() {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+  }
+
+  static ConnectionPoolSizer& instance() {
+    static ConnectionPoolSizer sizer;
+    return sizer;
+  }
+
+  void add(const size_t pool_id, std::function<void()> resize) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _pools[pool_id] = resize;
+  }
+
+  // Once it returns, the pool is not being resized and will not be again.
+  void remove(const size_t pool_id) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _pools.erase(pool_id);
+  }
+};
+
+template <typename T>
+class LockFreeConnectionPool;
+
+/* RAII handle of a connection leased from a LockFreeConnectionPool. The
+ * connection returns to the pool when the lease is destroyed, also when an
+ * exception is thrown while using it.
+ */
+template <typename T>
+class ConnectionLease {
+ private:
+  LockFreeConnectionPool<T>* _pool;
+  // Slot of a pooled connection, or -1 for ephemeral connections.
+  int _slot;
+  T* _conn;
+  std::unique_ptr<T> _ephemeral_conn;
+
+ public:
+  ConnectionLease(LockFreeConnectionPool<T>* pool, const int slot, T* conn) {
+    _pool = pool;
+    _slot = slot;
+    _conn = conn;
+  }
+
+  ConnectionLease(std::unique_ptr<T> ephemeral_conn) {
+    _pool = nullptr;
+    _slot = -1;
+    _conn = ephemeral_conn.get();
+    _ephemeral_conn = std::move(ephemeral_conn);
+  }
+
+  ConnectionLease(ConnectionLease&& other) noexcept {
+    _pool = other._pool;
+    _slot = other._slot;
+    _conn = other._conn;
+    _ephemeral_conn = std::move(other._ephemeral_conn);
+    other._pool = nullptr;
+    other._slot = -1;
+    other._conn = nullptr;
+  }
+
+  ConnectionLease(const ConnectionLease&) = delete;
+  ConnectionLease& operator=(const ConnectionLease&) = delete;
+  ConnectionLease& operator=(ConnectionLease&&) = delete;
+
+  ~ConnectionLease() {
+    if (_pool && _slot >= 0) _pool->release(_slot);
+  }
+
+  T* get() const { return _conn; }
+  T* operator->() const { return _conn; }
+  T& operator*() const { return *_conn; }
+};
+
+/* Connection pool whose fast path takes no lock. Connections live in a fixed
+ * array of `max_size` slots. Idle slots are kept in a lock-free stack, and
+ * every thread caches the last slot it released, which it takes back on its
+ * next lease without touching the shared stack. Cached slots that their thread
+ * does not need can be stolen by other threads, so caching never makes a
+ * thread wait for a connection that sits idle. Only threads that find the pool
+ * exhausted block, on a condition variable that releasing threads signal only
+ * when someone waits.
+ *
+ * The pool sizes itself between `min_size` and `max_size` connections (AIMD):
+ * its size limit grows by one whenever the average time threads wait for a
+ * connection exceeds kTargetWait, and every second it shrinks by half of the
+ * connections that sat idle during that second if no thread waited. Ephemeral
+ * connections are only opened once the limit reaches `max_size`.
+ */
+template <typename T>
+class LockFreeConnectionPool {
+ private:
+  enum SlotState { EMPTY, IDLE, CACHED, IN_USE };
+
+  struct Slot {
+    std::atomic<int> state;
+    // Index (+1) of the next slot in the stack it belongs to (0 ends it).
+    std::atomic<uint32_t> next;
+    // Whether the slot was leased since the pool was last resized.
+    std::atomic<bool> used;
+    std::unique_ptr<T> conn;
+  };
+
+  // Average wait (in seconds) above which the pool grows.
+  static constexpr double kTargetWait = 0.001;
+
+  size_t _id;
+  int _min_size;
+  int _max_size;
+  bool _allow_ephemeral;
+  std::function<std::unique_ptr<T>()> _open;
+  std::unique_ptr<Slot[]> _slots;
+  // Stacks of idle slots and of slots without a connection. Heads pack an ABA
+  // tag in the upper 32 bits and the index (+1) of the top slot in the lower
+  // 32 bits.
+  std::atomic<uint64_t> _idle_head;
+  std::atomic<uint64_t> _empty_head;
+  // Number of slots holding a connection, and max number allowed.
+  std::atomic<int> _size;
+  std::atomic<int> _limit;
+  std::function<void(int)> _on_resize;
+  std::atomic<int> _waiters;
+  // Number of threads that waited since the pool was last resized.
+  std::atomic<int> _n_waits;
+  std::mutex _waiters_mutex;
+  std::condition_variable _waiters_condition;
+  // Moving average of the time waited for a connection (in seconds), updated
+  // only by threads that wait, and time of the last update.
+  std::atomic<double> _wait_time;
+  std::atomic<int64_t> _last_wait_time;
+
+  void push(std::atomic<uint64_t>& head, const int slot) {
+    uint64_t old_head = head.load();
+    uint64_t new_head;
+    do {
+      _slots[slot].next.store(uint32_t(old_head));
+      new_head = (((old_head >> 32) + 1) << 32) | uint64_t(slot + 1);
+    } while (!head.compare_exchange_weak(old_head, new_head));
+  }
+
+  int pop(std::atomic<uint64_t>& head) {
+    uint64_t old_head = head.load();
+    uint64_t new_head;
+    do {
+      if (uint32_t(old_head) == 0) return -1;
+      uint32_t next = _slots[uint32_t(old_head) - 1].next.load();
+      new_head = (((old_head >> 32) + 1) << 32) | uint64_t(next);
+    } while (!head.compare_exchange_weak(old_head, new_head));
+    return int(uint32_t(old_head)) - 1;
+  }
+
+  // Slot cached by the calling thread (-1 if none).
+  int& cached_slot() {
+    thread_local std::vector<int> cached_slots;
+    if (cached_slots.size() <= _id) cached_slots.resize(_id + 1, -1);
+    return cached_slots[_id];
+  }
+
+  bool claim(const int slot, int expected_state) {
+    return _slots[slot].state.compare_exchange_strong(expected_state, IN_USE);
+  }
+
+  // Opens a connection in an empty slot, if the pool is not full.
+  int grow() {
+    int size = _size.load();
+    do {
+      if (size >= _limit.load()) return -1;
+    } while (!_size.compare_exchange_weak(size, size + 1));
+    int slot = pop(_empty_head);
+    assert(slot >= 0);
+    try {
+      _slots[slot].conn = _open();
+    } catch (...) {
+      push(_empty_head, slot);
+      _size--;
+      notify_waiter();
+      throw;
+    }
+    _slots[slot].state.store(IN_USE);
+    return slot;
+  }
+
+  // Takes a connection cached by another thread.
+  int steal() {
+    for (int slot = 0; slot < _max_size; slot++)
+      if (_slots[slot].state.load() == CACHED && claim(slot, CACHED))
+        return slot;
+    return -1;
+  }
+
+  int try_acquire() {
+    int slot = cached_slot();
+    if (slot >= 0 && claim(slot, CACHED)) return slot;
+    if (_size.load() < _min_size && (slot = grow()) >= 0) return slot;
+    if ((slot = pop(_idle_head)) >= 0) {
+      _slots[slot].state.store(IN_USE);
+      return slot;
+    }
+    if ((slot = grow()) >= 0) return slot;
+    return steal();
+  }
+
+  // Closes the connection of a slot owned by the caller.
+  void close(const int slot) {
+    _slots[slot].conn.reset();
+    _slots[slot].state.store(EMPTY);
+    push(_empty_head, slot);
+    _size--;
+    notify_waiter();
+  }
+
+  void set_limit(const int limit) {
+    if (_limit.exchange(limit) != limit && _on_resize) _on_resize(limit);
+  }
+
+  // Additive increase: grows the limit by one connection.
+  void grow_limit() {
+    int limit = _limit.load();
+    do {
+      if (limit >= _max_size) return;
+    } while (!_limit.compare_exchange_weak(limit, limit + 1));
+    if (_on_resize) _on_resize(limit + 1);
+    notify_waiter();
+  }
+
+  // Multiplicative decrease: shrinks the limit by half of the connections
+  // that sat idle since the last call, unless a thread waited meanwhile, and
+  // closes idle connections above the limit.
+  void shrink_limit() {
+    int idle = 0;
+    for (int slot = 0; slot < _max_size; slot++) {
+      if (_slots[slot].used.exchange(false)) continue;
+      int state = _slots[slot].state.load();
+      if (state == IDLE || state == CACHED) idle++;
+    }
+    if (_n_waits.exchange(0) > 0 || idle == 0) return;
+    set_limit(std::max(std::max(1, _min_size), _limit.load() - (idle + 1) / 2));
+    while (_size.load() > _limit.load()) {
+      int slot = pop(_idle_head);
+      if (slot >= 0)
+        _slots[slot].state.store(IN_USE);
+      else if ((slot = steal()) < 0)
+        break;
+      close(slot);
+    }
+  }
+
+  void record_wait(const double sample) {
+    // Averages older than a second are stale: start over.
+    const double alpha = 0.2;
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    bool stale = now - _last_wait_time.exchange(now) > 1000;
+    double old_wait_time = _wait_time.load();
+    double new_wait_time;
+    do {
+      new_wait_time =
+          stale ? sample : alpha * sample + (1 - alpha) * old_wait_time;
+    } while (!_wait_time.compare_exchange_weak(old_wait_time, new_wait_time));
+    _n_waits++;
+    if (new_wait_time > kTargetWait) grow_limit();
+  }
+
+  void notify_waiter() {
+    if (_waiters.load() > 0) {
+      std::unique_lock<std::mutex> lock(_waiters_mutex);
+      _waiters_condition.notify_one();
+    }
+  }
+
+ public:
+  LockFreeConnectionPool(const int min_size, const int max_size,
+                         const bool allow_ephemeral,
+                         std::function<std::unique_ptr<T>()> open) {
+    _id = next_connection_pool_id();
+    _min_size = min_size;
+    _max_size = max_size;
+    _allow_ephemeral = allow_ephemeral;
+    _open = open;
+    _slots.reset(new Slot[std::max(1, max_size)]);
+    _idle_head = 0;
+    _empty_head = 0;
+    _size = 0;
+    _limit = std::min(max_size, std::max(1, min_size));
+    _waiters = 0;
+    _n_waits = 0;
+    _wait_time = 0;
+    _last_wait_time = 0;
+    for (int slot = max_size - 1; slot >= 0; slot--) {
+      _slots[slot].state = EMPTY;
+      _slots[slot].used = false;
+      push(_empty_head, slot);
+    }
+
+    // Validate connection pool parameters.
+    assert(_min_size >= 0);
+    assert(_max_size >= 0);
+    assert(_max_size >= _min_size);
+
+    // Resize the pool periodically.
+    if (_max_size > 0)
+      ConnectionPoolSizer::instance().add(_id, [this] { shrink_limit(); });
+  }
+
+  ~LockFreeConnectionPool() {
+    if (_max_size > 0) ConnectionPoolSizer::instance().remove(_id);
+  }
+
+  // Sets a function called with the new size limit whenever it changes.
+  void on_resize(std::function<void(int)> callback) { _on_resize = callback; }
+
+  /* Leases a connection. If the pool is exhausted and ephemeral connections
+   * are not allowed, waits for a connection to be released, but not past
+   * `deadline_ms` (see deadline.h), after which DeadlineExceededException is
+   * thrown. `backlog_len`, if given, is set to the number of threads waiting
+   * (including the caller) or to 0 if the caller did not wait.
+   */
+  ConnectionLease<T> lease(int* backlog_len = nullptr,
+                           const int64_t deadline_ms = 0) {
+    if (backlog_len) *backlog_len = 0;
+    if (_max_size == 0) return ConnectionLease<T>(_open());
+    int slot = try_acquire();
+    if (slot < 0 && _allow_ephemeral && _limit.load() >= _max_size)
+      return ConnectionLease<T>(_open());
+    if (slot < 0) {
+      int waiters = ++_waiters;
+      if (backlog_len) *backlog_len = waiters;
+      auto start_time = std::chrono::steady_clock::now();
+      std::unique_lock<std::mutex> lock(_waiters_mutex);
+      std::chrono::system_clock::time_point deadline{
+          std::chrono::milliseconds(deadline_ms)};
+      try {
+        while ((slot = try_acquire()) < 0) {
+          if (deadline_ms <= 0)
+            _waiters_condition.wait(lock);
+          else if (std::chrono::system_clock::now() >= deadline)
+            throw DeadlineExceededException();
+          else
+            _waiters_condition.wait_until(lock, deadline);
+        }
+      } catch (...) {
+        _waiters--;
+        lock.unlock();
+        record_wait(std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start_time)
+                        .count());
+        throw;
+      }
+      _waiters--;
+      lock.unlock();
+      record_wait(std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start_time)
+                      .count());
+    }
+    _slots[slot].used.store(true, std::memory_order_relaxed);
+    return ConnectionLease<T>(this, slot, _slots[slot].conn.get());
+  }
+
+  void release(const int slot) {
+    // Close connections above the size limit.
+    if (_size.load() > _limit.load()) {
+      close(slot);
+      return;
+    }
+    // Cache the connection for the calling thread unless threads are waiting
+    // for one. The cache is published before checking for waiters, so that a
+    // thread that starts waiting afterwards finds it when stealing.
+    int& cached = cached_slot();
+    if (cached < 0 || cached == slot ||
+        _slots[cached].state.load() != CACHED) {
+      _slots[slot].state.store(CACHED);
+      cached = slot;
+      if (_waiters.load() == 0 || !claim(slot, CACHED)) return;
+    }
+    _slots[slot].state.store(IDLE);
+    push(_idle_head, slot);
+    notify_waiter();
+  }
+
+  int size() { return _size.load(); }
+
+  int limit() { return _limit.load(); }
+
+  // Number of threads waiting for a connection.
+  int backlog() { return _waiters.load(); }
+
+  // Recent average time waited for a connection (in seconds), or 0 if no
+  // thread waited in the last second.
+  double wait_time() {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    return now - _last_wait_time.load() > 1000 ? 0 : _wait_time.load();
+  }
+};
+
+#endif
@@ -5,7 +5,11 @@
 #define MICROSERVICE_CONNECTED_SERVER__H
 
 #include <buzzblog/account_client.h>
+#include <buzzblog/admission_control.h>
+#include <buzzblog/async_connection_pool.h>
+#include <buzzblog/async_rpc.h>
 #include <buzzblog/base_server.h>
+#include <buzzblog/deadline.h>
 #include <buzzblog/follow_client.h>
 #include <buzzblog/like_client.h>
 #include <buzzblog/microservice_connection_pool.h>
@@ -39,6 +43,10 @@ class MicroserviceConnectedServer : public BaseServer {
 
     // Process backend configuration.
     std::map<std::string, std::vector<std::pair<std::string, int>>> service;
+    std::map<std::string, bool> framed;
+    std::map<std::string, std::string> load_balancing;
+    std::map<std::string, int> requests_per_connection;
+    std::map<std::string, int> connection_timeout_ms;
     for (const auto& it : backend_conf) {
       auto service_name = it.first.as<std::string>();
       auto service_conf = it.second;
@@ -54,21 +62,38 @@ class MicroserviceConnectedServer : public BaseServer {
           stdout_log("Added " + service_name +
                      " service on: " + server_address);
         }
+        // Services running in nonblocking mode require the framed transport.
+        framed[service_name] =
+            service_conf["transport"] &&
+            service_conf["transport"].as<std::string>() == "framed";
+        // Time allowed to establish a connection.
+        connection_timeout_ms[service_name] =
+            service_conf["connection_timeout_ms"]
+                ? service_conf["connection_timeout_ms"].as<int>()
+                : 30000;
+        // Requests that can be in flight on a connection at the same time.
+        requests_per_connection[service_name] =
+            service_conf["requests_per_connection"]
+                ? service_conf["requests_per_connection"].as<int>()
+                : 1;
+        // Policy used to pick a replica for each request.
+        if (service_conf["load_balancing"])
+          load_balancing[service_name] =
+              service_conf["load_balancing"].as<std::string>();
       }
     }
 
     // Initialize loggers.
     std::shared_ptr<spdlog::logger> rpc_conn_logger;
+    std::shared_ptr<spdlog::logger> pool_logger;
     if (logging) {
-      _rpc_call_logger =
-          spdlog::basic_logger_mt("rpc_call_logger", "/tmp/rpc_call.log");
-      _rpc_call_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
-      rpc_conn_logger =
-          spdlog::basic_logger_mt("rpc_conn_logger", "/tmp/rpc_conn.log");
-      rpc_conn_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _rpc_call_logger = get_logger("rpc_call_logger", "/tmp/rpc_call.log");
+      rpc_conn_logger = get_logger("rpc_conn_logger", "/tmp/rpc_conn.log");
+      pool_logger = get_logger("pool_logger", "/tmp/pool.log");
     } else {
       _rpc_call_logger = nullptr;
       rpc_conn_logger = nullptr;
+      pool_logger = nullptr;
     }
 
     // Initialize connection pools.
@@ -77,69 +102,119 @@ class MicroserviceConnectedServer : public BaseServer {
             local_service_name, "account", service["account"],
             microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
-            microservice_connection_pool_allow_ephemeral, 30000,
-            rpc_conn_logger);
+            microservice_connection_pool_allow_ephemeral,
+            connection_timeout_ms["account"], framed["account"],
+            requests_per_connection["account"], load_balancing["account"],
+            rpc_conn_logger, pool_logger);
     _follow_cp =
         std::make_shared<MicroserviceConnectionPool<follow_service::Client>>(
             local_service_name, "follow", service["follow"],
             microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
-            microservice_connection_pool_allow_ephemeral, 30000,
-            rpc_conn_logger);
+            microservice_connection_pool_allow_ephemeral,
+            connection_timeout_ms["follow"], framed["follow"],
+            requests_per_connection["follow"], load_balancing["follow"],
+            rpc_conn_logger, pool_logger);
     _like_cp =
         std::make_shared<MicroserviceConnectionPool<like_service::Client>>(
             local_service_name, "like", service["like"],
             microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
-            microservice_connection_pool_allow_ephemeral, 30000,
-            rpc_conn_logger);
+            microservice_connection_pool_allow_ephemeral,
+            connection_timeout_ms["like"], framed["like"],
+            requests_per_connection["like"], load_balancing["like"],
+            rpc_conn_logger, pool_logger);
     _post_cp =
         std::make_shared<MicroserviceConnectionPool<post_service::Client>>(
             local_service_name, "post", service["post"],
             microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
-            microservice_connection_pool_allow_ephemeral, 30000,
-            rpc_conn_logger);
+            microservice_connection_pool_allow_ephemeral,
+            connection_timeout_ms["post"], framed["post"],
+            requests_per_connection["post"], load_balancing["post"],
+            rpc_conn_logger, pool_logger);
     _uniquepair_cp = std::make_shared<
         MicroserviceConnectionPool<uniquepair_service::Client>>(
         local_service_name, "uniquepair", service["uniquepair"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, 30000, rpc_conn_logger);
+        microservice_connection_pool_allow_ephemeral,
+        connection_timeout_ms["uniquepair"], framed["uniquepair"],
+        requests_per_connection["uniquepair"], load_balancing["uniquepair"],
+        rpc_conn_logger, pool_logger);
     _trending_cp =
         std::make_shared<MicroserviceConnectionPool<trending_service::Client>>(
             local_service_name, "trending", service["trending"],
             microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
-            microservice_connection_pool_allow_ephemeral, 30000,
-            rpc_conn_logger);
+            microservice_connection_pool_allow_ephemeral,
+            connection_timeout_ms["trending"], framed["trending"],
+            requests_per_connection["trending"], load_balancing["trending"],
+            rpc_conn_logger, pool_logger);
     _wordfilter_cp = std::make_shared<
         MicroserviceConnectionPool<wordfilter_service::Client>>(
         local_service_name, "wordfilter", service["wordfilter"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, 30000, rpc_conn_logger);
+        microservice_connection_pool_allow_ephemeral,
+        connection_timeout_ms["wordfilter"], framed["wordfilter"],
+        requests_per_connection["wordfilter"], load_balancing["wordfilter"],
+        rpc_conn_logger, pool_logger);
+
+    // Initialize asynchronous connection pools.
+    _account_async_cp =
+        std::make_shared<AsyncConnectionPool<TAccountServiceClient>>(
+            local_service_name, "account", service["account"],
+            microservice_connection_pool_min_size,
+            microservice_connection_pool_max_size,
+            microservice_connection_pool_allow_ephemeral, framed["account"],
+            rpc_conn_logger);
+    _follow_async_cp =
+        std::make_shared<AsyncConnectionPool<TFollowServiceClient>>(
+            local_service_name, "follow", service["follow"],
+            microservice_connection_pool_min_size,
+            microservice_connection_pool_max_size,
+            microservice_connection_pool_allow_ephemeral, framed["follow"],
+            rpc_conn_logger);
+    _like_async_cp = std::make_shared<AsyncConnectionPool<TLikeServiceClient>>(
+        local_service_name, "like", service["like"],
+        microservice_connection_pool_min_size,
+        microservice_connection_pool_max_size,
+        microservice_connection_pool_allow_ephemeral, framed["like"],
+        rpc_conn_logger);
+    _post_async_cp = std::make_shared<AsyncConnectionPool<TPostServiceClient>>(
+        local_service_name, "post", service["post"],
+        microservice_connection_pool_min_size,
+        microservice_connection_pool_max_size,
+        microservice_connection_pool_allow_ephemeral, framed["post"],
+        rpc_conn_logger);
+
+    // Count waits for connections towards the load of the process.
+    auto& admission = AdmissionController::instance();
+    add_pool(admission, _account_cp);
+    add_pool(admission, _follow_cp);
+    add_pool(admission, _like_cp);
+    add_pool(admission, _post_cp);
+    add_pool(admission, _uniquepair_cp);
+    add_pool(admission, _trending_cp);
+    add_pool(admission, _wordfilter_cp);
+    add_pool(admission, _account_async_cp);
+    add_pool(admission, _follow_async_cp);
+    add_pool(admission, _like_async_cp);
+    add_pool(admission, _post_async_cp);
   }
 
   // Account RPCs
   TAccount rpc_authenticate_user(const TRequestMetadata& request_metadata,
                                  const std::string& username,
                                  const std::string& password) {
-    TAccount res;
-    auto account_client = _account_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TAccount>(
-          std::bind(&account_service::Client::authenticate_user, account_client,
-                    std::ref(request_metadata), std::ref(username),
-                    std::ref(password)),
-          _rpc_call_logger,
-          "rs=account rf=authenticate_user ls=" + _local_service_name);
-    } catch (...) {
-      _account_cp->release_client(account_client);
-      throw;
-    }
-    _account_cp->release_client(account_client);
-    return res;
+    auto account_client = _account_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TAccount>(
+        std::bind(&account_service::Client::authenticate_user,
+                  account_client.get(), std::ref(request_metadata),
+                  std::ref(username), std::ref(password)),
+        _rpc_call_logger,
+        "rs=account rf=authenticate_user ls=" + _local_service_name);
   }
 
   TAccount rpc_create_account(const TRequestMetadata& request_metadata,
@@ -147,647 +222,587 @@ class MicroserviceConnectedServer : public BaseServer {
                               const std::string& password,
                               const std::string& first_name,
                               const std::string& last_name) {
-    TAccount res;
-    auto account_client = _account_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TAccount>(
-          std::bind(&account_service::Client::create_account, account_client,
-                    std::ref(request_metadata), std::ref(username),
-                    std::ref(password), std::ref(first_name),
-                    std::ref(last_name)),
-          _rpc_call_logger,
-          "rs=account rf=create_account ls=" + _local_service_name);
-    } catch (...) {
-      _account_cp->release_client(account_client);
-      throw;
-    }
-    _account_cp->release_client(account_client);
-    return res;
+    auto account_client = _account_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TAccount>(
+        std::bind(&account_service::Client::create_account,
+                  account_client.get(), std::ref(request_metadata),
+                  std::ref(username), std::ref(password), std::ref(first_name),
+                  std::ref(last_name)),
+        _rpc_call_logger,
+        "rs=account rf=create_account ls=" + _local_service_name);
   }
 
   TAccount rpc_retrieve_standard_account(
-      const TRequestMetadata& request_metadata, const int32_t account_id) {
-    TAccount res;
-    auto account_client = _account_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TAccount>(
-          std::bind(&account_service::Client::retrieve_standard_account,
-                    account_client, std::ref(request_metadata),
-                    std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=account rf=retrieve_standard_account ls=" + _local_service_name);
-    } catch (...) {
-      _account_cp->release_client(account_client);
-      throw;
-    }
-    _account_cp->release_client(account_client);
-    return res;
+      const TRequestMetadata& request_metadata, const int64_t account_id) {
+    auto account_client = _account_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TAccount>(
+        std::bind(&account_service::Client::retrieve_standard_account,
+                  account_client.get(), std::ref(request_metadata),
+                  std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=account rf=retrieve_standard_account ls=" + _local_service_name);
   }
 
   TAccount rpc_retrieve_expanded_account(
-      const TRequestMetadata& request_metadata, const int32_t account_id) {
-    TAccount res;
-    auto account_client = _account_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TAccount>(
-          std::bind(&account_service::Client::retrieve_expanded_account,
-                    account_client, std::ref(request_metadata),
-                    std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=account rf=retrieve_expanded_account ls=" + _local_service_name);
-    } catch (...) {
-      _account_cp->release_client(account_client);
-      throw;
-    }
-    _account_cp->release_client(account_client);
-    return res;
+      const TRequestMetadata& request_metadata, const int64_t account_id) {
+    auto account_client = _account_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TAccount>(
+        std::bind(&account_service::Client::retrieve_expanded_account,
+                  account_client.get(), std::ref(request_metadata),
+                  std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=account rf=retrieve_expanded_account ls=" + _local_service_name);
   }
 
   TAccount rpc_update_account(const TRequestMetadata& request_metadata,
-                              const int32_t account_id,
+                              const int64_t account_id,
                               const std::string& password,
                               const std::string& first_name,
                               const std::string& last_name) {
-    TAccount res;
-    auto account_client = _account_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TAccount>(
-          std::bind(&account_service::Client::update_account, account_client,
-                    std::ref(request_metadata), std::ref(account_id),
-                    std::ref(password), std::ref(first_name),
-                    std::ref(last_name)),
-          _rpc_call_logger,
-          "rs=account rf=update_account ls=" + _local_service_name);
-    } catch (...) {
-      _account_cp->release_client(account_client);
-      throw;
-    }
-    _account_cp->release_client(account_client);
-    return res;
+    auto account_client = _account_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TAccount>(
+        std::bind(&account_service::Client::update_account,
+                  account_client.get(), std::ref(request_metadata),
+                  std::ref(account_id), std::ref(password),
+                  std::ref(first_name), std::ref(last_name)),
+        _rpc_call_logger,
+        "rs=account rf=update_account ls=" + _local_service_name);
   }
 
   void rpc_delete_account(const TRequestMetadata& request_metadata,
-                          const int32_t account_id) {
-    auto account_client = _account_cp->get_client();
-    try {
-      VOID_RPC_WRAPPER(
-          std::bind(&account_service::Client::delete_account, account_client,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=account rf=delete_account ls=" + _local_service_name);
-    } catch (...) {
-      _account_cp->release_client(account_client);
-      throw;
-    }
-    _account_cp->release_client(account_client);
+                          const int64_t account_id) {
+    auto account_client = _account_cp->lease(get_deadline(request_metadata));
+    VOID_RPC_WRAPPER(
+        std::bind(&account_service::Client::delete_account,
+                  account_client.get(), std::ref(request_metadata),
+                  std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=account rf=delete_account ls=" + _local_service_name);
   }
 
   // Follow RPCs
   TFollow rpc_follow_account(const TRequestMetadata& request_metadata,
-                             const int32_t account_id) {
-    TFollow res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TFollow>(
-          std::bind(&follow_service::Client::follow_account, follow_client,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=follow rf=follow_account ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+                             const int64_t account_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TFollow>(
+        std::bind(&follow_service::Client::follow_account, follow_client.get(),
+                  std::ref(request_metadata), std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=follow rf=follow_account ls=" + _local_service_name);
   }
 
   TFollow rpc_retrieve_standard_follow(const TRequestMetadata& request_metadata,
-                                       const int32_t follow_id) {
-    TFollow res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TFollow>(
-          std::bind(&follow_service::Client::retrieve_standard_follow,
-                    follow_client, std::ref(request_metadata),
-                    std::ref(follow_id)),
-          _rpc_call_logger,
-          "rs=follow rf=retrieve_standard_follow ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+                                       const int64_t follow_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TFollow>(
+        std::bind(&follow_service::Client::retrieve_standard_follow,
+                  follow_client.get(), std::ref(request_metadata),
+                  std::ref(follow_id)),
+        _rpc_call_logger,
+        "rs=follow rf=retrieve_standard_follow ls=" + _local_service_name);
   }
 
   TFollow rpc_retrieve_expanded_follow(const TRequestMetadata& request_metadata,
-                                       const int32_t follow_id) {
-    TFollow res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TFollow>(
-          std::bind(&follow_service::Client::retrieve_expanded_follow,
-                    follow_client, std::ref(request_metadata),
-                    std::ref(follow_id)),
-          _rpc_call_logger,
-          "rs=follow rf=retrieve_expanded_follow ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+                                       const int64_t follow_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TFollow>(
+        std::bind(&follow_service::Client::retrieve_expanded_follow,
+                  follow_client.get(), std::ref(request_metadata),
+                  std::ref(follow_id)),
+        _rpc_call_logger,
+        "rs=follow rf=retrieve_expanded_follow ls=" + _local_service_name);
   }
 
   void rpc_delete_follow(const TRequestMetadata& request_metadata,
-                         const int32_t follow_id) {
-    auto follow_client = _follow_cp->get_client();
-    try {
-      VOID_RPC_WRAPPER(
-          std::bind(&follow_service::Client::delete_follow, follow_client,
-                    std::ref(request_metadata), std::ref(follow_id)),
-          _rpc_call_logger,
-          "rs=follow rf=delete_follow ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
+                         const int64_t follow_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    VOID_RPC_WRAPPER(
+        std::bind(&follow_service::Client::delete_follow, follow_client.get(),
+                  std::ref(request_metadata), std::ref(follow_id)),
+        _rpc_call_logger,
+        "rs=follow rf=delete_follow ls=" + _local_service_name);
   }
 
   std::vector<TFollow> rpc_list_follows(
       const TRequestMetadata& request_metadata, const TFollowQuery& query,
       const int32_t limit, const int32_t offset) {
-    std::vector<TFollow> res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<std::vector<TFollow>>(
-          std::bind(&follow_service::Client::list_follows, follow_client,
-                    std::ref(request_metadata), std::ref(query),
-                    std::ref(limit), std::ref(offset)),
-          _rpc_call_logger,
-          "rs=follow rf=list_follows ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<std::vector<TFollow>>(
+        std::bind(&follow_service::Client::list_follows, follow_client.get(),
+                  std::ref(request_metadata), std::ref(query), std::ref(limit),
+                  std::ref(offset)),
+        _rpc_call_logger,
+        "rs=follow rf=list_follows ls=" + _local_service_name);
+  }
+
+  TFollowPage rpc_list_follows_page(const TRequestMetadata& request_metadata,
+                                    const TFollowQuery& query,
+                                    const int32_t limit,
+                                    const std::string& cursor) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TFollowPage>(
+        std::bind(&follow_service::Client::list_follows_page,
+                  follow_client.get(), std::ref(request_metadata),
+                  std::ref(query), std::ref(limit), std::ref(cursor)),
+        _rpc_call_logger,
+        "rs=follow rf=list_follows_page ls=" + _local_service_name);
   }
 
   bool rpc_check_follow(const TRequestMetadata& request_metadata,
-                        const int32_t follower_id, const int32_t followee_id) {
-    bool res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<bool>(
-          std::bind(&follow_service::Client::check_follow, follow_client,
-                    std::ref(request_metadata), std::ref(follower_id),
-                    std::ref(followee_id)),
-          _rpc_call_logger,
-          "rs=follow rf=check_follow ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+                        const int64_t follower_id, const int64_t followee_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<bool>(
+        std::bind(&follow_service::Client::check_follow, follow_client.get(),
+                  std::ref(request_metadata), std::ref(follower_id),
+                  std::ref(followee_id)),
+        _rpc_call_logger,
+        "rs=follow rf=check_follow ls=" + _local_service_name);
   }
 
   int32_t rpc_count_followers(const TRequestMetadata& request_metadata,
-                              const int32_t account_id) {
-    int32_t res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<int32_t>(
-          std::bind(&follow_service::Client::count_followers, follow_client,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=follow rf=count_followers ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+                              const int64_t account_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<int32_t>(
+        std::bind(&follow_service::Client::count_followers, follow_client.get(),
+                  std::ref(request_metadata), std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=follow rf=count_followers ls=" + _local_service_name);
   }
 
   int32_t rpc_count_followees(const TRequestMetadata& request_metadata,
-                              const int32_t account_id) {
-    int32_t res;
-    auto follow_client = _follow_cp->get_client();
-    try {
-      res = RPC_WRAPPER<int32_t>(
-          std::bind(&follow_service::Client::count_followees, follow_client,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=follow rf=count_followees ls=" + _local_service_name);
-    } catch (...) {
-      _follow_cp->release_client(follow_client);
-      throw;
-    }
-    _follow_cp->release_client(follow_client);
-    return res;
+                              const int64_t account_id) {
+    auto follow_client = _follow_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<int32_t>(
+        std::bind(&follow_service::Client::count_followees, follow_client.get(),
+                  std::ref(request_metadata), std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=follow rf=count_followees ls=" + _local_service_name);
   }
 
   // Like RPCs
   TLike rpc_like_post(const TRequestMetadata& request_metadata,
-                      const int32_t post_id) {
-    TLike res;
-    auto like_client = _like_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TLike>(
-          std::bind(&like_service::Client::like_post, like_client,
-                    std::ref(request_metadata), std::ref(post_id)),
-          _rpc_call_logger, "rs=like rf=like_post ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
-    return res;
+                      const int64_t post_id) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TLike>(
+        std::bind(&like_service::Client::like_post, like_client.get(),
+                  std::ref(request_metadata), std::ref(post_id)),
+        _rpc_call_logger, "rs=like rf=like_post ls=" + _local_service_name);
   }
 
   TLike rpc_retrieve_standard_like(const TRequestMetadata& request_metadata,
-                                   const int32_t like_id) {
-    TLike res;
-    auto like_client = _like_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TLike>(
-          std::bind(&like_service::Client::retrieve_standard_like, like_client,
-                    std::ref(request_metadata), std::ref(like_id)),
-          _rpc_call_logger,
-          "rs=like rf=retrieve_standard_like ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
-    return res;
+                                   const int64_t like_id) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TLike>(
+        std::bind(&like_service::Client::retrieve_standard_like,
+                  like_client.get(), std::ref(request_metadata),
+                  std::ref(like_id)),
+        _rpc_call_logger,
+        "rs=like rf=retrieve_standard_like ls=" + _local_service_name);
   }
 
   TLike rpc_retrieve_expanded_like(const TRequestMetadata& request_metadata,
-                                   const int32_t like_id) {
-    TLike res;
-    auto like_client = _like_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TLike>(
-          std::bind(&like_service::Client::retrieve_expanded_like, like_client,
-                    std::ref(request_metadata), std::ref(like_id)),
-          _rpc_call_logger,
-          "rs=like rf=retrieve_expanded_like ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
-    return res;
+                                   const int64_t like_id) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TLike>(
+        std::bind(&like_service::Client::retrieve_expanded_like,
+                  like_client.get(), std::ref(request_metadata),
+                  std::ref(like_id)),
+        _rpc_call_logger,
+        "rs=like rf=retrieve_expanded_like ls=" + _local_service_name);
   }
 
   void rpc_delete_like(const TRequestMetadata& request_metadata,
-                       const int32_t like_id) {
-    auto like_client = _like_cp->get_client();
-    try {
-      VOID_RPC_WRAPPER(
-          std::bind(&like_service::Client::delete_like, like_client,
-                    std::ref(request_metadata), std::ref(like_id)),
-          _rpc_call_logger, "rs=like rf=delete_like ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
+                       const int64_t like_id) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    VOID_RPC_WRAPPER(
+        std::bind(&like_service::Client::delete_like, like_client.get(),
+                  std::ref(request_metadata), std::ref(like_id)),
+        _rpc_call_logger, "rs=like rf=delete_like ls=" + _local_service_name);
   }
 
   std::vector<TLike> rpc_list_likes(const TRequestMetadata& request_metadata,
                                     const TLikeQuery& query,
                                     const int32_t limit, const int32_t offset) {
-    std::vector<TLike> res;
-    auto like_client = _like_cp->get_client();
-    try {
-      res = RPC_WRAPPER<std::vector<TLike>>(
-          std::bind(&like_service::Client::list_likes, like_client,
-                    std::ref(request_metadata), std::ref(query),
-                    std::ref(limit), std::ref(offset)),
-          _rpc_call_logger, "rs=like rf=list_likes ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
-    return res;
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<std::vector<TLike>>(
+        std::bind(&like_service::Client::list_likes, like_client.get(),
+                  std::ref(request_metadata), std::ref(query), std::ref(limit),
+                  std::ref(offset)),
+        _rpc_call_logger, "rs=like rf=list_likes ls=" + _local_service_name);
+  }
+
+  TLikePage rpc_list_likes_page(const TRequestMetadata& request_metadata,
+                                const TLikeQuery& query, const int32_t limit,
+                                const std::string& cursor) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TLikePage>(
+        std::bind(&like_service::Client::list_likes_page, like_client.get(),
+                  std::ref(request_metadata), std::ref(query), std::ref(limit),
+                  std::ref(cursor)),
+        _rpc_call_logger,
+        "rs=like rf=list_likes_page ls=" + _local_service_name);
   }
 
   int32_t rpc_count_likes_by_account(const TRequestMetadata& request_metadata,
-                                     const int32_t account_id) {
-    int32_t res;
-    auto like_client = _like_cp->get_client();
-    try {
-      res = RPC_WRAPPER<int32_t>(
-          std::bind(&like_service::Client::count_likes_by_account, like_client,
-                    std::ref(request_metadata), std::ref(account_id)),
-          _rpc_call_logger,
-          "rs=like rf=count_likes_by_account ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
-    return res;
+                                     const int64_t account_id) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<int32_t>(
+        std::bind(&like_service::Client::count_likes_by_account,
+                  like_client.get(), std::ref(request_metadata),
+                  std::ref(account_id)),
+        _rpc_call_logger,
+        "rs=like rf=count_likes_by_account ls=" + _local_service_name);
   }
 
   int32_t rpc_count_likes_of_post(const TRequestMetadata& request_metadata,
-                                  const int32_t post_id) {
-    int32_t res;
-    auto like_client = _like_cp->get_client();
-    try {
-      res = RPC_WRAPPER<int32_t>(
-          std::bind(&like_service::Client::count_likes_of_post, like_client,
-                    std::ref(request_metadata), std::ref(post_id)),
-          _rpc_call_logger,
-          "rs=like rf=count_likes_of_post ls=" + _local_service_name);
-    } catch (...) {
-      _like_cp->release_client(like_client);
-      throw;
-    }
-    _like_cp->release_client(like_client);
-    return res;
+                                  const int64_t post_id) {
+    auto like_client = _like_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<int32_t>(
+        std::bind(&like_service::Client::count_likes_of_post, like_client.get(),
+                  std::ref(request_metadata), std::ref(post_id)),
+        _rpc_call_logger,
+        "rs=like rf=count_likes_of_post ls=" + _local_service_name);
   }
 
   // Post RPCs
   TPost rpc_create_post(const TRequestMetadata& request_metadata,
                         const std::string& text) {
-    TPost res;
-    auto post_client = _post_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TPost>(
-          std::bind(&post_service::Client::create_post, post_client,
-                    std::ref(request_metadata), std::ref(text)),
-          _rpc_call_logger, "rs=post rf=create_post ls=" + _local_service_name);
-    } catch (...) {
-      _post_cp->release_client(post_client);
-      throw;
-    }
-    _post_cp->release_client(post_client);
-    return res;
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TPost>(
+        std::bind(&post_service::Client::create_post, post_client.get(),
+                  std::ref(request_metadata), std::ref(text)),
+        _rpc_call_logger, "rs=post rf=create_post ls=" + _local_service_name);
   }
 
   TPost rpc_retrieve_standard_post(const TRequestMetadata& request_metadata,
-                                   const int32_t post_id) {
-    TPost res;
-    auto post_client = _post_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TPost>(
-          std::bind(&post_service::Client::retrieve_standard_post, post_client,
-                    std::ref(request_metadata), std::ref(post_id)),
-          _rpc_call_logger,
-          "rs=post rf=retrieve_standard_post ls=" + _local_service_name);
-    } catch (...) {
-      _post_cp->release_client(post_client);
-      throw;
-    }
-    _post_cp->release_client(post_client);
-    return res;
+                                   const int64_t post_id) {
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TPost>(
+        std::bind(&post_service::Client::retrieve_standard_post,
+                  post_client.get(), std::ref(request_metadata),
+                  std::ref(post_id)),
+        _rpc_call_logger,
+        "rs=post rf=retrieve_standard_post ls=" + _local_service_name);
   }
 
   TPost rpc_retrieve_expanded_post(const TRequestMetadata& request_metadata,
-                                   const int32_t post_id) {
-    TPost res;
-    auto post_client = _post_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TPost>(
-          std::bind(&post_service::Client::retrieve_expanded_post, post_client,
-                    std::ref(request_metadata), std::ref(post_id)),
-          _rpc_call_logger,
-          "rs=post rf=retrieve_expanded_post ls=" + _local_service_name);
-    } catch (...) {
-      _post_cp->release_client(post_client);
-      throw;
-    }
-    _post_cp->release_client(post_client);
-    return res;
+                                   const int64_t post_id) {
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TPost>(
+        std::bind(&post_service::Client::retrieve_expanded_post,
+                  post_client.get(), std::ref(request_metadata),
+                  std::ref(post_id)),
+        _rpc_call_logger,
+        "rs=post rf=retrieve_expanded_post ls=" + _local_service_name);
   }
 
   void rpc_delete_post(const TRequestMetadata& request_metadata,
-                       const int32_t post_id) {
-    auto post_client = _post_cp->get_client();
-    try {
-      VOID_RPC_WRAPPER(
-          std::bind(&post_service::Client::delete_post, post_client,
-                    std::ref(request_metadata), std::ref(post_id)),
-          _rpc_call_logger, "rs=post rf=delete_post ls=" + _local_service_name);
-    } catch (...) {
-      _post_cp->release_client(post_client);
-      throw;
-    }
-    _post_cp->release_client(post_client);
+                       const int64_t post_id) {
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    VOID_RPC_WRAPPER(
+        std::bind(&post_service::Client::delete_post, post_client.get(),
+                  std::ref(request_metadata), std::ref(post_id)),
+        _rpc_call_logger, "rs=post rf=delete_post ls=" + _local_service_name);
   }
 
   std::vector<TPost> rpc_list_posts(const TRequestMetadata& request_metadata,
                                     const TPostQuery& query,
                                     const int32_t limit, const int32_t offset) {
-    std::vector<TPost> res;
-    auto post_client = _post_cp->get_client();
-    try {
-      res = RPC_WRAPPER<std::vector<TPost>>(
-          std::bind(&post_service::Client::list_posts, post_client,
-                    std::ref(request_metadata), std::ref(query),
-                    std::ref(limit), std::ref(offset)),
-          _rpc_call_logger, "rs=post rf=list_posts ls=" + _local_service_name);
-    } catch (...) {
-      _post_cp->release_client(post_client);
-      throw;
-    }
-    _post_cp->release_client(post_client);
-    return res;
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<std::vector<TPost>>(
+        std::bind(&post_service::Client::list_posts, post_client.get(),
+                  std::ref(request_metadata), std::ref(query), std::ref(limit),
+                  std::ref(offset)),
+        _rpc_call_logger, "rs=post rf=list_posts ls=" + _local_service_name);
+  }
+
+  TPostPage rpc_list_posts_page(const TRequestMetadata& request_metadata,
+                                const TPostQuery& query, const int32_t limit,
+                                const std::string& cursor) {
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TPostPage>(
+        std::bind(&post_service::Client::list_posts_page, post_client.get(),
+                  std::ref(request_metadata), std::ref(query), std::ref(limit),
+                  std::ref(cursor)),
+        _rpc_call_logger,
+        "rs=post rf=list_posts_page ls=" + _local_service_name);
   }
 
   int32_t rpc_count_posts_by_author(const TRequestMetadata& request_metadata,
-                                    const int32_t author_id) {
-    int32_t res;
-    auto post_client = _post_cp->get_client();
-    try {
-      res = RPC_WRAPPER<int32_t>(
-          std::bind(&post_service::Client::count_posts_by_author, post_client,
-                    std::ref(request_metadata), std::ref(author_id)),
-          _rpc_call_logger,
-          "rs=post rf=count_posts_by_author ls=" + _local_service_name);
-    } catch (...) {
-      _post_cp->release_client(post_client);
-      throw;
-    }
-    _post_cp->release_client(post_client);
-    return res;
+                                    const int64_t author_id) {
+    auto post_client = _post_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<int32_t>(
+        std::bind(&post_service::Client::count_posts_by_author,
+                  post_client.get(), std::ref(request_metadata),
+                  std::ref(author_id)),
+        _rpc_call_logger,
+        "rs=post rf=count_posts_by_author ls=" + _local_service_name);
   }
 
   // Uniquepair RPCs
   TUniquepair rpc_get(const TRequestMetadata& request_metadata,
-                      const int32_t uniquepair_id) {
-    TUniquepair res;
-    auto uniquepair_client = _uniquepair_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TUniquepair>(
-          std::bind(&uniquepair_service::Client::get, uniquepair_client,
-                    std::ref(request_metadata), std::ref(uniquepair_id)),
-          _rpc_call_logger, "rs=uniquepair rf=get ls=" + _local_service_name);
-    } catch (...) {
-      _uniquepair_cp->release_client(uniquepair_client);
-      throw;
-    }
-    _uniquepair_cp->release_client(uniquepair_client);
-    return res;
+                      const int64_t uniquepair_id) {
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TUniquepair>(
+        std::bind(&uniquepair_service::Client::get, uniquepair_client.get(),
+                  std::ref(request_metadata), std::ref(uniquepair_id)),
+        _rpc_call_logger, "rs=uniquepair rf=get ls=" + _local_service_name);
   }
 
   TUniquepair rpc_add(const TRequestMetadata& request_metadata,
-                      const std::string& domain, const int32_t first_elem,
-                      const int32_t second_elem) {
-    TUniquepair res;
-    auto uniquepair_client = _uniquepair_cp->get_client();
-    try {
-      res = RPC_WRAPPER<TUniquepair>(
-          std::bind(&uniquepair_service::Client::add, uniquepair_client,
-                    std::ref(request_metadata), std::ref(domain),
-                    std::ref(first_elem), std::ref(second_elem)),
-          _rpc_call_logger, "rs=uniquepair rf=add ls=" + _local_service_name);
-    } catch (...) {
-      _uniquepair_cp->release_client(uniquepair_client);
-      throw;
-    }
-    _uniquepair_cp->release_client(uniquepair_client);
-    return res;
+                      const std::string& domain, const int64_t first_elem,
+                      const int64_t second_elem) {
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TUniquepair>(
+        std::bind(&uniquepair_service::Client::add, uniquepair_client.get(),
+                  std::ref(request_metadata), std::ref(domain),
+                  std::ref(first_elem), std::ref(second_elem)),
+        _rpc_call_logger, "rs=uniquepair rf=add ls=" + _local_service_name);
   }
 
   void rpc_remove(const TRequestMetadata& request_metadata,
-                  const int32_t uniquepair_id) {
-    auto uniquepair_client = _uniquepair_cp->get_client();
-    try {
-      VOID_RPC_WRAPPER(
-          std::bind(&uniquepair_service::Client::remove, uniquepair_client,
-                    std::ref(request_metadata), std::ref(uniquepair_id)),
-          _rpc_call_logger,
-          "rs=uniquepair rf=remove ls=" + _local_service_name);
-    } catch (...) {
-      _uniquepair_cp->release_client(uniquepair_client);
-      throw;
-    }
-    _uniquepair_cp->release_client(uniquepair_client);
+                  const int64_t uniquepair_id) {
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    VOID_RPC_WRAPPER(
+        std::bind(&uniquepair_service::Client::remove, uniquepair_client.get(),
+                  std::ref(request_metadata), std::ref(uniquepair_id)),
+        _rpc_call_logger,
+        "rs=uniquepair rf=remove ls=" + _local_service_name);
   }
 
   bool rpc_find(const TRequestMetadata& request_metadata,
-                const std::string& domain, const int32_t first_elem,
-                const int32_t second_elem) {
-    bool res;
-    auto uniquepair_client = _uniquepair_cp->get_client();
-    try {
-      res = RPC_WRAPPER<bool>(
-          std::bind(&uniquepair_service::Client::find, uniquepair_client,
-                    std::ref(request_metadata), std::ref(domain),
-                    std::ref(first_elem), std::ref(second_elem)),
-          _rpc_call_logger, "rs=uniquepair rf=find ls=" + _local_service_name);
-    } catch (...) {
-      _uniquepair_cp->release_client(uniquepair_client);
-      throw;
-    }
-    _uniquepair_cp->release_client(uniquepair_client);
-    return res;
+                const std::string& domain, const int64_t first_elem,
+                const int64_t second_elem) {
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<bool>(
+        std::bind(&uniquepair_service::Client::find, uniquepair_client.get(),
+                  std::ref(request_metadata), std::ref(domain),
+                  std::ref(first_elem), std::ref(second_elem)),
+        _rpc_call_logger, "rs=uniquepair rf=find ls=" + _local_service_name);
   }
 
   std::vector<TUniquepair> rpc_fetch(const TRequestMetadata& request_metadata,
                                      const TUniquepairQuery& query,
                                      const int32_t limit,
                                      const int32_t offset) {
-    std::vector<TUniquepair> res;
-    auto uniquepair_client = _uniquepair_cp->get_client();
-    try {
-      res = RPC_WRAPPER<std::vector<TUniquepair>>(
-          std::bind(&uniquepair_service::Client::fetch, uniquepair_client,
-                    std::ref(request_metadata), std::ref(query),
-                    std::ref(limit), std::ref(offset)),
-          _rpc_call_logger, "rs=uniquepair rf=fetch ls=" + _local_service_name);
-    } catch (...) {
-      _uniquepair_cp->release_client(uniquepair_client);
-      throw;
-    }
-    _uniquepair_cp->release_client(uniquepair_client);
-    return res;
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<std::vector<TUniquepair>>(
+        std::bind(&uniquepair_service::Client::fetch, uniquepair_client.get(),
+                  std::ref(request_metadata), std::ref(query), std::ref(limit),
+                  std::ref(offset)),
+        _rpc_call_logger, "rs=uniquepair rf=fetch ls=" + _local_service_name);
+  }
+
+  TUniquepairPage rpc_fetch_page(const TRequestMetadata& request_metadata,
+                                 const TUniquepairQuery& query,
+                                 const int32_t limit,
+                                 const std::string& cursor) {
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<TUniquepairPage>(
+        std::bind(&uniquepair_service::Client::fetch_page,
+                  uniquepair_client.get(), std::ref(request_metadata),
+                  std::ref(query), std::ref(limit), std::ref(cursor)),
+        _rpc_call_logger,
+        "rs=uniquepair rf=fetch_page ls=" + _local_service_name);
   }
 
   int32_t rpc_count(const TRequestMetadata& request_metadata,
                     const TUniquepairQuery& query) {
-    int32_t res;
-    auto uniquepair_client = _uniquepair_cp->get_client();
-    try {
-      res = RPC_WRAPPER<int32_t>(
-          std::bind(&uniquepair_service::Client::count, uniquepair_client,
-                    std::ref(request_metadata), std::ref(query)),
-          _rpc_call_logger, "rs=uniquepair rf=count ls=" + _local_service_name);
-    } catch (...) {
-      _uniquepair_cp->release_client(uniquepair_client);
-      throw;
-    }
-    _uniquepair_cp->release_client(uniquepair_client);
-    return res;
+    auto uniquepair_client =
+        _uniquepair_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<int32_t>(
+        std::bind(&uniquepair_service::Client::count, uniquepair_client.get(),
+                  std::ref(request_metadata), std::ref(query)),
+        _rpc_call_logger, "rs=uniquepair rf=count ls=" + _local_service_name);
   }
 
   // Trending RPCs
   void rpc_process_post(const TRequestMetadata& request_metadata,
                         const std::string& text) {
-    auto trending_client = _trending_cp->get_client();
-    try {
-      VOID_RPC_WRAPPER(
-          std::bind(&trending_service::Client::process_post, trending_client,
-                    std::ref(request_metadata), std::ref(text)),
-          _rpc_call_logger,
-          "rs=trending rf=process_post ls=" + _local_service_name);
-    } catch (...) {
-      _trending_cp->release_client(trending_client);
-      throw;
-    }
-    _trending_cp->release_client(trending_client);
+    auto trending_client = _trending_cp->lease(get_deadline(request_metadata));
+    VOID_RPC_WRAPPER(
+        std::bind(&trending_service::Client::process_post,
+                  trending_client.get(), std::ref(request_metadata),
+                  std::ref(text)),
+        _rpc_call_logger,
+        "rs=trending rf=process_post ls=" + _local_service_name);
   }
 
   std::vector<std::string> rpc_fetch_trending_hashtags(
       const TRequestMetadata& request_metadata, const int32_t limit) {
-    std::vector<std::string> res;
-    auto trending_client = _trending_cp->get_client();
-    try {
-      res = RPC_WRAPPER<std::vector<std::string>>(
-          std::bind(&trending_service::Client::fetch_trending_hashtags,
-                    trending_client, std::ref(request_metadata),
-                    std::ref(limit)),
-          _rpc_call_logger,
-          "rs=trending rf=fetch_trending_hashtags ls=" + _local_service_name);
-    } catch (...) {
-      _trending_cp->release_client(trending_client);
-      throw;
-    }
-    _trending_cp->release_client(trending_client);
-    return res;
+    auto trending_client = _trending_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<std::vector<std::string>>(
+        std::bind(&trending_service::Client::fetch_trending_hashtags,
+                  trending_client.get(), std::ref(request_metadata),
+                  std::ref(limit)),
+        _rpc_call_logger,
+        "rs=trending rf=fetch_trending_hashtags ls=" + _local_service_name);
   }
 
   // Wordfilter RPCs
   bool rpc_is_valid_word(const TRequestMetadata& request_metadata,
                          const std::string& word) {
-    bool res;
-    auto wordfilter_client = _wordfilter_cp->get_client();
-    try {
-      res = RPC_WRAPPER<bool>(
-          std::bind(&wordfilter_service::Client::is_valid_word,
-                    wordfilter_client, std::ref(request_metadata),
-                    std::ref(word)),
-          _rpc_call_logger,
-          "rs=wordfilter rf=is_valid_word ls=" + _local_service_name);
-    } catch (...) {
-      _wordfilter_cp->release_client(wordfilter_client);
-      throw;
-    }
-    _wordfilter_cp->release_client(wordfilter_client);
-    return res;
+    auto wordfilter_client =
+        _wordfilter_cp->lease(get_deadline(request_metadata));
+    return RPC_WRAPPER<bool>(
+        std::bind(&wordfilter_service::Client::is_valid_word,
+                  wordfilter_client.get(), std::ref(request_metadata),
+                  std::ref(word)),
+        _rpc_call_logger,
+        "rs=wordfilter rf=is_valid_word ls=" + _local_service_name);
+  }
+
+  // Asynchronous RPCs. Arguments passed by reference must outlive the task.
+  Task<TAccount> co_rpc_retrieve_standard_account(
+      const TRequestMetadata& request_metadata, const int64_t account_id) {
+    co_return co_await CO_RPC_WRAPPER<TAccount>(
+        _account_async_cp->call<TAccount>(
+            get_deadline(request_metadata),
+            [&](TAccountServiceClient& client) {
+              client.send_retrieve_standard_account(request_metadata,
+                                                    account_id);
+            },
+            [](TAccountServiceClient& client) {
+              TAccount res;
+              client.recv_retrieve_standard_account(res);
+              return res;
+            }),
+        _rpc_call_logger,
+        "rs=account rf=retrieve_standard_account ls=" + _local_service_name);
+  }
+
+  Task<bool> co_rpc_check_follow(const TRequestMetadata& request_metadata,
+                                 const int64_t follower_id,
+                                 const int64_t followee_id) {
+    co_return co_await CO_RPC_WRAPPER<bool>(
+        _follow_async_cp->call<bool>(
+            get_deadline(request_metadata),
+            [&](TFollowServiceClient& client) {
+              client.send_check_follow(request_metadata, follower_id,
+                                       followee_id);
+            },
+            [](TFollowServiceClient& client) {
+              return client.recv_check_follow();
+            }),
+        _rpc_call_logger,
+        "rs=follow rf=check_follow ls=" + _local_service_name);
+  }
+
+  Task<int32_t> co_rpc_count_followers(const TRequestMetadata& request_metadata,
+                                       const int64_t account_id) {
+    co_return co_await CO_RPC_WRAPPER<int32_t>(
+        _follow_async_cp->call<int32_t>(
+            get_deadline(request_metadata),
+            [&](TFollowServiceClient& client) {
+              client.send_count_followers(request_metadata, account_id);
+            },
+            [](TFollowServiceClient& client) {
+              return client.recv_count_followers();
+            }),
+        _rpc_call_logger,
+        "rs=follow rf=count_followers ls=" + _local_service_name);
+  }
+
+  Task<int32_t> co_rpc_count_followees(const TRequestMetadata& request_metadata,
+                                       const int64_t account_id) {
+    co_return co_await CO_RPC_WRAPPER<int32_t>(
+        _follow_async_cp->call<int32_t>(
+            get_deadline(request_metadata),
+            [&](TFollowServiceClient& client) {
+              client.send_count_followees(request_metadata, account_id);
+            },
+            [](TFollowServiceClient& client) {
+              return client.recv_count_followees();
+            }),
+        _rpc_call_logger,
+        "rs=follow rf=count_followees ls=" + _local_service_name);
+  }
+
+  Task<int32_t> co_rpc_count_likes_by_account(
+      const TRequestMetadata& request_metadata, const int64_t account_id) {
+    co_return co_await CO_RPC_WRAPPER<int32_t>(
+        _like_async_cp->call<int32_t>(
+            get_deadline(request_metadata),
+            [&](TLikeServiceClient& client) {
+              client.send_count_likes_by_account(request_metadata, account_id);
+            },
+            [](TLikeServiceClient& client) {
+              return client.recv_count_likes_by_account();
+            }),
+        _rpc_call_logger,
+        "rs=like rf=count_likes_by_account ls=" + _local_service_name);
+  }
+
+  Task<int32_t> co_rpc_count_likes_of_post(
+      const TRequestMetadata& request_metadata, const int64_t post_id) {
+    co_return co_await CO_RPC_WRAPPER<int32_t>(
+        _like_async_cp->call<int32_t>(
+            get_deadline(request_metadata),
+            [&](TLikeServiceClient& client) {
+              client.send_count_likes_of_post(request_metadata, post_id);
+            },
+            [](TLikeServiceClient& client) {
+              return client.recv_count_likes_of_post();
+            }),
+        _rpc_call_logger,
+        "rs=like rf=count_likes_of_post ls=" + _local_service_name);
+  }
+
+  Task<TPost> co_rpc_retrieve_expanded_post(
+      const TRequestMetadata& request_metadata, const int64_t post_id) {
+    co_return co_await CO_RPC_WRAPPER<TPost>(
+        _post_async_cp->call<TPost>(
+            get_deadline(request_metadata),
+            [&](TPostServiceClient& client) {
+              client.send_retrieve_expanded_post(request_metadata, post_id);
+            },
+            [](TPostServiceClient& client) {
+              TPost res;
+              client.recv_retrieve_expanded_post(res);
+              return res;
+            }),
+        _rpc_call_logger,
+        "rs=post rf=retrieve_expanded_post ls=" + _local_service_name);
+  }
+
+  Task<int32_t> co_rpc_count_posts_by_author(
+      const TRequestMetadata& request_metadata, const int64_t author_id) {
+    co_return co_await CO_RPC_WRAPPER<int32_t>(
+        _post_async_cp->call<int32_t>(
+            get_deadline(request_metadata),
+            [&](TPostServiceClient& client) {
+              client.send_count_posts_by_author(request_metadata, author_id);
+            },
+            [](TPostServiceClient& client) {
+              return client.recv_count_posts_by_author();
+            }),
+        _rpc_call_logger,
+        "rs=post rf=count_posts_by_author ls=" + _local_service_name);
   }
 
  private:
   std::string _local_service_name;
   std::shared_ptr<spdlog::logger> _rpc_call_logger;
+
+  template <typename T>
+  static void add_pool(AdmissionController& admission,
+                       std::shared_ptr<MicroserviceConnectionPool<T>> cp) {
+    admission.add_pool([cp] { return cp->backlog(); },
+                       [cp] { return cp->wait_time(); });
+  }
+
+  template <typename T>
+  static void add_pool(AdmissionController& admission,
+                       std::shared_ptr<AsyncConnectionPool<T>> cp) {
+    admission.add_pool([cp] { return cp->backlog(); }, [] { return 0.0; });
+  }
+
   // Connection pools.
   std::shared_ptr<MicroserviceConnectionPool<account_service::Client>>
       _account_cp;
@@ -801,6 +816,11 @@ class MicroserviceConnectedServer : public BaseServer {
       _trending_cp;
   std::shared_ptr<MicroserviceConnectionPool<wordfilter_service::Client>>
       _wordfilter_cp;
+  // Asynchronous connection pools.
+  std::shared_ptr<AsyncConnectionPool<TAccountServiceClient>> _account_async_cp;
+  std::shared_ptr<AsyncConnectionPool<TFollowServiceClient>> _follow_async_cp;
+  std::shared_ptr<AsyncConnectionPool<TLikeServiceClient>> _like_async_cp;
+  std::shared_ptr<AsyncConnectionPool<TPostServiceClient>> _post_async_cp;
 };
 
 #endif
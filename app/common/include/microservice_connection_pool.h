@@ -4,33 +4,240 @@
 #ifndef MICROSERVICE_CONNECTION_POOL__H
 #define MICROSERVICE_CONNECTION_POOL__H
 
-#include <assert.h>
+#include <buzzblog/deadline.h>
+#include <buzzblog/lockfree_connection_pool.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
+#include <cmath>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <random>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+/* Right to have one request in flight on a connection. Streams of the same
+ * connection share it.
+ */
+template <typename T>
+struct Stream {
+  std::shared_ptr<T> conn;
+};
+
+/* Load statistics of a microservice replica and its sub-pool of streams. */
+template <typename T>
+struct Replica {
+  std::string host;
+  int port;
+  std::unique_ptr<LockFreeConnectionPool<Stream<T>>> stream_pool;
+  // Connections shared by streams.
+  std::vector<std::weak_ptr<T>> conns;
+  std::mutex conns_mutex;
+  // Number of leased connections, i.e., of requests in progress.
+  std::atomic<int> outstanding;
+  // Exponentially weighted moving average of request latency (in seconds).
+  std::atomic<double> latency;
+  // Time at which `latency` was last updated (in steady clock nanoseconds).
+  std::atomic<int64_t> latency_time;
+
+  // Latency recorded when a connection to the replica cannot be opened, so
+  // that unreachable replicas are avoided.
+  static constexpr double kFailurePenalty = 1.0;
+  // Time (in seconds) over which the latency average decays by a factor of e
+  // while no request to the replica completes, so that replicas that were
+  // penalized or slow, and thus stopped being picked, are tried again.
+  static constexpr double kDecayTime = 1.0;
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Factor by which the latency average has decayed by `now`.
+  double decay(const int64_t now) {
+    double elapsed = (now - latency_time.load()) / 1e9;
+    return std::exp(-std::max(0.0, elapsed) / kDecayTime);
+  }
+
+  void record_latency(const double sample) {
+    const double alpha = 0.2;
+    auto now = now_ns();
+    double old_decay = decay(now);
+    double old_latency = latency.load();
+    double new_latency;
+    do {
+      new_latency =
+          old_latency == 0
+              ? sample
+              : alpha * sample + (1 - alpha) * old_latency * old_decay;
+    } while (!latency.compare_exchange_weak(old_latency, new_latency));
+    latency_time.store(now);
+  }
+
+  void record_failure() { record_latency(kFailurePenalty); }
+
+  // Expected time to serve one more request.
+  double cost() {
+    return (outstanding.load() + 1) * latency.load() * decay(now_ns());
+  }
+};
+
+/* Stream leased from the sub-pool of a replica. Releasing it updates the
+ * replica's count of outstanding requests and latency average, which records
+ * a failure instead of the stream's latency if it failed to connect.
+ */
+template <typename T>
+class ReplicaLease {
+ private:
+  Replica<T>* _replica;
+  ConnectionLease<Stream<T>> _lease;
+  std::chrono::time_point<std::chrono::steady_clock> _start_time;
+  bool _failed;
+
+ public:
+  ReplicaLease(Replica<T>* replica, ConnectionLease<Stream<T>>&& lease,
+               std::chrono::time_point<std::chrono::steady_clock> start_time)
+      : _lease(std::move(lease)) {
+    _replica = replica;
+    _start_time = start_time;
+    _failed = false;
+  }
+
+  ReplicaLease(ReplicaLease&& other) noexcept
+      : _lease(std::move(other._lease)) {
+    _replica = other._replica;
+    _start_time = other._start_time;
+    _failed = other._failed;
+    other._replica = nullptr;
+  }
+
+  ~ReplicaLease() {
+    if (!_replica) return;
+    if (_failed) {
+      _replica->record_failure();
+    } else {
+      std::chrono::duration<double> latency =
+          std::chrono::steady_clock::now() - _start_time;
+      _replica->record_latency(latency.count());
+    }
+    _replica->outstanding--;
+  }
+
+  // Marks the stream as having failed to connect to the replica.
+  void fail() { _failed = true; }
+
+  Stream<T>& stream() const { return *_lease; }
+  T* get() const { return _lease->conn.get(); }
+  T* operator->() const { return _lease->conn.get(); }
+  T& operator*() const { return *_lease->conn; }
+};
+
+/* Pool of connections to the replicas of a microservice. The pool size bounds
+ * the number of requests in flight, each of which leases a stream. Up to
+ * `requests_per_connection` streams share a connection, so T must be safe to
+ * share among threads if it is greater than 1. Each replica has its own
+ * sub-pool of streams, bounded by an equal share of the pool and sized
+ * adaptively within those bounds (see LockFreeConnectionPool). Every lease
+ * picks a replica according to the load balancing policy:
+ *   - "p2c" (default): the cheaper of two random replicas, where the cost of a
+ *     replica is its latency average times its outstanding requests plus one.
+ *   - "least_outstanding": the replica with the fewest outstanding requests.
+ */
 template <typename T>
 class MicroserviceConnectionPool {
  private:
   std::string _local_service_name;
   std::string _remote_service_name;
-  std::vector<std::pair<std::string, int>> _servers;
-  int _pool_current_size;
-  int _pool_min_size;
-  int _pool_max_size;
-  int _backlog_len;
+  std::vector<std::unique_ptr<Replica<T>>> _replicas;
   int _conn_timeout_ms;
-  bool _allow_ephemeral;
-  std::queue<std::shared_ptr<T>> _conn_pool;
-  std::mutex _conn_pool_mutex;
-  std::condition_variable _conn_pool_condition;
+  bool _framed;
+  int _requests_per_connection;
+  bool _least_outstanding;
   std::shared_ptr<spdlog::logger> _rpc_conn_logger;
+  std::shared_ptr<spdlog::logger> _pool_logger;
+
+  Replica<T>* select_replica() {
+    int n_replicas = _replicas.size();
+    if (n_replicas == 0)
+      throw std::runtime_error("No replicas of " + _remote_service_name);
+    if (n_replicas == 1) return _replicas[0].get();
+    thread_local std::minstd_rand rng(std::random_device{}());
+    if (_least_outstanding) {
+      // Start at a random replica to break ties evenly.
+      int first = rng() % n_replicas;
+      Replica<T>* best = _replicas[first].get();
+      for (int i = 1; i < n_replicas; i++) {
+        auto replica = _replicas[(first + i) % n_replicas].get();
+        if (replica->outstanding.load() < best->outstanding.load())
+          best = replica;
+      }
+      return best;
+    }
+    int i = rng() % n_replicas;
+    int j = rng() % (n_replicas - 1);
+    if (j >= i) j++;
+    auto a = _replicas[i].get();
+    auto b = _replicas[j].get();
+    double a_cost = a->cost();
+    double b_cost = b->cost();
+    if (a_cost == b_cost)
+      return a->outstanding.load() <= b->outstanding.load() ? a : b;
+    return a_cost < b_cost ? a : b;
+  }
+
+  // Opens a stream on the replica connection with the fewest streams, or on a
+  // new connection if all have `requests_per_connection` streams.
+  std::unique_ptr<Stream<T>> open_stream(Replica<T>* replica) {
+    auto stream = std::make_unique<Stream<T>>();
+    if (_requests_per_connection > 1) {
+      std::unique_lock<std::mutex> lock(replica->conns_mutex);
+      for (const auto& weak_conn : replica->conns) {
+        auto conn = weak_conn.lock();
+        if (conn && conn->is_open() &&
+            conn.use_count() - 1 < _requests_per_connection &&
+            (!stream->conn || conn.use_count() < stream->conn.use_count()))
+          stream->conn = conn;
+      }
+      if (!stream->conn) {
+        stream->conn = std::make_shared<T>(replica->host, replica->port,
+                                           _conn_timeout_ms, _framed);
+        auto it = std::find_if(replica->conns.begin(), replica->conns.end(),
+                               [](const std::weak_ptr<T>& weak_conn) {
+                                 return weak_conn.expired();
+                               });
+        if (it != replica->conns.end())
+          *it = stream->conn;
+        else
+          replica->conns.push_back(stream->conn);
+      }
+    } else {
+      stream->conn = std::make_shared<T>(replica->host, replica->port,
+                                         _conn_timeout_ms, _framed);
+    }
+    return stream;
+  }
+
+  ConnectionLease<Stream<T>> lease_from(Replica<T>* replica,
+                                        int* backlog_len,
+                                        const int64_t deadline_ms) {
+    try {
+      return replica->stream_pool->lease(backlog_len, deadline_ms);
+    } catch (const DeadlineExceededException&) {
+      // The sub-pool of the replica is busy, which says nothing of whether
+      // the replica is reachable.
+      replica->outstanding--;
+      throw;
+    } catch (...) {
+      // A connection to the replica could not be opened.
+      replica->record_failure();
+      replica->outstanding--;
+      throw;
+    }
+  }
 
  public:
   MicroserviceConnectionPool(
@@ -38,54 +245,82 @@ class MicroserviceConnectionPool {
       const std::string& remote_service_name,
       const std::vector<std::pair<std::string, int>>& servers,
       const int pool_min_size, const int pool_max_size,
-      const bool allow_ephemeral, const int conn_timeout_ms,
-      std::shared_ptr<spdlog::logger> rpc_conn_logger) {
+      const bool allow_ephemeral, const int conn_timeout_ms, const bool framed,
+      const int requests_per_connection, const std::string& load_balancing,
+      std::shared_ptr<spdlog::logger> rpc_conn_logger,
+      std::shared_ptr<spdlog::logger> pool_logger) {
     _local_service_name = local_service_name;
     _remote_service_name = remote_service_name;
-    _servers = servers;
-    _pool_min_size = pool_min_size;
-    _pool_max_size = pool_max_size;
-    _allow_ephemeral = allow_ephemeral;
     _conn_timeout_ms = conn_timeout_ms;
+    _framed = framed;
+    _requests_per_connection = std::max(1, requests_per_connection);
     _rpc_conn_logger = rpc_conn_logger;
-    _pool_current_size = 0;
-    _backlog_len = 0;
+    _pool_logger = pool_logger;
+    if (load_balancing == "least_outstanding")
+      _least_outstanding = true;
+    else if (load_balancing == "p2c" || load_balancing.empty())
+      _least_outstanding = false;
+    else
+      throw std::invalid_argument("Invalid load balancing policy: " +
+                                  load_balancing);
 
-    // Validate connection pool parameters.
-    assert(_pool_min_size >= 0);
-    assert(_pool_max_size >= 0);
-    assert(_pool_max_size >= _pool_min_size);
+    // Split the pool among replicas, with at least one stream each.
+    int n_replicas = std::max(1, int(servers.size()));
+    int replica_max_size = (pool_max_size + n_replicas - 1) / n_replicas;
+    if (pool_max_size > 0) replica_max_size = std::max(1, replica_max_size);
+    int replica_min_size = std::min(
+        replica_max_size, (pool_min_size + n_replicas - 1) / n_replicas);
+    for (const auto& server : servers) {
+      auto replica = std::make_unique<Replica<T>>();
+      replica->host = server.first;
+      replica->port = server.second;
+      replica->outstanding = 0;
+      replica->latency = 0;
+      replica->latency_time = 0;
+      auto replica_ptr = replica.get();
+      replica->stream_pool =
+          std::make_unique<LockFreeConnectionPool<Stream<T>>>(
+              replica_min_size, replica_max_size, allow_ephemeral,
+              [this, replica_ptr] { return open_stream(replica_ptr); });
+      if (_pool_logger)
+        replica->stream_pool->on_resize([this, replica_ptr](int size) {
+          _pool_logger->info("ls={} rs={} replica={}:{} size={}",
+                             _local_service_name, _remote_service_name,
+                             replica_ptr->host, replica_ptr->port, size);
+        });
+      _replicas.push_back(std::move(replica));
+    }
   }
 
-  ~MicroserviceConnectionPool() {}
+  ~MicroserviceConnectionPool() {
+    // Stop resizing sub-pools before the members they log with are destroyed.
+    _replicas.clear();
+  }
 
-  std::shared_ptr<T> get_client() {
+  /* Leases a stream for a request that must be served by `deadline_ms` (see
+   * deadline.h). Waiting for a stream is bounded by the deadline and, on
+   * streams that do not share their connection, so are socket operations.
+   */
+  ReplicaLease<T> lease(const int64_t deadline_ms = 0) {
+    remaining_ms(deadline_ms);
     auto start_time = std::chrono::steady_clock::now();
-    int backlog_len = 0;
-    std::shared_ptr<T> conn = nullptr;
-    std::pair<std::string, int> server;
-    if (_pool_max_size > 0) {
-      std::unique_lock<std::mutex> lock(_conn_pool_mutex);
-      if (_pool_current_size < _pool_min_size) {
-        server = _servers[_pool_current_size++ % int(_servers.size())];
-      } else if (_conn_pool.size() > 0) {
-        conn = _conn_pool.front();
-        _conn_pool.pop();
-      } else if (_pool_current_size < _pool_max_size || _allow_ephemeral) {
-        server = _servers[_pool_current_size++ % int(_servers.size())];
-      } else {
-        backlog_len = ++_backlog_len;
-        while (_conn_pool.empty()) _conn_pool_condition.wait(lock);
-        _backlog_len--;
-        conn = _conn_pool.front();
-        _conn_pool.pop();
+    auto replica = select_replica();
+    replica->outstanding++;
+    int backlog_len;
+    ReplicaLease<T> conn(replica,
+                         lease_from(replica, &backlog_len, deadline_ms),
+                         start_time);
+    // Replace connections closed by a failure or by the server.
+    if (!conn->is_open()) {
+      try {
+        conn.stream() = std::move(*open_stream(replica));
+      } catch (...) {
+        conn.fail();
+        throw;
       }
-      lock.unlock();
-    } else {
-      server = _servers[rand() % int(_servers.size())];
     }
-    if (conn == nullptr)
-      conn = std::make_shared<T>(server.first, server.second, _conn_timeout_ms);
+    if (_requests_per_connection == 1)
+      conn->set_timeout(remaining_ms(deadline_ms));
     std::chrono::duration<double> latency =
         std::chrono::steady_clock::now() - start_time;
     if (_rpc_conn_logger)
@@ -95,21 +330,21 @@ class MicroserviceConnectionPool {
     return conn;
   }
 
-  void release_client(std::shared_ptr<T> conn) {
-    if (_pool_max_size > 0) {
-      std::unique_lock<std::mutex> lock(_conn_pool_mutex);
-      if (_pool_current_size > _pool_max_size ||
-          (_pool_current_size > _pool_min_size && _conn_pool.size() > 1)) {
-        conn->close();
-        _pool_current_size--;
-      } else {
-        _conn_pool.push(conn);
-        _conn_pool_condition.notify_one();
-      }
-      lock.unlock();
-    } else {
-      conn->close();
-    }
+  // Number of threads waiting for a stream, over all replicas.
+  int backlog() {
+    int backlog = 0;
+    for (const auto& replica : _replicas)
+      backlog += replica->stream_pool->backlog();
+    return backlog;
+  }
+
+  // Recent average time waited for a stream (in seconds), over the replica
+  // with the longest waits.
+  double wait_time() {
+    double wait_time = 0;
+    for (const auto& replica : _replicas)
+      wait_time = std::max(wait_time, replica->stream_pool->wait_time());
+    return wait_time;
   }
 };
 
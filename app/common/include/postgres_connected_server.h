@@ -4,19 +4,47 @@
 #ifndef POSTGRES_CONNECTED_SERVER__H
 #define POSTGRES_CONNECTED_SERVER__H
 
+#include <buzzblog/admission_control.h>
+#include <buzzblog/async_postgres_connection_pool.h>
+#include <buzzblog/async_rpc.h>
 #include <buzzblog/base_server.h>
+#include <buzzblog/deadline.h>
+#include <buzzblog/executor.h>
 #include <buzzblog/gen/buzzblog_types.h>
 #include <buzzblog/postgres_connection_pool.h>
+#include <buzzblog/postgres_pipeline.h>
+#include <buzzblog/slow_query_log.h>
 #include <buzzblog/utils.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <yaml-cpp/yaml.h>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 class PostgresConnectedServer : public BaseServer {
  protected:
+  /* Connects to the databases listed in the backend configuration. Services
+   * that run asynchronous queries (`async_queries`, see co_run_prepared and
+   * copy_out) get a non-blocking connection pool for each database besides
+   * its blocking one, and the two split the connection pool sizes evenly
+   * between them, so that a database never has more connections than
+   * `postgres_connection_pool_max_size`.
+   */
   PostgresConnectedServer(const std::string& local_service_name,
                           const std::string& backend_filepath,
                           const int postgres_connection_pool_min_size,
@@ -24,8 +52,20 @@ class PostgresConnectedServer : public BaseServer {
                           const bool postgres_connection_pool_allow_ephemeral,
                           const std::string& postgres_user,
                           const std::string& postgres_password,
-                          const int logging) {
+                          const bool async_queries, const int logging) {
     _local_service_name = local_service_name;
+    // A pool of size 0 opens a connection per statement, so both pools need
+    // at least one connection when the sizes are bounded.
+    if (async_queries && postgres_connection_pool_max_size == 1)
+      throw std::invalid_argument(
+          "Asynchronous queries need a Postgres connection pool max size of 0 "
+          "or at least 2");
+    int async_min_size =
+        async_queries ? postgres_connection_pool_min_size / 2 : 0;
+    int async_max_size =
+        async_queries ? postgres_connection_pool_max_size / 2 : 0;
+    int min_size = postgres_connection_pool_min_size - async_min_size;
+    int max_size = postgres_connection_pool_max_size - async_max_size;
     // Set PostgreSQL connection string format.
     char conn_cstr[128];
     const char* conn_fmt = "postgres://%s:%s@%s:%d/%s";
@@ -36,17 +76,17 @@ class PostgresConnectedServer : public BaseServer {
 
     // Initialize loggers.
     std::shared_ptr<spdlog::logger> query_conn_logger;
+    std::shared_ptr<spdlog::logger> pool_logger;
     if (logging) {
       _query_call_logger =
-          spdlog::basic_logger_mt("query_call_logger", "/tmp/query_call.log");
-      _query_call_logger->set_pattern(
-          "[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+          get_logger("query_call_logger", "/tmp/query_call.log");
       query_conn_logger =
-          spdlog::basic_logger_mt("query_conn_logger", "/tmp/query_conn.log");
-      query_conn_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+          get_logger("query_conn_logger", "/tmp/query_conn.log");
+      pool_logger = get_logger("pool_logger", "/tmp/pool.log");
     } else {
       _query_call_logger = nullptr;
       query_conn_logger = nullptr;
+      pool_logger = nullptr;
     }
 
     // Process backend configuration.
@@ -54,7 +94,34 @@ class PostgresConnectedServer : public BaseServer {
       auto service_name = it.first.as<std::string>();
       auto service_conf = it.second;
       // Process service database configuration.
-      if (service_conf["database"]) {
+      if (service_conf["shards"]) {
+        // Each shard holds part of the rows of the database.
+        int n_shards = service_conf["shards"].size();
+        _n_shards[service_name] = n_shards;
+        for (int shard = 0; shard < n_shards; shard++) {
+          auto db_address = service_conf["shards"][shard].as<std::string>();
+          auto db_host = db_address.substr(0, db_address.find(":"));
+          auto db_port =
+              std::stoi(db_address.substr(db_address.find(":") + 1));
+          sprintf(conn_cstr, conn_fmt, postgres_user.c_str(),
+                  postgres_password.c_str(), db_host.c_str(), db_port,
+                  service_name.c_str());
+          auto shard_name = shard_dbname(service_name, shard);
+          _cp[shard_name] = std::make_shared<PostgresConnectionPool>(
+              local_service_name, shard_name, std::string(conn_cstr),
+              min_size, max_size, postgres_connection_pool_allow_ephemeral,
+              query_conn_logger, pool_logger);
+          if (async_queries)
+            _async_cp[shard_name] =
+                std::make_shared<AsyncPostgresConnectionPool>(
+                    local_service_name, shard_name, std::string(conn_cstr),
+                    async_min_size, async_max_size,
+                    postgres_connection_pool_allow_ephemeral,
+                    query_conn_logger);
+          stdout_log("Added " + shard_name + " database shard on: " +
+                     db_address);
+        }
+      } else if (service_conf["database"]) {
         auto db_address = service_conf["database"].as<std::string>();
         auto db_host = db_address.substr(0, db_address.find(":"));
         auto db_port = std::stoi(db_address.substr(db_address.find(":") + 1));
@@ -63,42 +130,617 @@ class PostgresConnectedServer : public BaseServer {
                 service_name.c_str());
         _cp[service_name] = std::make_shared<PostgresConnectionPool>(
             local_service_name, service_name, std::string(conn_cstr),
-            postgres_connection_pool_min_size,
-            postgres_connection_pool_max_size,
-            postgres_connection_pool_allow_ephemeral, query_conn_logger);
+            min_size, max_size, postgres_connection_pool_allow_ephemeral,
+            query_conn_logger, pool_logger);
+        if (async_queries)
+          _async_cp[service_name] =
+              std::make_shared<AsyncPostgresConnectionPool>(
+                  local_service_name, service_name, std::string(conn_cstr),
+                  async_min_size, async_max_size,
+                  postgres_connection_pool_allow_ephemeral, query_conn_logger);
+        _n_shards[service_name] = 1;
         stdout_log("Added " + service_name + " database on: " + db_address);
+        // Process read replicas of the service database.
+        auto& replica_set = _replicas[service_name];
+        replica_set.last_writes = shared_last_writes(service_name);
+        for (const auto& replica_node : service_conf["replicas"]) {
+          auto replica_address = replica_node.as<std::string>();
+          auto replica_host =
+              replica_address.substr(0, replica_address.find(":"));
+          auto replica_port = std::stoi(
+              replica_address.substr(replica_address.find(":") + 1));
+          sprintf(conn_cstr, conn_fmt, postgres_user.c_str(),
+                  postgres_password.c_str(), replica_host.c_str(),
+                  replica_port, service_name.c_str());
+          auto replica = std::make_unique<ReadReplica>();
+          replica->address = replica_address;
+          replica->cp = std::make_shared<PostgresConnectionPool>(
+              local_service_name, service_name + "@" + replica_address,
+              std::string(conn_cstr), min_size, max_size,
+              postgres_connection_pool_allow_ephemeral, query_conn_logger,
+              pool_logger);
+          if (async_queries)
+            replica->async_cp = std::make_shared<AsyncPostgresConnectionPool>(
+                local_service_name, service_name + "@" + replica_address,
+                std::string(conn_cstr), async_min_size, async_max_size,
+                postgres_connection_pool_allow_ephemeral, query_conn_logger);
+          replica->outstanding = 0;
+          replica_set.replicas.push_back(std::move(replica));
+          stdout_log("Added " + service_name +
+                     " database replica on: " + replica_address);
+        }
+        replica_set.read_your_writes_ms =
+            service_conf["read_your_writes_ms"]
+                ? service_conf["read_your_writes_ms"].as<int64_t>()
+                : 0;
       }
     }
+
+    // Count waits for connections towards the load of the process.
+    std::vector<std::shared_ptr<PostgresConnectionPool>> pools;
+    for (const auto& it : _cp) pools.push_back(it.second);
+    for (const auto& it : _replicas)
+      for (const auto& replica : it.second.replicas)
+        pools.push_back(replica->cp);
+    for (const auto& cp : pools)
+      AdmissionController::instance().add_pool(
+          [cp] { return cp->backlog(); }, [cp] { return cp->wait_time(); });
+    std::vector<std::shared_ptr<AsyncPostgresConnectionPool>> async_pools;
+    for (const auto& it : _async_cp) async_pools.push_back(it.second);
+    for (const auto& it : _replicas)
+      for (const auto& replica : it.second.replicas)
+        if (replica->async_cp) async_pools.push_back(replica->async_cp);
+    for (const auto& cp : async_pools)
+      AdmissionController::instance().add_pool(
+          [cp] { return cp->backlog(); }, [cp] { return cp->wait_time(); });
   }
 
-  pqxx::result run_query(const std::string& query, const std::string& dbname) {
-    pqxx::result res;
-    auto conn = _cp[dbname]->get_client();
+  // Kinds of statements. Reads run outside of a transaction block, on a read
+  // replica if the database has any; primary reads, on the primary (e.g.,
+  // reads of rows that replicas may not have yet).
+  enum QueryKind { READ_QUERY, PRIMARY_READ_QUERY, WRITE_QUERY };
+
+  /* Declares a statement with parameters $1, $2, etc., which handlers run
+   * by name with run_prepared or run_queries. Statements must be declared
+   * before requests are served. Each connection prepares a statement the
+   * first time it runs it, so that the database parses and plans it once per
+   * connection.
+   */
+  void prepare(const std::string& name, const std::string& definition,
+               const QueryKind kind) {
+    _statements[name] = {definition, kind};
+  }
+
+  /* Returns the number of shards of a database, which is 1 unless it is
+   * sharded (see shard_dbname).
+   */
+  int shard_count(const std::string& dbname) { return _n_shards.at(dbname); }
+
+  /* Returns the name under which statements run on a shard of a database
+   * (e.g., "uniquepair/1"), which is the name of the database itself unless
+   * it is sharded.
+   */
+  std::string shard_dbname(const std::string& dbname, const int shard) {
+    if (_n_shards.at(dbname) == 1) return dbname;
+    return dbname + "/" + std::to_string(shard);
+  }
+
+  /* Runs a function on every shard of a database concurrently (on the
+   * executor), given the name of the shard, and returns its results (e.g.,
+   * pqxx::result) in shard order.
+   */
+  template <typename F>
+  auto scatter(const std::string& dbname, F f) {
+    using Result = decltype(f(std::string()));
+    TaskGroup task_group;
+    std::vector<std::future<Result>> futures;
+    for (int shard = 0; shard < shard_count(dbname); shard++) {
+      auto shard_name = shard_dbname(dbname, shard);
+      futures.push_back(
+          task_group.submit([&f, shard_name] { return f(shard_name); }));
+    }
+    std::vector<Result> results;
+    for (auto& future : futures) results.push_back(future.get());
+    return results;
+  }
+
+  /* Runs a coroutine (e.g., co_run_prepared) on every shard of a database
+   * concurrently, given the name of the shard, and returns their results in
+   * shard order. Unlike scatter, the calling thread is the only one held
+   * while shards run their statements.
+   */
+  template <typename F>
+  auto scatter_async(const std::string& dbname, F f) {
+    std::vector<decltype(f(std::string()))> tasks;
+    for (int shard = 0; shard < shard_count(dbname); shard++)
+      tasks.push_back(f(shard_dbname(dbname, shard)));
+    return sync_wait(when_all(std::move(tasks), shard_count(dbname)));
+  }
+
+  /* Merges results (pqxx::result, AsyncPostgresResult, or vectors of their
+   * rows) whose rows are sorted by an integer column in descending order
+   * (e.g., the results of a query on every shard) into rows in the same order.
+   * Skips the first `offset` rows and returns at most `limit` rows.
+   */
+  template <typename Result>
+  static auto merge_descending(const std::vector<Result>& results,
+                               const std::string& column, const int64_t offset,
+                               const int64_t limit) {
+    using Row = std::decay_t<decltype(results[0][0])>;
+    // Position of the next row of each result, by value of its column.
+    auto value_of = [&](const Row& row) {
+      return row[column].template as<int64_t>();
+    };
+    std::priority_queue<std::tuple<int64_t, size_t, size_t>> heads;
+    for (size_t i = 0; i < results.size(); i++)
+      if (results[i].size() > 0) heads.push({value_of(results[i][0]), i, 0});
+    std::vector<Row> rows;
+    for (int64_t n = 0; !heads.empty() && int64_t(rows.size()) < limit; n++) {
+      auto [value, i, j] = heads.top();
+      heads.pop();
+      if (n >= offset) rows.push_back(results[i][j]);
+      if (j + 1 < results[i].size())
+        heads.push({value_of(results[i][j + 1]), i, j + 1});
+    }
+    return rows;
+  }
+
+  /* Returns the cursor of the page that follows a row, given its id. Since ids
+   * sort by creation time, the next page holds the rows with smaller ids, and
+   * costs an index seek however deep it is. Clients pass cursors back as they
+   * are.
+   */
+  static std::string encode_cursor(const int64_t id) {
+    std::ostringstream cursor;
+    cursor << std::hex << id;
+    return cursor.str();
+  }
+
+  /* Returns the id that rows of the page of a cursor are smaller than (the
+   * largest id for the empty cursor of the first page). Throws
+   * TInvalidCursorException if the cursor was not returned by encode_cursor.
+   */
+  static int64_t decode_cursor(const std::string& cursor) {
+    if (cursor.empty()) return std::numeric_limits<int64_t>::max();
+    if (cursor.find_first_not_of("0123456789abcdef") != std::string::npos)
+      throw gen::TInvalidCursorException();
     try {
-      VOID_RPC_WRAPPER(
-          std::bind(&PostgresConnectedServer::exec_and_commit, this,
-                    std::ref(res), std::ref(query), std::ref(conn)),
-          _query_call_logger, "db=" + dbname + " ls=" + _local_service_name);
-    } catch (...) {
-      _cp[dbname]->release_client(conn);
-      throw;
+      return std::stoll(cursor, nullptr, 16);
+    } catch (const std::out_of_range&) {
+      throw gen::TInvalidCursorException();
+    }
+  }
+
+  /* Returns the literal of an array of values, to pass as an array parameter
+   * (e.g., to insert many rows at once with unnest).
+   */
+  template <typename T>
+  static std::string array_literal(const std::vector<T>& values) {
+    std::string literal = "{";
+    for (size_t i = 0; i < values.size(); i++) {
+      if (i > 0) literal += ",";
+      literal += "\"";
+      for (char c : pqxx::to_string(values[i])) {
+        if (c == '"' || c == '\\') literal += '\\';
+        literal += c;
+      }
+      literal += "\"";
     }
-    _cp[dbname]->release_client(conn);
+    return literal + "}";
+  }
+
+  /* Runs a declared statement with the given parameters for a request
+   * handled by handler method `lf`, which slow statements are logged with.
+   * Waiting for a connection and running the statement are both bounded by
+   * the deadline of the request, if it has one. Reads run on a read replica of
+   * the database, if it has any (see select_replica).
+   */
+  template <typename... Args>
+  pqxx::result run_prepared(const std::string& name, const std::string& dbname,
+                            const gen::TRequestMetadata& request_metadata,
+                            const std::string& lf, const Args&... args) {
+    pqxx::result res;
+    const auto& statement = _statements.at(name);
+    int64_t deadline_ms = get_deadline(request_metadata);
+    remaining_ms(deadline_ms);
+    auto replica =
+        select_replica(dbname, statement.kind == READ_QUERY, request_metadata);
+    ReplicaLoad replica_load(replica);
+    auto conn = (replica ? replica->cp : _cp[dbname])->lease(deadline_ms);
+    int64_t timeout_ms = statement_timeout_ms(deadline_ms);
+    auto start_time = std::chrono::steady_clock::now();
+    VOID_RPC_WRAPPER(
+        [&] {
+          // Declaring a statement again on a connection is a local no-op.
+          conn->conn.prepare(name, statement.definition);
+          if (statement.kind != WRITE_QUERY) {
+            // A single statement needs no BEGIN and COMMIT round trips.
+            set_session_timeout(*conn, timeout_ms);
+            pqxx::nontransaction txn(conn->conn);
+            res = txn.exec_prepared(name, args...);
+          } else {
+            pqxx::work txn(conn->conn);
+            auto set_timeout = local_timeout_command(*conn, timeout_ms);
+            if (!set_timeout.empty()) txn.exec(set_timeout);
+            res = txn.exec_prepared(name, args...);
+            txn.commit();
+          }
+        },
+        _query_call_logger,
+        "db=" + dbname + " ls=" + _local_service_name + " st=" + name +
+            " qk=" + (statement.kind == WRITE_QUERY ? "write" : "read") +
+            " rp=" + (replica ? replica->address : "primary"));
+    std::chrono::duration<double> latency =
+        std::chrono::steady_clock::now() - start_time;
+    if (SlowQueryLog::instance().is_slow(latency.count()))
+      explain_later(prepared_query(name, args...), dbname, replica,
+                    request_metadata, lf, latency.count());
+    if (statement.kind == WRITE_QUERY) note_write(dbname, request_metadata);
     return res;
   }
 
+  /* Runs a declared statement like run_prepared, as a coroutine that holds no
+   * thread while it waits for a connection or for its result: the statement
+   * is sent on a non-blocking connection (see AsyncPostgresConnectionPool)
+   * and an event loop resumes the coroutine once its result arrives. The
+   * statement runs outside of a transaction block, so writes must be single
+   * statements. Parameter values are copied, but the request metadata must
+   * outlive the task. Requires `async_queries` (see the constructor).
+   */
+  template <typename... Args>
+  Task<AsyncPostgresResult> co_run_prepared(
+      const std::string& name, const std::string& dbname,
+      const gen::TRequestMetadata& request_metadata, const std::string& lf,
+      const Args&... args) {
+    return co_run_query(prepared_query(name, args...), dbname,
+                        request_metadata, lf);
+  }
+
+  /* Runs a batch of declared statements (see prepared_query) for a request
+   * on one connection, pipelined so that they take a single round trip, and
+   * returns their results in order. The batch runs in a transaction unless
+   * all of its statements are reads. If a statement fails, later ones do not
+   * run and the error is thrown.
+   */
+  std::vector<pqxx::result> run_queries(
+      const std::vector<PreparedQuery>& queries, const std::string& dbname,
+      const gen::TRequestMetadata& request_metadata) {
+    std::vector<pqxx::result> results;
+    bool read_only = true;
+    bool on_replica = true;
+    std::string names;
+    for (const auto& query : queries) {
+      auto kind = _statements.at(query.name).kind;
+      if (kind == WRITE_QUERY) read_only = false;
+      if (kind != READ_QUERY) on_replica = false;
+      names += (names.empty() ? "" : ",") + query.name;
+    }
+    int64_t deadline_ms = get_deadline(request_metadata);
+    remaining_ms(deadline_ms);
+    auto replica = select_replica(dbname, on_replica, request_metadata);
+    ReplicaLoad replica_load(replica);
+    auto conn = (replica ? replica->cp : _cp[dbname])->lease(deadline_ms);
+    int64_t timeout_ms = statement_timeout_ms(deadline_ms);
+    VOID_RPC_WRAPPER(
+        [&] {
+          // Pipelined statements are run by name, so they must be registered
+          // with the server beforehand.
+          for (const auto& query : queries) {
+            conn->conn.prepare(query.name,
+                               _statements.at(query.name).definition);
+            conn->conn.prepare_now(query.name);
+          }
+          std::vector<std::string> commands;
+          if (read_only) {
+            set_session_timeout(*conn, timeout_ms);
+            pqxx::nontransaction txn(conn->conn);
+            for (const auto& query : queries)
+              commands.push_back(execute_command(txn, query));
+            results = exec_pipelined(txn, commands);
+          } else {
+            pqxx::work txn(conn->conn);
+            // The timeout is set in the same round trip as the batch.
+            auto set_timeout = local_timeout_command(*conn, timeout_ms);
+            if (!set_timeout.empty()) commands.push_back(set_timeout);
+            for (const auto& query : queries)
+              commands.push_back(execute_command(txn, query));
+            results = exec_pipelined(txn, commands);
+            if (!set_timeout.empty()) results.erase(results.begin());
+            txn.commit();
+          }
+        },
+        _query_call_logger,
+        "db=" + dbname + " ls=" + _local_service_name + " st=" + names +
+            " qk=" + (read_only ? "read" : "write") +
+            " rp=" + (replica ? replica->address : "primary"));
+    if (!read_only) note_write(dbname, request_metadata);
+    return results;
+  }
+
+  /* Runs a command that is not a declared statement (e.g., a change to the
+   * schema) in a transaction on the primary of a database, on behalf of no
+   * request and without a timeout.
+   */
+  pqxx::result run_command(const std::string& dbname,
+                           const std::string& command) {
+    pqxx::result res;
+    auto conn = _cp[dbname]->lease();
+    VOID_RPC_WRAPPER(
+        [&] {
+          pqxx::work txn(conn->conn);
+          auto set_timeout = local_timeout_command(*conn, 0);
+          if (!set_timeout.empty()) txn.exec(set_timeout);
+          res = txn.exec(command);
+          txn.commit();
+        },
+        _query_call_logger,
+        "db=" + dbname + " ls=" + _local_service_name + " st=command" +
+            " qk=write rp=primary");
+    return res;
+  }
+
+  /* Runs a `COPY ... TO STDOUT` command on a database, on behalf of no
+   * request, and passes each row of its output to `consume` as it arrives
+   * (see AsyncPostgresConnectionPool::copy_out). The command runs on a read
+   * replica of the database if it has any, so that bulk reads do not load
+   * the primary. Returns the number of rows copied. Requires `async_queries`
+   * (see the constructor).
+   */
+  int64_t copy_out(const std::string& dbname, const std::string& command,
+                   std::function<void(const char*, int)> consume) {
+    int64_t n_rows = 0;
+    auto replica = select_replica(dbname, true, gen::TRequestMetadata());
+    ReplicaLoad replica_load(replica);
+    VOID_RPC_WRAPPER(
+        [&] {
+          n_rows = sync_wait(
+              (replica ? replica->async_cp : _async_cp.at(dbname))
+                  ->copy_out(command, consume));
+        },
+        _query_call_logger,
+        "db=" + dbname + " ls=" + _local_service_name + " st=copy" +
+            " qk=read rp=" + (replica ? replica->address : "primary"));
+    return n_rows;
+  }
+
+  /* Records that the requester of a request wrote to a database, so that its
+   * reads of the database go to the primary for a while (see select_replica).
+   * Statements run by run_prepared and run_queries are recorded already;
+   * handlers call this for writes made on behalf of several requests.
+   */
+  void note_write(const std::string& dbname,
+                  const gen::TRequestMetadata& request_metadata) {
+    if (!request_metadata.__isset.requester_id) return;
+    auto it = _replicas.find(dbname);
+    if (it == _replicas.end()) return;
+    auto& database = it->second;
+    if (database.replicas.empty() || database.read_your_writes_ms <= 0)
+      return;
+    auto now = now_ms();
+    auto& last_writes = *database.last_writes;
+    std::lock_guard<std::mutex> lock(last_writes.mutex);
+    last_writes.times[request_metadata.requester_id] = now;
+    // Forget requesters whose window has passed, once in a while.
+    if (last_writes.times.size() < last_writes.prune_size) return;
+    for (auto write = last_writes.times.begin();
+         write != last_writes.times.end();) {
+      if (now - write->second >= database.read_your_writes_ms)
+        write = last_writes.times.erase(write);
+      else
+        write++;
+    }
+    last_writes.prune_size =
+        std::max(kMinPruneSize, 2 * last_writes.times.size());
+  }
+
  private:
+  // Number of requesters with recent writes to a database above which expired
+  // ones are forgotten.
+  static constexpr size_t kMinPruneSize = 1024;
+
+  struct Statement {
+    std::string definition;
+    QueryKind kind;
+  };
+
+  /* Read-only copy of a database, kept up to date by replication. */
+  struct ReadReplica {
+    std::string address;
+    std::shared_ptr<PostgresConnectionPool> cp;
+    std::shared_ptr<AsyncPostgresConnectionPool> async_cp;
+    // Number of statements running on the replica.
+    std::atomic<int> outstanding;
+  };
+
+  /* Time (ms since epoch) of the last write of each requester to a database
+   * through this process.
+   */
+  struct LastWrites {
+    std::unordered_map<int64_t, int64_t> times;
+    size_t prune_size = kMinPruneSize;
+    std::mutex mutex;
+  };
+
+  /* Read replicas of a database, and the requesters that wrote to it lately.
+   */
+  struct ReplicaSet {
+    std::vector<std::unique_ptr<ReadReplica>> replicas;
+    // Time (in milliseconds) after a write during which reads of the same
+    // requester go to the primary (0 means none).
+    int64_t read_your_writes_ms = 0;
+    std::shared_ptr<LastWrites> last_writes;
+  };
+
+  // Returns the last writes to a database, which all handlers of a process
+  // share (e.g., all shards of a sharded server).
+  static std::shared_ptr<LastWrites> shared_last_writes(
+      const std::string& dbname) {
+    static std::mutex mutex;
+    static std::map<std::string, std::shared_ptr<LastWrites>> last_writes;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& database_last_writes = last_writes[dbname];
+    if (!database_last_writes)
+      database_last_writes = std::make_shared<LastWrites>();
+    return database_last_writes;
+  }
+
+  /* Counts a statement as running on a read replica while in scope. */
+  class ReplicaLoad {
+   public:
+    explicit ReplicaLoad(ReadReplica* replica) {
+      _replica = replica;
+      if (_replica) _replica->outstanding++;
+    }
+    ~ReplicaLoad() {
+      if (_replica) _replica->outstanding--;
+    }
+
+   private:
+    ReadReplica* _replica;
+  };
+
+  /* Returns the read replica on which to run statements for a request, or
+   * nullptr to run them on the primary. Writes go to the primary, and so do
+   * reads of a requester that wrote in the last `read_your_writes_ms`
+   * milliseconds, so that they see their own writes: either as carried by the
+   * request (`last_write`, set by the API Gateway) or through this process.
+   * Other reads go to the replica with the fewest statements running.
+   */
+  ReadReplica* select_replica(const std::string& dbname, const bool read_only,
+                              const gen::TRequestMetadata& request_metadata) {
+    if (!read_only) return nullptr;
+    auto it = _replicas.find(dbname);
+    if (it == _replicas.end() || it->second.replicas.empty()) return nullptr;
+    auto& database = it->second;
+    if (database.read_your_writes_ms > 0) {
+      auto now = now_ms();
+      if (request_metadata.__isset.last_write &&
+          now - request_metadata.last_write < database.read_your_writes_ms)
+        return nullptr;
+      if (request_metadata.__isset.requester_id) {
+        auto& last_writes = *database.last_writes;
+        std::lock_guard<std::mutex> lock(last_writes.mutex);
+        auto write = last_writes.times.find(request_metadata.requester_id);
+        if (write != last_writes.times.end() &&
+            now - write->second < database.read_your_writes_ms)
+          return nullptr;
+      }
+    }
+    // Start at a random replica to break ties evenly.
+    thread_local std::minstd_rand rng(std::random_device{}());
+    int n_replicas = database.replicas.size();
+    int first = rng() % n_replicas;
+    ReadReplica* best = database.replicas[first].get();
+    for (int i = 1; i < n_replicas; i++) {
+      auto replica = database.replicas[(first + i) % n_replicas].get();
+      if (replica->outstanding.load() < best->outstanding.load())
+        best = replica;
+    }
+    return best;
+  }
+
+  // Runs a statement for co_run_prepared, taking its parameter values as
+  // strings so that they live in the coroutine.
+  Task<AsyncPostgresResult> co_run_query(
+      const PreparedQuery query, const std::string dbname,
+      const gen::TRequestMetadata& request_metadata, const std::string lf) {
+    const auto& statement = _statements.at(query.name);
+    int64_t deadline_ms = get_deadline(request_metadata);
+    auto replica =
+        select_replica(dbname, statement.kind == READ_QUERY, request_metadata);
+    ReplicaLoad replica_load(replica);
+    auto start_time = std::chrono::steady_clock::now();
+    auto res = co_await CO_RPC_WRAPPER(
+        (replica ? replica->async_cp : _async_cp.at(dbname))
+            ->exec_prepared(deadline_ms, query.name, statement.definition,
+                            query.params),
+        _query_call_logger,
+        "db=" + dbname + " ls=" + _local_service_name + " st=" + query.name +
+            " qk=" + (statement.kind == WRITE_QUERY ? "write" : "read") +
+            " rp=" + (replica ? replica->address : "primary"));
+    std::chrono::duration<double> latency =
+        std::chrono::steady_clock::now() - start_time;
+    if (SlowQueryLog::instance().is_slow(latency.count()))
+      explain_later(query, dbname, replica, request_metadata, lf,
+                    latency.count());
+    if (statement.kind == WRITE_QUERY) note_write(dbname, request_metadata);
+    co_return res;
+  }
+
+  // Has the plan of a statement that was slow for a request logged by the
+  // slow query log. Reads are explained with EXPLAIN ANALYZE, which runs the
+  // statement, in a transaction that is rolled back. Writes are only planned:
+  // running them again would take locks on the primary and, since they insert
+  // ids generated by the service, fail on the rows they already inserted.
+  void explain_later(const PreparedQuery& query, const std::string& dbname,
+                     ReadReplica* replica,
+                     const gen::TRequestMetadata& request_metadata,
+                     const std::string& lf, const double latency) {
+    auto cp = replica ? replica->cp : _cp.at(dbname);
+    auto definition = _statements.at(query.name).definition;
+    auto explain = _statements.at(query.name).kind != WRITE_QUERY
+                       ? "EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) "
+                       : "EXPLAIN (FORMAT JSON) ";
+    SlowQueryLog::instance().submit(
+        "ls=" + _local_service_name + " lf=" + lf + " db=" + dbname +
+            " st=" + query.name +
+            " rp=" + (replica ? replica->address : "primary") +
+            " rid=" + request_metadata.id + " lat=" + std::to_string(latency) +
+            " params=" + SlowQueryLog::quote(query.params),
+        [cp, query, definition, explain] {
+          auto conn = cp->lease();
+          conn->conn.prepare(query.name, definition);
+          conn->conn.prepare_now(query.name);
+          pqxx::work txn(conn->conn);
+          auto set_timeout = local_timeout_command(*conn, 0);
+          if (!set_timeout.empty()) txn.exec(set_timeout);
+          auto res =
+              txn.exec(std::string(explain) + execute_command(txn, query));
+          // Put the plan on a single line.
+          std::string plan;
+          bool indent = false;
+          for (char c : res[0][0].as<std::string>()) {
+            if (c == '\n') {
+              indent = true;
+            } else if (!indent || c != ' ') {
+              plan += c;
+              indent = false;
+            }
+          }
+          return plan;
+        });
+  }
+
+  // Sets the statement timeout for the session of a connection, only when it
+  // changes.
+  static void set_session_timeout(PostgresConnection& conn,
+                                  const int64_t timeout_ms) {
+    if (conn.statement_timeout_ms == timeout_ms) return;
+    conn.conn.set_variable("statement_timeout", std::to_string(timeout_ms));
+    conn.statement_timeout_ms = timeout_ms;
+  }
+
+  // Returns the command that sets the statement timeout for a transaction on
+  // a connection, or an empty string if the session timeout is the same.
+  static std::string local_timeout_command(PostgresConnection& conn,
+                                           const int64_t timeout_ms) {
+    if (conn.statement_timeout_ms == timeout_ms) return "";
+    return "SET LOCAL statement_timeout = " + std::to_string(timeout_ms);
+  }
+
   std::string _local_service_name;
   std::shared_ptr<spdlog::logger> _query_call_logger;
-  // Database connection pools.
+  // Database connection pools, by database or shard name.
   std::map<std::string, std::shared_ptr<PostgresConnectionPool>> _cp;
-
-  void exec_and_commit(pqxx::result& res, const std::string& query,
-                       const std::shared_ptr<pqxx::connection> conn) {
-    pqxx::work txn(*conn);
-    res = txn.exec(query);
-    txn.commit();
-  }
+  // Non-blocking database connection pools, by database or shard name.
+  std::map<std::string, std::shared_ptr<AsyncPostgresConnectionPool>>
+      _async_cp;
+  // Number of shards of each database.
+  std::map<std::string, int> _n_shards;
+  // Read replicas of databases.
+  std::map<std::string, ReplicaSet> _replicas;
+  // Prepared statements, by name.
+  std::map<std::string, Statement> _statements;
 };
 
 #endif
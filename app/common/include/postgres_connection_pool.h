@@ -4,80 +4,68 @@
 #ifndef POSTGRES_CONNECTION_POOL__H
 #define POSTGRES_CONNECTION_POOL__H
 
-#include <assert.h>
 #include <buzzblog/gen/buzzblog_types.h>
+#include <buzzblog/lockfree_connection_pool.h>
 #include <spdlog/sinks/basic_file_sink.h>
 
 #include <chrono>
-#include <condition_variable>
 #include <memory>
-#include <mutex>
 #include <pqxx/pqxx>
-#include <queue>
 #include <string>
 
+/* Pooled database connection, along with the session settings it carries
+ * from one lease to the next.
+ */
+struct PostgresConnection {
+  pqxx::connection conn;
+  // Statement timeout of the session (in milliseconds, 0 means none).
+  int64_t statement_timeout_ms;
+
+  PostgresConnection(const std::string& conn_cstr) : conn(conn_cstr) {
+    statement_timeout_ms = 0;
+  }
+};
+
 class PostgresConnectionPool {
  private:
   std::string _local_service_name;
   std::string _dbname;
   std::string _conn_cstr;
-  int _pool_current_size;
-  int _pool_min_size;
-  int _pool_max_size;
-  int _backlog_len;
-  bool _allow_ephemeral;
-  std::queue<std::shared_ptr<pqxx::connection>> _conn_pool;
-  std::mutex _conn_pool_mutex;
-  std::condition_variable _conn_pool_condition;
+  std::unique_ptr<LockFreeConnectionPool<PostgresConnection>> _conn_pool;
   std::shared_ptr<spdlog::logger> _query_conn_logger;
+  std::shared_ptr<spdlog::logger> _pool_logger;
 
  public:
   PostgresConnectionPool(const std::string& local_service_name,
                          const std::string& dbname,
                          const std::string& conn_cstr, const int pool_min_size,
                          const int pool_max_size, const bool allow_ephemeral,
-                         std::shared_ptr<spdlog::logger> query_conn_logger) {
+                         std::shared_ptr<spdlog::logger> query_conn_logger,
+                         std::shared_ptr<spdlog::logger> pool_logger) {
     _local_service_name = local_service_name;
     _dbname = dbname;
     _conn_cstr = conn_cstr;
-    _pool_min_size = pool_min_size;
-    _pool_max_size = pool_max_size;
-    _allow_ephemeral = allow_ephemeral;
     _query_conn_logger = query_conn_logger;
-    _pool_current_size = 0;
-    _backlog_len = 0;
-
-    // Validate connection pool parameters.
-    assert(_pool_min_size >= 0);
-    assert(_pool_max_size >= 0);
-    assert(_pool_max_size >= _pool_min_size);
+    _pool_logger = pool_logger;
+    _conn_pool = std::make_unique<LockFreeConnectionPool<PostgresConnection>>(
+        pool_min_size, pool_max_size, allow_ephemeral,
+        [this] { return std::make_unique<PostgresConnection>(_conn_cstr); });
+    if (_pool_logger)
+      _conn_pool->on_resize([this](int size) {
+        _pool_logger->info("ls={} db={} size={}", _local_service_name, _dbname,
+                           size);
+      });
   }
 
-  ~PostgresConnectionPool() {}
+  ~PostgresConnectionPool() {
+    // Stop resizing the pool before the members it logs with are destroyed.
+    _conn_pool.reset();
+  }
 
-  std::shared_ptr<pqxx::connection> get_client() {
+  ConnectionLease<PostgresConnection> lease(const int64_t deadline_ms = 0) {
     auto start_time = std::chrono::steady_clock::now();
-    int backlog_len = 0;
-    std::shared_ptr<pqxx::connection> conn = nullptr;
-    if (_pool_max_size > 0) {
-      std::unique_lock<std::mutex> lock(_conn_pool_mutex);
-      if (_pool_current_size < _pool_min_size) {
-        _pool_current_size++;
-      } else if (_conn_pool.size() > 0) {
-        conn = _conn_pool.front();
-        _conn_pool.pop();
-      } else if (_pool_current_size < _pool_max_size || _allow_ephemeral) {
-        _pool_current_size++;
-      } else {
-        backlog_len = ++_backlog_len;
-        while (_conn_pool.empty()) _conn_pool_condition.wait(lock);
-        _backlog_len--;
-        conn = _conn_pool.front();
-        _conn_pool.pop();
-      }
-      lock.unlock();
-    }
-    if (conn == nullptr) conn = std::make_shared<pqxx::connection>(_conn_cstr);
+    int backlog_len;
+    auto conn = _conn_pool->lease(&backlog_len, deadline_ms);
     std::chrono::duration<double> latency =
         std::chrono::steady_clock::now() - start_time;
     if (_query_conn_logger)
@@ -86,22 +74,9 @@ class PostgresConnectionPool {
     return conn;
   }
 
-  void release_client(std::shared_ptr<pqxx::connection> conn) {
-    if (_pool_max_size > 0) {
-      std::unique_lock<std::mutex> lock(_conn_pool_mutex);
-      if (_pool_current_size > _pool_max_size ||
-          (_pool_current_size > _pool_min_size && _conn_pool.size() > 1)) {
-        conn->disconnect();
-        _pool_current_size--;
-      } else {
-        _conn_pool.push(conn);
-        _conn_pool_condition.notify_one();
-      }
-      lock.unlock();
-    } else {
-      conn->disconnect();
-    }
-  }
+  int backlog() { return _conn_pool->backlog(); }
+
+  double wait_time() { return _conn_pool->wait_time(); }
 };
 
 #endif
@@ -0,0 +1,56 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef POSTGRES_PIPELINE__H
+#define POSTGRES_PIPELINE__H
+
+#include <pqxx/pqxx>
+#include <string>
+#include <vector>
+
+/* Run of a prepared statement: its name and parameter values. */
+struct PreparedQuery {
+  std::string name;
+  std::vector<std::string> params;
+};
+
+template <typename... Args>
+PreparedQuery prepared_query(const std::string& name, const Args&... args) {
+  return {name, {pqxx::to_string(args)...}};
+}
+
+/* Returns the SQL command that runs a prepared statement, which must already
+ * be registered with the server on the connection (see
+ * pqxx::connection::prepare_now).
+ */
+std::string execute_command(pqxx::transaction_base& txn,
+                            const PreparedQuery& query) {
+  std::string command = "EXECUTE " + txn.quote_name(query.name);
+  if (query.params.empty()) return command;
+  command += "(";
+  for (size_t i = 0; i < query.params.size(); i++) {
+    if (i > 0) command += ", ";
+    command += txn.quote(query.params[i]);
+  }
+  return command + ")";
+}
+
+/* Sends a batch of SQL commands to the server at once, instead of waiting for
+ * the result of each command before sending the next one, and returns their
+ * results in order. If a command fails, later ones do not run and the error
+ * is thrown.
+ */
+std::vector<pqxx::result> exec_pipelined(
+    pqxx::transaction_base& txn, const std::vector<std::string>& commands) {
+  pqxx::pipeline pipeline(txn);
+  // Hold all commands back until the batch is complete.
+  pipeline.retain(commands.size() + 1);
+  std::vector<pqxx::pipeline::query_id> ids;
+  for (const auto& command : commands) ids.push_back(pipeline.insert(command));
+  pipeline.complete();
+  std::vector<pqxx::result> results;
+  for (auto id : ids) results.push_back(pipeline.retrieve(id));
+  return results;
+}
+
+#endif
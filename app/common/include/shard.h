@@ -0,0 +1,86 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef SHARD__H
+#define SHARD__H
+
+#include <sched.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* Shards of a process served by a ShardedServer, one per CPU. Every thread of
+ * a shard is pinned to (or inherits) the CPU of the shard, so the CPU a thread
+ * runs on tells its shard. Processes that are not sharded have one shard.
+ */
+class Shards {
+ private:
+  static std::vector<int>& shard_of_cpu() {
+    static std::vector<int> shard_of_cpu(CPU_SETSIZE, -1);
+    return shard_of_cpu;
+  }
+
+  static int& n_shards() {
+    static int n_shards = 1;
+    return n_shards;
+  }
+
+ public:
+  /* Assigns one shard to each of the given CPUs. Must be called before the
+   * shards are started.
+   */
+  static void configure(const std::vector<int>& cpus) {
+    std::fill(shard_of_cpu().begin(), shard_of_cpu().end(), -1);
+    for (size_t i = 0; i < cpus.size(); i++) shard_of_cpu()[cpus[i]] = i;
+    n_shards() = std::max(1, int(cpus.size()));
+  }
+
+  static int count() { return n_shards(); }
+
+  // Returns the shard of the calling thread (0 for threads of no shard).
+  static int current() {
+    if (n_shards() == 1) return 0;
+    int cpu = sched_getcpu();
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return 0;
+    return std::max(0, shard_of_cpu()[cpu]);
+  }
+};
+
+/* One instance of T per shard, created on first use by a thread of the shard
+ * so that threads the instance starts inherit the CPU of the shard. Shards
+ * share no instance, and thus none of the locks of T.
+ */
+template <typename T>
+class PerShard {
+ private:
+  std::function<std::unique_ptr<T>()> _factory;
+  std::unique_ptr<std::once_flag[]> _created;
+  std::unique_ptr<std::unique_ptr<T>[]> _instances;
+
+ public:
+  PerShard(std::function<std::unique_ptr<T>()> factory) {
+    _factory = factory;
+    _created.reset(new std::once_flag[CPU_SETSIZE]);
+    _instances.reset(new std::unique_ptr<T>[CPU_SETSIZE]);
+  }
+
+  /* Sets how instances are created. Must be called before any instance is
+   * used.
+   */
+  void configure(std::function<std::unique_ptr<T>()> factory) {
+    _factory = factory;
+  }
+
+  // Returns the instance of the shard of the calling thread.
+  T& get() {
+    int shard = Shards::current();
+    std::call_once(_created[shard],
+                   [&] { _instances[shard] = _factory(); });
+    return *_instances[shard];
+  }
+};
+
+#endif
@@ -0,0 +1,185 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef SLOW_QUERY_LOG__H
+#define SLOW_QUERY_LOG__H
+
+#include <buzzblog/shard.h>
+#include <buzzblog/utils.h>
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Log of the plans of slow statements of a shard of the process (see
+ * PerShard). Statements that run for at least `threshold_ms` milliseconds are
+ * run again with EXPLAIN ANALYZE by a background thread, off the path of the
+ * request, and their plan is logged to `/tmp/slow_query.log` along with the
+ * handler method, statement name, request id, latency, and parameter values.
+ * At most `max_explains_per_s` statements are explained per second; others
+ * are dropped (and counted), and so are statements found slow while
+ * `kMaxQueued` are waiting to be explained.
+ */
+class SlowQueryLog {
+ private:
+  struct SlowQuery {
+    std::string logline;
+    std::function<std::string()> explain;
+  };
+
+  static constexpr size_t kMaxQueued = 16;
+
+  double _threshold;
+  int _max_explains_per_s;
+  std::deque<SlowQuery> _queue;
+  std::mutex _mutex;
+  std::condition_variable _queue_condition;
+  bool _stop;
+  // Second (since the Unix epoch) and number of statements explained in it.
+  int64_t _window_s;
+  int _window_explains;
+  long _n_dropped;
+  std::thread _thread;
+  std::shared_ptr<spdlog::logger> _slow_query_logger;
+
+  static PerShard<SlowQueryLog>& global() {
+    static PerShard<SlowQueryLog> logs(
+        [] { return std::make_unique<SlowQueryLog>(0, 0, 0); });
+    return logs;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+      _queue_condition.wait(lock, [this] { return _stop || !_queue.empty(); });
+      if (_stop) return;
+      auto slow_query = std::move(_queue.front());
+      _queue.pop_front();
+      long n_dropped = _n_dropped;
+      lock.unlock();
+      std::string plan;
+      try {
+        plan = "plan=" + slow_query.explain();
+      } catch (const std::exception& e) {
+        plan = "err=" + quote(e.what());
+      }
+      _slow_query_logger->info("{} dr={} {}", slow_query.logline, n_dropped,
+                               plan);
+      lock.lock();
+    }
+  }
+
+ public:
+  SlowQueryLog(const int threshold_ms, const int max_explains_per_s,
+               const int logging) {
+    _threshold = threshold_ms / 1000.0;
+    _max_explains_per_s = max_explains_per_s;
+    _stop = false;
+    _window_s = 0;
+    _window_explains = 0;
+    _n_dropped = 0;
+
+    // Explain slow statements in the background.
+    if (logging && threshold_ms > 0) {
+      _slow_query_logger =
+          get_logger("slow_query_logger", "/tmp/slow_query.log");
+      _thread = std::thread(&SlowQueryLog::run, this);
+    } else {
+      _slow_query_logger = nullptr;
+    }
+  }
+
+  ~SlowQueryLog() {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _queue_condition.notify_all();
+    if (_thread.joinable()) _thread.join();
+  }
+
+  /* Sets the threshold and rate of the slow query logs of all shards. Must
+   * be called once, before any request is served.
+   */
+  static void configure(const int threshold_ms, const int max_explains_per_s,
+                        const int logging) {
+    global().configure([=] {
+      return std::make_unique<SlowQueryLog>(threshold_ms, max_explains_per_s,
+                                            logging);
+    });
+  }
+
+  // Returns the slow query log of the calling thread's shard.
+  static SlowQueryLog& instance() { return global().get(); }
+
+  // Returns whether a statement that took `latency` seconds is slow.
+  bool is_slow(const double latency) {
+    return _slow_query_logger && latency >= _threshold;
+  }
+
+  /* Submits a slow statement to be explained. `explain` runs it again with
+   * EXPLAIN ANALYZE and returns its plan, and `logline` prefixes the plan in
+   * the log.
+   */
+  void submit(const std::string& logline,
+              std::function<std::string()> explain) {
+    if (!_slow_query_logger) return;
+    int64_t now_s = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (now_s != _window_s) {
+        _window_s = now_s;
+        _window_explains = 0;
+      }
+      if (_window_explains >= _max_explains_per_s ||
+          _queue.size() >= kMaxQueued) {
+        _n_dropped++;
+        return;
+      }
+      _window_explains++;
+      _queue.push_back({logline, explain});
+    }
+    _queue_condition.notify_one();
+  }
+
+  /* Returns a string as a JSON string literal, so that values with spaces or
+   * line breaks fit in a log line.
+   */
+  static std::string quote(const std::string& value) {
+    std::string quoted = "\"";
+    for (unsigned char c : value) {
+      if (c == '"' || c == '\\') {
+        quoted += '\\';
+        quoted += c;
+      } else if (c < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        quoted += escaped;
+      } else {
+        quoted += c;
+      }
+    }
+    return quoted + "\"";
+  }
+
+  /* Returns a list of values as a JSON array of string literals. */
+  static std::string quote(const std::vector<std::string>& values) {
+    std::string quoted = "[";
+    for (size_t i = 0; i < values.size(); i++)
+      quoted += (i > 0 ? "," : "") + quote(values[i]);
+    return quoted + "]";
+  }
+};
+
+#endif
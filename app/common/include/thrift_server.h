@@ -0,0 +1,543 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef THRIFT_SERVER__H
+#define THRIFT_SERVER__H
+
+#include <arpa/inet.h>
+#include <buzzblog/shard.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <thrift/TApplicationException.h>
+#include <thrift/concurrency/Thread.h>
+#include <thrift/concurrency/ThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/server/TThreadPoolServer.h>
+#include <thrift/server/TThreadedServer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TNonblockingServerSocket.h>
+#include <thrift/transport/TServerSocket.h>
+#include <thrift/transport/TSocket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace apache::thrift;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::server;
+using namespace apache::thrift::transport;
+
+/* Sets the stack size of every thread created from now on by this process,
+ * including Thrift worker threads and threads started with std::thread or
+ * std::async. A stack size of 0 keeps the system default (ulimit -s).
+ */
+void set_thread_stack_size(const int stack_size_kb) {
+  if (stack_size_kb <= 0) return;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (pthread_attr_setstacksize(&attr, size_t(stack_size_kb) * 1024) != 0 ||
+      pthread_setattr_default_np(&attr) != 0) {
+    pthread_attr_destroy(&attr);
+    throw std::invalid_argument("Invalid thread stack size: " +
+                                std::to_string(stack_size_kb) + " KB");
+  }
+  pthread_attr_destroy(&attr);
+}
+
+/* Returns the CPUs this process may run on or, if `numa_node` is not
+ * negative, those of them that belong to that NUMA node.
+ */
+std::vector<int> get_cpus(const int numa_node) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0)
+    throw std::runtime_error("Failed to get the CPUs of the process");
+  std::vector<int> cpus;
+  if (numa_node < 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &cpu_set)) cpus.push_back(cpu);
+    return cpus;
+  }
+  // Parse CPU list (e.g., "0-7,16-23").
+  std::ifstream cpulist("/sys/devices/system/node/node" +
+                        std::to_string(numa_node) + "/cpulist");
+  if (!cpulist)
+    throw std::invalid_argument("Invalid NUMA node: " +
+                                std::to_string(numa_node));
+  std::string range;
+  while (std::getline(cpulist, range, ',')) {
+    auto dash = range.find("-");
+    int first = std::stoi(range.substr(0, dash));
+    int last = dash == std::string::npos ? first
+                                         : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &cpu_set)) cpus.push_back(cpu);
+  }
+  // Containers and taskset may exclude all CPUs of the node.
+  if (cpus.empty())
+    throw std::invalid_argument("No CPU of NUMA node " +
+                                std::to_string(numa_node) +
+                                " is available to the process");
+  return cpus;
+}
+
+/* Pins the calling thread to a CPU. Threads it creates afterwards inherit
+ * the affinity.
+ */
+void pin_thread(const int cpu) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0)
+    throw std::runtime_error("Failed to pin thread to CPU " +
+                             std::to_string(cpu));
+}
+
+/* Listening socket bound with SO_REUSEPORT, so that several sockets can
+ * listen on the same port and the kernel spreads connections among them.
+ */
+class ReusePortServerSocket : public TServerTransport {
+ private:
+  std::string _host;
+  int _port;
+  int _accept_backlog;
+  std::atomic<int> _fd;
+  // Whether to stop accepting, even if interrupted before listening.
+  std::atomic<bool> _interrupted;
+
+ protected:
+  std::shared_ptr<TTransport> acceptImpl() override {
+    int fd;
+    do {
+      fd = ::accept4(_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+      throw TTransportException(TTransportException::UNKNOWN,
+                                "accept() failed: " +
+                                    std::string(strerror(errno)));
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return std::make_shared<TSocket>(fd);
+  }
+
+ public:
+  ReusePortServerSocket(const std::string& host, const int port,
+                        const int accept_backlog) {
+    _host = host;
+    _port = port;
+    _accept_backlog = accept_backlog > 0 ? accept_backlog : SOMAXCONN;
+    _fd = -1;
+    _interrupted = false;
+  }
+
+  ~ReusePortServerSocket() { close(); }
+
+  void listen() override {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addr;
+    if (getaddrinfo(_host.c_str(), std::to_string(_port).c_str(), &hints,
+                    &addr) != 0)
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not resolve " + _host);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    _fd = fd;
+    int one = 1;
+    int rc = fd < 0 ? -1 : 0;
+    if (rc == 0)
+      rc = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (rc == 0)
+      rc = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    if (rc == 0) rc = bind(fd, addr->ai_addr, addr->ai_addrlen);
+    if (rc == 0) rc = ::listen(fd, _accept_backlog);
+    freeaddrinfo(addr);
+    if (rc != 0)
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "Could not listen on port " +
+                                    std::to_string(_port) + ": " +
+                                    std::string(strerror(errno)));
+    if (_interrupted) shutdown(fd, SHUT_RDWR);
+  }
+
+  void interrupt() override {
+    _interrupted = true;
+    int fd = _fd;
+    if (fd >= 0) shutdown(fd, SHUT_RDWR);
+  }
+
+  void close() override {
+    int fd = _fd.exchange(-1);
+    if (fd >= 0) ::close(fd);
+  }
+
+  THRIFT_SOCKET getSocketFD() override { return _fd; }
+};
+
+/* Runs one shard per CPU. Each shard has its own thread pinned to its CPU,
+ * its own SO_REUSEPORT listening socket, and its own processor, created by
+ * the pinned thread so that the handler's memory (e.g., its connection pools)
+ * is local to the CPU. Connection threads of a shard inherit its CPU, and so
+ * does every thread started for the shard by a PerShard instance (e.g., its
+ * event loops and executor workers), so shards share no lock.
+ */
+class ShardedServer : public TServer {
+ private:
+  std::function<std::shared_ptr<TProcessor>()> _processor_factory;
+  std::string _host;
+  int _port;
+  int _threads;
+  int _accept_backlog;
+  std::vector<int> _cpus;
+  std::vector<std::shared_ptr<TServer>> _shards;
+  bool _stopped;
+  // First error of a shard, rethrown by serve().
+  std::exception_ptr _error;
+  std::mutex _shards_mutex;
+
+  void run_shard(const int cpu) {
+    try {
+      pin_thread(cpu);
+      auto server = std::make_shared<TThreadedServer>(
+          _processor_factory(),
+          std::make_shared<ReusePortServerSocket>(_host, _port,
+                                                  _accept_backlog),
+          std::make_shared<TBufferedTransportFactory>(),
+          std::make_shared<TBinaryProtocolFactory>());
+      if (_threads > 0) server->setConcurrentClientLimit(_threads);
+      {
+        std::unique_lock<std::mutex> lock(_shards_mutex);
+        if (_stopped) return;
+        _shards.push_back(server);
+      }
+      server->serve();
+    } catch (...) {
+      // Exceptions must not escape the thread of the shard: stop the other
+      // shards and let serve() rethrow it.
+      {
+        std::unique_lock<std::mutex> lock(_shards_mutex);
+        if (!_error) _error = std::current_exception();
+      }
+      stop();
+    }
+  }
+
+ public:
+  ShardedServer(std::function<std::shared_ptr<TProcessor>()> processor_factory,
+                const std::string& host, const int port, const int threads,
+                const int accept_backlog, const std::vector<int>& cpus)
+      : TServer(std::shared_ptr<TProcessor>()) {
+    _processor_factory = processor_factory;
+    _host = host;
+    _port = port;
+    _threads = threads;
+    _accept_backlog = accept_backlog;
+    _cpus = cpus;
+    _stopped = false;
+    Shards::configure(cpus);
+  }
+
+  /* Serves requests until stopped. Rethrows the first error of a shard (e.g.,
+   * failing to create its processor) once all shards have stopped.
+   */
+  void serve() override {
+    std::vector<std::thread> shards;
+    for (auto cpu : _cpus)
+      shards.emplace_back(&ShardedServer::run_shard, this, cpu);
+    for (auto& shard : shards) shard.join();
+    if (_error) std::rethrow_exception(_error);
+  }
+
+  void stop() override {
+    std::unique_lock<std::mutex> lock(_shards_mutex);
+    _stopped = true;
+    for (auto& shard : _shards) shard->stop();
+  }
+};
+
+/* Server that processes the requests of a connection concurrently. A thread
+ * per connection reads framed requests and hands them to a pool of workers,
+ * which write each response as soon as it is ready, possibly out of order.
+ * Clients match responses to requests by sequence id (see ConcurrentClient in
+ * the service client libraries). A request the processor fails on gets a
+ * TApplicationException in response, so that the other requests of its
+ * connection are unaffected. Only the reading thread closes a connection.
+ */
+class PipelinedServer : public TServer {
+ private:
+  // Connection to a client, shared by its reading thread and the workers
+  // processing its requests.
+  struct Connection {
+    std::shared_ptr<TTransport> socket;
+    // Serializes responses, and closing the socket.
+    std::mutex socket_mutex;
+    std::thread reader;
+    std::atomic<bool> done;
+
+    // Stops reading (and writing), without closing the socket.
+    void shut_down() {
+      auto tsocket = std::dynamic_pointer_cast<TSocket>(socket);
+      if (tsocket && tsocket->getSocketFD() >= 0)
+        ::shutdown(tsocket->getSocketFD(), SHUT_RDWR);
+    }
+
+    void write(const uint8_t* buf, const uint32_t len) {
+      std::unique_lock<std::mutex> lock(socket_mutex);
+      try {
+        socket->write(buf, len);
+        socket->flush();
+      } catch (const std::exception&) {
+        // The response may have been cut short, so later ones could not be
+        // parsed: make the reader close the connection.
+        shut_down();
+      }
+    }
+  };
+
+  // Processes one request and writes its response to the connection.
+  class Request : public Runnable {
+   private:
+    // Writes a TApplicationException in response to the request.
+    void write_exception(std::shared_ptr<TMemoryBuffer> out_buffer,
+                         const std::string& message) {
+      std::string name;
+      TMessageType type = T_CALL;
+      int32_t seqid = 0;
+      try {
+        TBinaryProtocol(std::make_shared<TMemoryBuffer>(
+                            data.data(), uint32_t(data.size())))
+            .readMessageBegin(name, type, seqid);
+      } catch (const std::exception&) {
+        // Answer requests with a malformed header with sequence id 0.
+      }
+      if (type == T_ONEWAY) return;
+      auto out_transport = std::make_shared<TFramedTransport>(out_buffer);
+      TBinaryProtocol out_protocol(out_transport);
+      out_protocol.writeMessageBegin(name, T_EXCEPTION, seqid);
+      TApplicationException(TApplicationException::INTERNAL_ERROR, message)
+          .write(&out_protocol);
+      out_protocol.writeMessageEnd();
+      out_transport->flush();
+    }
+
+   public:
+    std::shared_ptr<TProcessor> processor;
+    std::shared_ptr<Connection> connection;
+    std::vector<uint8_t> data;
+
+    void run() override {
+      auto in_buffer =
+          std::make_shared<TMemoryBuffer>(data.data(), uint32_t(data.size()));
+      auto out_buffer = std::make_shared<TMemoryBuffer>();
+      try {
+        processor->process(
+            std::make_shared<TBinaryProtocol>(in_buffer),
+            std::make_shared<TBinaryProtocol>(
+                std::make_shared<TFramedTransport>(out_buffer)),
+            nullptr);
+      } catch (const std::exception& e) {
+        // The request is malformed: discard any partial response.
+        out_buffer->resetBuffer();
+        write_exception(out_buffer, e.what());
+      }
+      // Oneway requests have no response.
+      uint8_t* buf;
+      uint32_t len;
+      out_buffer->getBuffer(&buf, &len);
+      if (len > 0) connection->write(buf, len);
+    }
+  };
+
+  std::shared_ptr<TProcessor> _processor;
+  std::shared_ptr<TServerTransport> _server_socket;
+  std::shared_ptr<ThreadManager> _thread_manager;
+  std::atomic<bool> _stopped;
+  std::vector<std::shared_ptr<Connection>> _connections;
+
+  void serve_connection(std::shared_ptr<Connection> connection) {
+    try {
+      while (true) {
+        uint32_t frame_len;
+        connection->socket->readAll(reinterpret_cast<uint8_t*>(&frame_len), 4);
+        frame_len = ntohl(frame_len);
+        if (frame_len > 256 * 1024 * 1024)
+          throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                    "Frame too large");
+        auto request = std::make_shared<Request>();
+        request->processor = _processor;
+        request->connection = connection;
+        request->data.resize(frame_len);
+        connection->socket->readAll(request->data.data(), frame_len);
+        _thread_manager->add(request);
+      }
+    } catch (const std::exception&) {
+      // The client closed the connection, the connection was shut down, or
+      // its data is corrupted. Requests in progress fail to write their
+      // responses once the socket is closed.
+    }
+    {
+      std::unique_lock<std::mutex> lock(connection->socket_mutex);
+      connection->socket->close();
+    }
+    connection->done = true;
+  }
+
+  // Joins the reading threads of closed connections.
+  void reap_connections() {
+    auto it = _connections.begin();
+    while (it != _connections.end()) {
+      if ((*it)->done) {
+        (*it)->reader.join();
+        it = _connections.erase(it);
+      } else {
+        it++;
+      }
+    }
+  }
+
+ public:
+  PipelinedServer(std::shared_ptr<TProcessor> processor,
+                  std::shared_ptr<TServerTransport> server_socket,
+                  std::shared_ptr<ThreadManager> thread_manager)
+      : TServer(processor) {
+    _processor = processor;
+    _server_socket = server_socket;
+    _thread_manager = thread_manager;
+    _stopped = false;
+  }
+
+  /* Serves connections until stopped, and then shuts them down and waits for
+   * their reading threads.
+   */
+  void serve() override {
+    _server_socket->listen();
+    while (!_stopped) {
+      std::shared_ptr<TTransport> socket;
+      try {
+        socket = _server_socket->accept();
+      } catch (const TTransportException&) {
+        continue;
+      }
+      reap_connections();
+      auto connection = std::make_shared<Connection>();
+      connection->socket = socket;
+      connection->done = false;
+      connection->reader =
+          std::thread(&PipelinedServer::serve_connection, this, connection);
+      _connections.push_back(connection);
+    }
+    _server_socket->close();
+    for (auto& connection : _connections) {
+      std::unique_lock<std::mutex> lock(connection->socket_mutex);
+      connection->shut_down();
+    }
+    for (auto& connection : _connections) connection->reader.join();
+    _connections.clear();
+  }
+
+  void stop() override {
+    _stopped = true;
+    _server_socket->interrupt();
+  }
+};
+
+/* Builds a Thrift server running processors created by the given factory.
+ * Server modes:
+ *   - "threaded": one thread per connection (TThreadedServer). `threads`
+ *     limits the number of concurrent connections (0 means unlimited).
+ *   - "threadpool": a fixed pool of `threads` workers (TThreadPoolServer).
+ *     Each worker serves one connection at a time, so `threads` must be at
+ *     least the number of persistent connections opened by clients.
+ *   - "nonblocking": `io_threads` event loops that read requests from any
+ *     number of connections and hand them to a pool of `threads` workers
+ *     (TNonblockingServer). Clients must use the framed transport.
+ *   - "pipelined": one thread per connection that reads requests and hands
+ *     them to a pool of `threads` workers, without waiting for responses to
+ *     be written (PipelinedServer). Clients must use the framed transport.
+ *   - "sharded": one TThreadedServer per CPU of `numa_node` (or per CPU the
+ *     process may run on, if `numa_node` is negative), each with its own
+ *     processor (see ShardedServer). `threads` limits the number of concurrent
+ *     connections of each shard. Sizes and limits set by the service (e.g., of
+ *     connection pools and of the admission controller) are per shard.
+ * In "threadpool", "nonblocking", and "pipelined" modes, `threads` = 0 sizes
+ * the worker pool to the number of CPU cores.
+ */
+std::shared_ptr<TServer> build_server(
+    const std::string& server_mode,
+    std::function<std::shared_ptr<TProcessor>()> processor_factory,
+    const std::string& host, const int port, const int threads,
+    const int io_threads, const int accept_backlog, const int numa_node) {
+  // Reject unknown modes before creating the processor, which opens
+  // connection pools, and worker threads.
+  const std::vector<std::string> server_modes = {
+      "threaded", "threadpool", "nonblocking", "pipelined", "sharded"};
+  if (std::find(server_modes.begin(), server_modes.end(), server_mode) ==
+      server_modes.end())
+    throw std::invalid_argument("Invalid server mode: " + server_mode);
+
+  if (server_mode == "sharded")
+    return std::make_shared<ShardedServer>(processor_factory, host, port,
+                                           threads, accept_backlog,
+                                           get_cpus(numa_node));
+
+  auto processor = processor_factory();
+  if (server_mode == "threaded") {
+    auto socket = std::make_shared<TServerSocket>(host, port);
+    if (accept_backlog > 0) socket->setAcceptBacklog(accept_backlog);
+    auto server = std::make_shared<TThreadedServer>(
+        processor, socket, std::make_shared<TBufferedTransportFactory>(),
+        std::make_shared<TBinaryProtocolFactory>());
+    if (threads > 0) server->setConcurrentClientLimit(threads);
+    return server;
+  }
+
+  // Create a fixed-size pool of worker threads.
+  int workers = threads;
+  if (workers <= 0) workers = std::max(1u, std::thread::hardware_concurrency());
+  auto thread_manager = ThreadManager::newSimpleThreadManager(workers);
+  thread_manager->threadFactory(std::make_shared<ThreadFactory>());
+  thread_manager->start();
+
+  if (server_mode == "threadpool") {
+    auto socket = std::make_shared<TServerSocket>(host, port);
+    if (accept_backlog > 0) socket->setAcceptBacklog(accept_backlog);
+    return std::make_shared<TThreadPoolServer>(
+        processor, socket, std::make_shared<TBufferedTransportFactory>(),
+        std::make_shared<TBinaryProtocolFactory>(), thread_manager);
+  }
+  if (server_mode == "nonblocking") {
+    auto socket = std::make_shared<TNonblockingServerSocket>(host, port);
+    if (accept_backlog > 0) socket->setAcceptBacklog(accept_backlog);
+    auto server = std::make_shared<TNonblockingServer>(
+        processor, std::make_shared<TBinaryProtocolFactory>(), socket,
+        thread_manager);
+    server->setNumIOThreads(std::max(1, io_threads));
+    return server;
+  }
+  auto socket = std::make_shared<TServerSocket>(host, port);
+  if (accept_backlog > 0) socket->setAcceptBacklog(accept_backlog);
+  return std::make_shared<PipelinedServer>(processor, socket, thread_manager);
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include <chrono>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 
 template <typename U>
@@ -34,4 +35,19 @@ void VOID_RPC_WRAPPER(std::function<void()> rpc,
     logger->info((logline + std::string(" lat={}")).c_str(), latency.count());
 }
 
+/* Returns the logger with the given name, creating it if it does not exist
+ * yet. Loggers are shared by all handlers of a process (e.g., by all shards of
+ * a sharded server).
+ */
+std::shared_ptr<spdlog::logger> get_logger(const std::string& name,
+                                           const std::string& filepath) {
+  static std::mutex mutex;
+  std::unique_lock<std::mutex> lock(mutex);
+  auto logger = spdlog::get(name);
+  if (logger) return logger;
+  logger = spdlog::basic_logger_mt(name, filepath);
+  logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+  return logger;
+}
+
 #endif
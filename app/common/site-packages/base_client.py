@@ -9,12 +9,16 @@ from thrift.protocol import TBinaryProtocol
 class BaseClient:
 
   def __init__(self, thrift_service_client_cls, ip_address, port, timeout,
-               connection_pool):
+               connection_pool, framed):
     self._ip_address = ip_address
     self._port = port
     self._socket = TSocket.TSocket(ip_address, port)
     self._socket.setTimeout(timeout)
-    self._transport = TTransport.TBufferedTransport(self._socket)
+    # Servers in nonblocking mode only accept the framed transport.
+    if framed:
+      self._transport = TTransport.TFramedTransport(self._socket)
+    else:
+      self._transport = TTransport.TBufferedTransport(self._socket)
     self._protocol = TBinaryProtocol.TBinaryProtocol(self._transport)
     self._tclient = thrift_service_client_cls(self._protocol)
     self._transport.open()
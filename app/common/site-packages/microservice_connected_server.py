@@ -43,29 +43,34 @@ class MicroserviceConnectedServer:
         backend_conf["account"]["service"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, rpc_conn_logger)
+        microservice_connection_pool_allow_ephemeral,
+        backend_conf["account"].get("transport") == "framed", rpc_conn_logger)
     self._follow_cp = MicroserviceConnectionPool(
         local_service_name, "follow", FollowClient,
         backend_conf["follow"]["service"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, rpc_conn_logger)
+        microservice_connection_pool_allow_ephemeral,
+        backend_conf["follow"].get("transport") == "framed", rpc_conn_logger)
     self._like_cp = MicroserviceConnectionPool(
         local_service_name, "like", LikeClient, backend_conf["like"]["service"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, rpc_conn_logger)
+        microservice_connection_pool_allow_ephemeral,
+        backend_conf["like"].get("transport") == "framed", rpc_conn_logger)
     self._post_cp = MicroserviceConnectionPool(
         local_service_name, "post", PostClient, backend_conf["post"]["service"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, rpc_conn_logger)
+        microservice_connection_pool_allow_ephemeral,
+        backend_conf["post"].get("transport") == "framed", rpc_conn_logger)
     self._trending_cp = MicroserviceConnectionPool(
         local_service_name, "trending", TrendingClient,
         backend_conf["trending"]["service"],
         microservice_connection_pool_min_size,
         microservice_connection_pool_max_size,
-        microservice_connection_pool_allow_ephemeral, rpc_conn_logger)
+        microservice_connection_pool_allow_ephemeral,
+        backend_conf["trending"].get("transport") == "framed", rpc_conn_logger)
 
   # Account RPCs
   def authenticate_user(self, request_metadata, username, password):
@@ -128,6 +133,16 @@ class MicroserviceConnectedServer:
                              limit=limit,
                              offset=offset)
 
+  def list_accounts_page(self, request_metadata, query, limit, cursor):
+    with self._account_cp.get_client() as account_client:
+      return RPC_WRAPPER(self._rpc_call_logger,
+                         "rs=account rf=list_accounts_page ls=apigateway")(
+                             account_client.list_accounts_page,
+                             request_metadata=request_metadata,
+                             query=query,
+                             limit=limit,
+                             cursor=cursor)
+
   # Follow RPCs
   def follow_account(self, request_metadata, account_id):
     with self._follow_cp.get_client() as follow_client:
@@ -163,6 +178,16 @@ class MicroserviceConnectedServer:
                              limit=limit,
                              offset=offset)
 
+  def list_follows_page(self, request_metadata, query, limit, cursor):
+    with self._follow_cp.get_client() as follow_client:
+      return RPC_WRAPPER(self._rpc_call_logger,
+                         "rs=follow rf=list_follows_page ls=apigateway")(
+                             follow_client.list_follows_page,
+                             request_metadata=request_metadata,
+                             query=query,
+                             limit=limit,
+                             cursor=cursor)
+
   # Like RPCs
   def like_post(self, request_metadata, post_id):
     with self._like_cp.get_client() as like_client:
@@ -198,6 +223,16 @@ class MicroserviceConnectedServer:
                              limit=limit,
                              offset=offset)
 
+  def list_likes_page(self, request_metadata, query, limit, cursor):
+    with self._like_cp.get_client() as like_client:
+      return RPC_WRAPPER(self._rpc_call_logger,
+                         "rs=like rf=list_likes_page ls=apigateway")(
+                             like_client.list_likes_page,
+                             request_metadata=request_metadata,
+                             query=query,
+                             limit=limit,
+                             cursor=cursor)
+
   # Post RPCs
   def create_post(self, request_metadata, text):
     with self._post_cp.get_client() as post_client:
@@ -233,6 +268,16 @@ class MicroserviceConnectedServer:
                              limit=limit,
                              offset=offset)
 
+  def list_posts_page(self, request_metadata, query, limit, cursor):
+    with self._post_cp.get_client() as post_client:
+      return RPC_WRAPPER(self._rpc_call_logger,
+                         "rs=post rf=list_posts_page ls=apigateway")(
+                             post_client.list_posts_page,
+                             request_metadata=request_metadata,
+                             query=query,
+                             limit=limit,
+                             cursor=cursor)
+
   # Trending RPCs
   def fetch_trending_hashtags(self, request_metadata, limit):
     with self._trending_cp.get_client() as trending_client:
@@ -11,7 +11,7 @@ class MicroserviceConnectionPool:
 
   def __init__(self, local_service_name, remote_service_name,
                remote_service_client_class, servers, pool_min_size,
-               pool_max_size, allow_ephemeral, rpc_conn_logger):
+               pool_max_size, allow_ephemeral, framed, rpc_conn_logger):
     self._local_service_name = local_service_name
     self._remote_service_name = remote_service_name
     self._remote_service_client_class = remote_service_client_class
@@ -19,6 +19,7 @@ class MicroserviceConnectionPool:
     self._pool_min_size = pool_min_size
     self._pool_max_size = pool_max_size
     self._allow_ephemeral = allow_ephemeral
+    self._framed = framed
     self._rpc_conn_logger = rpc_conn_logger
     self._pool_current_size = 0
     self._backlog_len = 0
@@ -58,7 +59,8 @@ class MicroserviceConnectionPool:
     if conn is None:
       conn = self._remote_service_client_class(server.split(':')[0],
                                                int(server.split(':')[1]),
-                                               connection_pool=self)
+                                               connection_pool=self,
+                                               framed=self._framed)
     latency = time.monotonic() - start_time
     if self._rpc_conn_logger:
       self._rpc_conn_logger.info(
@@ -4,6 +4,23 @@
 namespace cpp gen
 namespace py gen
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Enums
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+/* How important a request is. Overloaded services reject sheddable requests
+ * first and critical requests last.
+ */
+enum TRequestCriticality {
+  CRITICAL = 0,
+  DEFAULT = 1,
+  SHEDDABLE = 2
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -14,12 +31,15 @@ namespace py gen
 
 struct TRequestMetadata {
   1: required string id;          // unique request id.
-  2: optional i32 requester_id;   // id of the account making the request.
+  2: optional i64 requester_id;   // id of the account making the request.
+  3: optional i64 deadline;       // time (ms since epoch) to abandon it by.
+  4: optional TRequestCriticality criticality;  // DEFAULT if not set.
+  5: optional i64 last_write;     // time (ms since epoch) of its last write.
 }
 
 struct TAccount {
   // Standard
-  1: required i32 id;
+  1: required i64 id;
   2: required i32 created_at;
   3: required bool active;
   4: required string username;
@@ -39,12 +59,17 @@ struct TAccountQuery {
   1: optional string username;
 }
 
+struct TAccountPage {
+  1: required list<TAccount> accounts;
+  2: optional string next_cursor;  // cursor of the next page, if any.
+}
+
 struct TFollow {
   // Standard
-  1: required i32 id;
+  1: required i64 id;
   2: required i32 created_at;
-  3: required i32 follower_id;
-  4: required i32 followee_id;
+  3: required i64 follower_id;
+  4: required i64 followee_id;
 
   // Expanded
   5: optional TAccount follower;
@@ -52,17 +77,22 @@ struct TFollow {
 }
 
 struct TFollowQuery {
-  1: optional i32 follower_id;
-  2: optional i32 followee_id;
+  1: optional i64 follower_id;
+  2: optional i64 followee_id;
+}
+
+struct TFollowPage {
+  1: required list<TFollow> follows;
+  2: optional string next_cursor;  // cursor of the next page, if any.
 }
 
 struct TPost {
   // Standard
-  1: required i32 id;
+  1: required i64 id;
   2: required i32 created_at;
   3: required bool active;
   4: required string text;
-  5: required i32 author_id;
+  5: required i64 author_id;
 
   // Expanded
   6: optional TAccount author;
@@ -70,15 +100,20 @@ struct TPost {
 }
 
 struct TPostQuery {
-  1: optional i32 author_id;
+  1: optional i64 author_id;
+}
+
+struct TPostPage {
+  1: required list<TPost> posts;
+  2: optional string next_cursor;  // cursor of the next page, if any.
 }
 
 struct TLike {
   // Standard
-  1: required i32 id;
+  1: required i64 id;
   2: required i32 created_at;
-  3: required i32 account_id;
-  4: required i32 post_id;
+  3: required i64 account_id;
+  4: required i64 post_id;
 
   // Expanded
   5: optional TAccount account;
@@ -86,22 +121,32 @@ struct TLike {
 }
 
 struct TLikeQuery {
-  1: optional i32 account_id;
-  2: optional i32 post_id;
+  1: optional i64 account_id;
+  2: optional i64 post_id;
+}
+
+struct TLikePage {
+  1: required list<TLike> likes;
+  2: optional string next_cursor;  // cursor of the next page, if any.
 }
 
 struct TUniquepair {
-  1: required i32 id;
+  1: required i64 id;
   2: required i32 created_at;
   3: required string domain;
-  4: required i32 first_elem;
-  5: required i32 second_elem;
+  4: required i64 first_elem;
+  5: required i64 second_elem;
 }
 
 struct TUniquepairQuery {
   1: required string domain;
-  2: optional i32 first_elem;
-  3: optional i32 second_elem;
+  2: optional i64 first_elem;
+  3: optional i64 second_elem;
+}
+
+struct TUniquepairPage {
+  1: required list<TUniquepair> uniquepairs;
+  2: optional string next_cursor;  // cursor of the next page, if any.
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -166,6 +211,12 @@ exception TUniquepairNotFoundException {
 exception TUniquepairAlreadyExistsException {
 }
 
+exception TServiceOverloadedException {
+}
+
+exception TInvalidCursorException {
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -185,7 +236,8 @@ service TAccountService {
   TAccount authenticate_user (1:TRequestMetadata request_metadata,
       2:string username, 3:string password)
       throws (1:TAccountInvalidCredentialsException e1,
-              2:TAccountDeactivatedException e2);
+              2:TAccountDeactivatedException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -200,7 +252,8 @@ service TAccountService {
       2:string username, 3:string password, 4:string first_name,
       5:string last_name)
       throws (1:TAccountInvalidAttributesException e1,
-              2:TAccountUsernameAlreadyExistsException e2);
+              2:TAccountUsernameAlreadyExistsException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -209,8 +262,9 @@ service TAccountService {
    *   The account (standard mode) matching the provided id.
    */
   TAccount retrieve_standard_account (1:TRequestMetadata request_metadata,
-      2:i32 account_id)
-      throws (1:TAccountNotFoundException e);
+      2:i64 account_id)
+      throws (1:TAccountNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -219,8 +273,9 @@ service TAccountService {
    *   The account (expanded mode) matching the provided id.
    */
   TAccount retrieve_expanded_account (1:TRequestMetadata request_metadata,
-      2:i32 account_id)
-      throws (1:TAccountNotFoundException e);
+      2:i64 account_id)
+      throws (1:TAccountNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -232,19 +287,21 @@ service TAccountService {
    *   The updated account (standard mode).
    */
   TAccount update_account (1:TRequestMetadata request_metadata,
-      2:i32 account_id, 3:string password, 4:string first_name,
+      2:i64 account_id, 3:string password, 4:string first_name,
       5:string last_name)
       throws (1:TAccountNotAuthorizedException e1,
               2:TAccountInvalidAttributesException e2,
-              3:TAccountNotFoundException e3);
+              3:TAccountNotFoundException e3,
+              4:TServiceOverloadedException e4);
 
   /* Params:
    *   1. request_metadata: request metadata.
    *   2. account_id: id of the account to be deleted.
    */
-  void delete_account (1:TRequestMetadata request_metadata, 2:i32 account_id)
+  void delete_account (1:TRequestMetadata request_metadata, 2:i64 account_id)
       throws (1:TAccountNotAuthorizedException e1,
-              2:TAccountNotFoundException e2);
+              2:TAccountNotFoundException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -255,7 +312,23 @@ service TAccountService {
    *   A list of accounts (expanded mode) in reverse chronological order.
    */
   list<TAccount> list_accounts (1:TRequestMetadata request_metadata,
-      2:TAccountQuery query, 3:i32 limit, 4:i32 offset);
+      2:TAccountQuery query, 3:i32 limit, 4:i32 offset)
+      throws (1:TServiceOverloadedException e1);
+
+  /* Params:
+   *   1. request_metadata: request metadata.
+   *   2. query: query parameters to fetch results.
+   *   3. limit: max number of results to be fetched.
+   *   4. cursor: cursor returned with the previous page, or an empty string
+   *      for the first page.
+   * Returns:
+   *   A page of accounts (expanded mode) in reverse chronological order, with
+   *   the cursor of the next page unless it is the last one.
+   */
+  TAccountPage list_accounts_page (1:TRequestMetadata request_metadata,
+      2:TAccountQuery query, 3:i32 limit, 4:string cursor)
+      throws (1:TInvalidCursorException e1,
+              2:TServiceOverloadedException e2);
 }
 
 service TFollowService {
@@ -265,9 +338,10 @@ service TFollowService {
    * Returns:
    *   The newly created follow (standard mode).
    */
-  TFollow follow_account (1:TRequestMetadata request_metadata, 2:i32 account_id)
+  TFollow follow_account (1:TRequestMetadata request_metadata, 2:i64 account_id)
       throws (1:TFollowAlreadyExistsException e1,
-              2:TFollowInvalidAttributesException e2);
+              2:TFollowInvalidAttributesException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -276,8 +350,9 @@ service TFollowService {
    *   The follow (standard mode) matching the provided id.
    */
   TFollow retrieve_standard_follow (1:TRequestMetadata request_metadata,
-      2:i32 follow_id)
-      throws (1:TFollowNotFoundException e);
+      2:i64 follow_id)
+      throws (1:TFollowNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -286,17 +361,19 @@ service TFollowService {
    *   The follow (expanded mode) matching the provided id.
    */
   TFollow retrieve_expanded_follow (1:TRequestMetadata request_metadata,
-      2:i32 follow_id)
+      2:i64 follow_id)
       throws (1:TFollowNotFoundException e1,
-              2:TAccountNotFoundException e2);
+              2:TAccountNotFoundException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
    *   2. follow_id: id of the follow to be deleted.
    */
-  void delete_follow (1:TRequestMetadata request_metadata, 2:i32 follow_id)
+  void delete_follow (1:TRequestMetadata request_metadata, 2:i64 follow_id)
       throws (1:TFollowNotFoundException e1,
-              2:TFollowNotAuthorizedException e2);
+              2:TFollowNotAuthorizedException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -308,7 +385,24 @@ service TFollowService {
    */
   list<TFollow> list_follows (1:TRequestMetadata request_metadata,
       2:TFollowQuery query, 3:i32 limit, 4:i32 offset)
-      throws (1:TAccountNotFoundException e);
+      throws (1:TAccountNotFoundException e,
+              2:TServiceOverloadedException e2);
+
+  /* Params:
+   *   1. request_metadata: request metadata.
+   *   2. query: query parameters to fetch results.
+   *   3. limit: max number of results to be fetched.
+   *   4. cursor: cursor returned with the previous page, or an empty string
+   *      for the first page.
+   * Returns:
+   *   A page of follows (expanded mode) in reverse chronological order, with
+   *   the cursor of the next page unless it is the last one.
+   */
+  TFollowPage list_follows_page (1:TRequestMetadata request_metadata,
+      2:TFollowQuery query, 3:i32 limit, 4:string cursor)
+      throws (1:TAccountNotFoundException e1,
+              2:TInvalidCursorException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -317,8 +411,9 @@ service TFollowService {
    * Returns:
    *   True if follower follows followee. False, otherwise.
    */
-  bool check_follow (1:TRequestMetadata request_metadata, 2:i32 follower_id,
-      3:i32 followee_id);
+  bool check_follow (1:TRequestMetadata request_metadata, 2:i64 follower_id,
+      3:i64 followee_id)
+      throws (1:TServiceOverloadedException e1);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -326,7 +421,8 @@ service TFollowService {
    * Returns:
    *   The number of followers of the provided account.
    */
-  i32 count_followers (1:TRequestMetadata request_metadata, 2:i32 account_id);
+  i32 count_followers (1:TRequestMetadata request_metadata, 2:i64 account_id)
+      throws (1:TServiceOverloadedException e1);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -334,7 +430,8 @@ service TFollowService {
    * Returns:
    *   The number of followees of the provided account.
    */
-  i32 count_followees (1:TRequestMetadata request_metadata, 2:i32 account_id);
+  i32 count_followees (1:TRequestMetadata request_metadata, 2:i64 account_id)
+      throws (1:TServiceOverloadedException e1);
 }
 
 service TLikeService {
@@ -344,8 +441,9 @@ service TLikeService {
    * Returns:
    *   The newly created like (standard mode).
    */
-  TLike like_post (1:TRequestMetadata request_metadata, 2:i32 post_id)
-      throws (1:TLikeAlreadyExistsException e);
+  TLike like_post (1:TRequestMetadata request_metadata, 2:i64 post_id)
+      throws (1:TLikeAlreadyExistsException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -354,8 +452,9 @@ service TLikeService {
    *   The like (standard mode) matching the provided id.
    */
   TLike retrieve_standard_like (1:TRequestMetadata request_metadata,
-      2:i32 like_id)
-      throws (1:TLikeNotFoundException e);
+      2:i64 like_id)
+      throws (1:TLikeNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -364,18 +463,20 @@ service TLikeService {
    *   The like (expanded mode) matching the provided id.
    */
   TLike retrieve_expanded_like (1:TRequestMetadata request_metadata,
-      2:i32 like_id)
+      2:i64 like_id)
       throws (1:TLikeNotFoundException e1,
               2:TAccountNotFoundException e2,
-              3:TPostNotFoundException e3);
+              3:TPostNotFoundException e3,
+              4:TServiceOverloadedException e4);
 
   /* Params:
    *   1. request_metadata: request metadata.
    *   2. like_id: id of the like to be deleted.
    */
-  void delete_like (1:TRequestMetadata request_metadata, 2:i32 like_id)
+  void delete_like (1:TRequestMetadata request_metadata, 2:i64 like_id)
       throws (1:TLikeNotFoundException e1,
-              2:TLikeNotAuthorizedException e2);
+              2:TLikeNotAuthorizedException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -388,7 +489,25 @@ service TLikeService {
   list<TLike> list_likes (1:TRequestMetadata request_metadata,
       2:TLikeQuery query, 3:i32 limit, 4:i32 offset)
       throws (1:TAccountNotFoundException e1,
-              2:TPostNotFoundException e2);
+              2:TPostNotFoundException e2,
+              3:TServiceOverloadedException e3);
+
+  /* Params:
+   *   1. request_metadata: request metadata.
+   *   2. query: query parameters to fetch results.
+   *   3. limit: max number of results to be fetched.
+   *   4. cursor: cursor returned with the previous page, or an empty string
+   *      for the first page.
+   * Returns:
+   *   A page of likes (expanded mode) in reverse chronological order, with
+   *   the cursor of the next page unless it is the last one.
+   */
+  TLikePage list_likes_page (1:TRequestMetadata request_metadata,
+      2:TLikeQuery query, 3:i32 limit, 4:string cursor)
+      throws (1:TAccountNotFoundException e1,
+              2:TPostNotFoundException e2,
+              3:TInvalidCursorException e3,
+              4:TServiceOverloadedException e4);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -397,7 +516,8 @@ service TLikeService {
    *   The number of likes by the provided account.
    */
   i32 count_likes_by_account (1:TRequestMetadata request_metadata,
-      2:i32 account_id);
+      2:i64 account_id)
+      throws (1:TServiceOverloadedException e1);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -405,7 +525,8 @@ service TLikeService {
    * Returns:
    *   The number of likes of the provided post.
    */
-  i32 count_likes_of_post (1:TRequestMetadata request_metadata, 2:i32 post_id);
+  i32 count_likes_of_post (1:TRequestMetadata request_metadata, 2:i64 post_id)
+      throws (1:TServiceOverloadedException e1);
 }
 
 service TPostService {
@@ -416,7 +537,8 @@ service TPostService {
    *   The newly created post (standard mode).
    */
   TPost create_post (1:TRequestMetadata request_metadata, 2:string text)
-      throws (1:TPostInvalidAttributesException e);
+      throws (1:TPostInvalidAttributesException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -425,8 +547,9 @@ service TPostService {
    *   The post (standard mode) matching the provided id.
    */
   TPost retrieve_standard_post (1:TRequestMetadata request_metadata,
-      2:i32 post_id)
-      throws (1:TPostNotFoundException e);
+      2:i64 post_id)
+      throws (1:TPostNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -435,17 +558,19 @@ service TPostService {
    *   The post (expanded mode) matching the provided id.
    */
   TPost retrieve_expanded_post (1:TRequestMetadata request_metadata,
-      2:i32 post_id)
+      2:i64 post_id)
       throws (1:TPostNotFoundException e1,
-              2:TAccountNotFoundException e2);
+              2:TAccountNotFoundException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
    *   2. post_id: id of the post to be deleted.
    */
-  void delete_post (1:TRequestMetadata request_metadata, 2:i32 post_id)
+  void delete_post (1:TRequestMetadata request_metadata, 2:i64 post_id)
       throws (1:TPostNotFoundException e1,
-              2:TPostNotAuthorizedException e2);
+              2:TPostNotAuthorizedException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -457,7 +582,24 @@ service TPostService {
    */
   list<TPost> list_posts (1:TRequestMetadata request_metadata,
       2:TPostQuery query, 3:i32 limit, 4:i32 offset)
-      throws (1:TAccountNotFoundException e);
+      throws (1:TAccountNotFoundException e,
+              2:TServiceOverloadedException e2);
+
+  /* Params:
+   *   1. request_metadata: request metadata.
+   *   2. query: query parameters to fetch results.
+   *   3. limit: max number of results to be fetched.
+   *   4. cursor: cursor returned with the previous page, or an empty string
+   *      for the first page.
+   * Returns:
+   *   A page of posts (expanded mode) in reverse chronological order, with
+   *   the cursor of the next page unless it is the last one.
+   */
+  TPostPage list_posts_page (1:TRequestMetadata request_metadata,
+      2:TPostQuery query, 3:i32 limit, 4:string cursor)
+      throws (1:TAccountNotFoundException e1,
+              2:TInvalidCursorException e2,
+              3:TServiceOverloadedException e3);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -466,7 +608,8 @@ service TPostService {
    *   The number of posts written by the provided author account.
    */
   i32 count_posts_by_author (1:TRequestMetadata request_metadata,
-      2:i32 author_id);
+      2:i64 author_id)
+      throws (1:TServiceOverloadedException e1);
 }
 
 service TUniquepairService {
@@ -476,8 +619,9 @@ service TUniquepairService {
    * Returns:
    *   The unique pair matching the provided id.
    */
-  TUniquepair get (1:TRequestMetadata request_metadata, 2:i32 uniquepair_id)
-      throws (1:TUniquepairNotFoundException e);
+  TUniquepair get (1:TRequestMetadata request_metadata, 2:i64 uniquepair_id)
+      throws (1:TUniquepairNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -488,15 +632,17 @@ service TUniquepairService {
    *   The newly created unique pair.
    */
   TUniquepair add (1:TRequestMetadata request_metadata, 2:string domain,
-      3:i32 first_elem, 4:i32 second_elem)
-      throws (1:TUniquepairAlreadyExistsException e);
+      3:i64 first_elem, 4:i64 second_elem)
+      throws (1:TUniquepairAlreadyExistsException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
    *   2. uniquepair_id: id of the unique pair to be removed.
    */
-  void remove (1:TRequestMetadata request_metadata, 2:i32 uniquepair_id)
-      throws (1:TUniquepairNotFoundException e);
+  void remove (1:TRequestMetadata request_metadata, 2:i64 uniquepair_id)
+      throws (1:TUniquepairNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -507,8 +653,9 @@ service TUniquepairService {
    *   True if the unique pair is found. False, otherwise.
    */
   bool find (1:TRequestMetadata request_metadata, 2:string domain,
-      3:i32 first_elem, 4:i32 second_elem)
-      throws (1:TUniquepairNotFoundException e);
+      3:i64 first_elem, 4:i64 second_elem)
+      throws (1:TUniquepairNotFoundException e,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -519,7 +666,23 @@ service TUniquepairService {
    *   A list of unique pairs in reverse chronological order.
    */
   list<TUniquepair> fetch (1:TRequestMetadata request_metadata,
-      2:TUniquepairQuery query, 3:i32 limit, 4:i32 offset);
+      2:TUniquepairQuery query, 3:i32 limit, 4:i32 offset)
+      throws (1:TServiceOverloadedException e1);
+
+  /* Params:
+   *   1. request_metadata: request metadata.
+   *   2. query: query parameters to fetch results.
+   *   3. limit: max number of results to be fetched.
+   *   4. cursor: cursor returned with the previous page, or an empty string
+   *      for the first page.
+   * Returns:
+   *   A page of unique pairs in reverse chronological order, with the cursor
+   *   of the next page unless it is the last one.
+   */
+  TUniquepairPage fetch_page (1:TRequestMetadata request_metadata,
+      2:TUniquepairQuery query, 3:i32 limit, 4:string cursor)
+      throws (1:TInvalidCursorException e1,
+              2:TServiceOverloadedException e2);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -527,7 +690,8 @@ service TUniquepairService {
    * Returns:
    *   The number of unique pairs.
    */
-  i32 count (1:TRequestMetadata request_metadata, 2:TUniquepairQuery query);
+  i32 count (1:TRequestMetadata request_metadata, 2:TUniquepairQuery query)
+      throws (1:TServiceOverloadedException e1);
 }
 
 service TTrendingService {
@@ -535,7 +699,8 @@ service TTrendingService {
    *   1. request_metadata: request metadata.
    *   2. text: text of the post to be processed.
    */
-  void process_post (1:TRequestMetadata request_metadata, 2:string text);
+  void process_post (1:TRequestMetadata request_metadata, 2:string text)
+      throws (1:TServiceOverloadedException e1);
 
   /* Params:
    *   1. request_metadata: request metadata.
@@ -544,7 +709,8 @@ service TTrendingService {
    *   A list of trending hashtags.
    */
   list<string> fetch_trending_hashtags (1:TRequestMetadata request_metadata,
-      2:i32 limit);
+      2:i32 limit)
+      throws (1:TServiceOverloadedException e1);
 }
 
 service TWordfilterService {
@@ -554,5 +720,6 @@ service TWordfilterService {
    * Returns:
    *   True if the word is valid. False, otherwise.
    */
-  bool is_valid_word (1:TRequestMetadata request_metadata, 2:string word);
+  bool is_valid_word (1:TRequestMetadata request_metadata, 2:string word)
+      throws (1:TServiceOverloadedException e1);
 }
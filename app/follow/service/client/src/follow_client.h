@@ -9,35 +9,38 @@
 using namespace gen;
 
 namespace follow_service {
-class Client : public BaseClient<TFollowServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TFollowServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TFollowServiceClient>(ip_address, port, conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TFollowServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   TFollow follow_account(const TRequestMetadata& request_metadata,
-                         const int32_t account_id) {
+                         const int64_t account_id) {
     TFollow _return;
     _client->follow_account(_return, request_metadata, account_id);
     return _return;
   }
 
   TFollow retrieve_standard_follow(const TRequestMetadata& request_metadata,
-                                   const int32_t follow_id) {
+                                   const int64_t follow_id) {
     TFollow _return;
     _client->retrieve_standard_follow(_return, request_metadata, follow_id);
     return _return;
   }
 
   TFollow retrieve_expanded_follow(const TRequestMetadata& request_metadata,
-                                   const int32_t follow_id) {
+                                   const int64_t follow_id) {
     TFollow _return;
     _client->retrieve_expanded_follow(_return, request_metadata, follow_id);
     return _return;
   }
 
   void delete_follow(const TRequestMetadata& request_metadata,
-                     const int32_t follow_id) {
+                     const int64_t follow_id) {
     _client->delete_follow(request_metadata, follow_id);
   }
 
@@ -49,18 +52,27 @@ class Client : public BaseClient<TFollowServiceClient> {
     return _return;
   }
 
+  TFollowPage list_follows_page(const TRequestMetadata& request_metadata,
+                                const TFollowQuery& query,
+                                const int32_t limit,
+                                const std::string& cursor) {
+    TFollowPage _return;
+    _client->list_follows_page(_return, request_metadata, query, limit, cursor);
+    return _return;
+  }
+
   bool check_follow(const TRequestMetadata& request_metadata,
-                    const int32_t follower_id, const int32_t followee_id) {
+                    const int64_t follower_id, const int64_t followee_id) {
     return _client->check_follow(request_metadata, follower_id, followee_id);
   }
 
   int32_t count_followers(const TRequestMetadata& request_metadata,
-                          const int32_t account_id) {
+                          const int64_t account_id) {
     return _client->count_followers(request_metadata, account_id);
   }
 
   int32_t count_followees(const TRequestMetadata& request_metadata,
-                          const int32_t account_id) {
+                          const int64_t account_id) {
     return _client->count_followees(request_metadata, account_id);
   }
 };
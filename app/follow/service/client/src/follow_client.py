@@ -7,9 +7,14 @@ from buzzblog.base_client import BaseClient
 
 class Client(BaseClient):
 
-  def __init__(self, ip_address, port, timeout=30000, connection_pool=None):
+  def __init__(self,
+               ip_address,
+               port,
+               timeout=30000,
+               connection_pool=None,
+               framed=False):
     super().__init__(TFollowService.Client, ip_address, port, timeout,
-                     connection_pool)
+                     connection_pool, framed)
 
   def follow_account(self, request_metadata, account_id):
     return self._tclient.follow_account(request_metadata=request_metadata,
@@ -33,6 +38,12 @@ class Client(BaseClient):
                                       limit=limit,
                                       offset=offset)
 
+  def list_follows_page(self, request_metadata, query, limit, cursor):
+    return self._tclient.list_follows_page(request_metadata=request_metadata,
+                                           query=query,
+                                           limit=limit,
+                                           cursor=cursor)
+
   def check_follow(self, request_metadata, follower_id, followee_id):
     return self._tclient.check_follow(request_metadata=request_metadata,
                                       follower_id=follower_id,
@@ -1,16 +1,16 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
 #include <buzzblog/gen/TFollowService.h>
 #include <buzzblog/microservice_connected_server.h>
+#include <buzzblog/thrift_server.h>
 #include <buzzblog/utils.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
 #include <cxxopts.hpp>
-#include <future>
 #include <string>
 
 using namespace apache::thrift;
@@ -24,20 +24,75 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
                               public TFollowServiceIf {
  private:
   std::shared_ptr<spdlog::logger> _rpc_logger;
+  // Max number of items (e.g., follows of a list) expanded at once.
+  int _max_parallelism;
+
+  // Retrieves the follower and followee of a follow concurrently.
+  Task<TFollow> expand_follow(const TRequestMetadata& request_metadata,
+                              TFollow follow, const std::string lf) {
+    auto accounts = co_await when_all(
+        CO_RPC_WRAPPER<TAccount>(
+            co_rpc_retrieve_standard_account(request_metadata,
+                                             follow.follower_id),
+            _rpc_logger,
+            "ls=follow lf=" + lf +
+                " rs=account rf=retrieve_standard_account rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<TAccount>(
+            co_rpc_retrieve_standard_account(request_metadata,
+                                             follow.followee_id),
+            _rpc_logger,
+            "ls=follow lf=" + lf +
+                " rs=account rf=retrieve_standard_account rid=" +
+                request_metadata.id));
+
+    // Build follow (expanded mode).
+    follow.__set_follower(std::get<0>(accounts));
+    follow.__set_followee(std::get<1>(accounts));
+    co_return follow;
+  }
+
+  // Returns the query of the unique pairs of the follows matching a query.
+  static TUniquepairQuery build_uniquepair_query(const TFollowQuery& query) {
+    TUniquepairQuery uniquepair_query;
+    uniquepair_query.__set_domain("follow");
+    if (query.__isset.follower_id)
+      uniquepair_query.__set_first_elem(query.follower_id);
+    if (query.__isset.followee_id)
+      uniquepair_query.__set_second_elem(query.followee_id);
+    return uniquepair_query;
+  }
+
+  // Builds listed follows (expanded mode) from their unique pairs, retrieving
+  // their followers and followees a bounded number of follows at a time.
+  std::vector<TFollow> expand_listed_follows(
+      const TRequestMetadata& request_metadata,
+      const std::vector<TUniquepair>& uniquepairs, const std::string lf) {
+    std::vector<Task<TFollow>> follows;
+    for (const auto& uniquepair : uniquepairs) {
+      TFollow follow;
+      follow.id = uniquepair.id;
+      follow.created_at = uniquepair.created_at;
+      follow.follower_id = uniquepair.first_elem;
+      follow.followee_id = uniquepair.second_elem;
+      follows.push_back(expand_follow(request_metadata, follow, lf));
+    }
+    return sync_wait(when_all(std::move(follows), _max_parallelism));
+  }
 
  public:
   TFollowServiceHandler(const std::string& backend_filepath,
                         const int microservice_connection_pool_min_size,
                         const int microservice_connection_pool_max_size,
                         const int microservice_connection_pool_allow_ephemeral,
-                        const int logging)
+                        const int max_parallelism, const int logging)
       : MicroserviceConnectedServer(
             "follow", backend_filepath, microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
             microservice_connection_pool_allow_ephemeral != 0, logging) {
+    _max_parallelism = max_parallelism;
     if (logging) {
-      _rpc_logger = spdlog::basic_logger_mt("rpc_logger", "/tmp/rpc.log");
-      _rpc_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _rpc_logger = get_logger("rpc_logger", "/tmp/rpc.log");
     } else {
       _rpc_logger = nullptr;
     }
@@ -45,7 +100,9 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
 
   void follow_account(TFollow& _return,
                       const TRequestMetadata& request_metadata,
-                      const int32_t account_id) {
+                      const int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Validate attributes.
     if (request_metadata.requester_id == account_id)
       throw TFollowInvalidAttributesException();
@@ -74,7 +131,9 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_standard_follow(TFollow& _return,
                                 const TRequestMetadata& request_metadata,
-                                const int32_t follow_id) {
+                                const int64_t follow_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Get unique pair.
     TUniquepair uniquepair;
     try {
@@ -97,39 +156,20 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_expanded_follow(TFollow& _return,
                                 const TRequestMetadata& request_metadata,
-                                const int32_t follow_id) {
+                                const int64_t follow_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Retrieve standard follow.
     retrieve_standard_follow(_return, request_metadata, follow_id);
 
-    // Retrieve follower in a separate thread.
-    auto follower_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<TAccount>(
-          std::bind(&TFollowServiceHandler::rpc_retrieve_standard_account, this,
-                    std::ref(request_metadata), std::ref(_return.follower_id)),
-          _rpc_logger,
-          "ls=follow lf=retrieve_expanded_follow rs=account "
-          "rf=retrieve_standard_account rid=" +
-              request_metadata.id);
-    });
-
-    // Retrieve followee in a separate thread.
-    auto followee_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<TAccount>(
-          std::bind(&TFollowServiceHandler::rpc_retrieve_standard_account, this,
-                    std::ref(request_metadata), std::ref(_return.followee_id)),
-          _rpc_logger,
-          "ls=follow lf=retrieve_expanded_follow rs=account "
-          "rf=retrieve_standard_account rid=" +
-              request_metadata.id);
-    });
-
-    // Build follow (expanded mode).
-    _return.__set_follower(follower_future.get());
-    _return.__set_followee(followee_future.get());
+    // Retrieve follower and followee.
+    _return = sync_wait(
+        expand_follow(request_metadata, _return, "retrieve_expanded_follow"));
   }
 
   void delete_follow(const TRequestMetadata& request_metadata,
-                     const int32_t follow_id) {
+                     const int64_t follow_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
     {
       // Get unique pair.
       TUniquepair uniquepair;
@@ -166,15 +206,10 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
                     const TRequestMetadata& request_metadata,
                     const TFollowQuery& query, const int32_t limit,
                     const int32_t offset) {
-    // Build query struct.
-    TUniquepairQuery uniquepair_query;
-    uniquepair_query.__set_domain("follow");
-    if (query.__isset.follower_id)
-      uniquepair_query.__set_first_elem(query.follower_id);
-    if (query.__isset.followee_id)
-      uniquepair_query.__set_second_elem(query.followee_id);
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Fetch unique pairs.
+    auto uniquepair_query = build_uniquepair_query(query);
     auto uniquepairs = RPC_WRAPPER<std::vector<TUniquepair>>(
         std::bind(&TFollowServiceHandler::rpc_fetch, this,
                   std::ref(request_metadata), std::ref(uniquepair_query),
@@ -183,55 +218,35 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
         "ls=follow lf=list_follows rs=uniquepair rf=fetch rid=" +
             request_metadata.id);
 
-    // Retrieve followers in separate threads.
-    std::vector<std::future<TAccount>> follower_futures;
-    for (auto it : uniquepairs) {
-      follower_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<TAccount>(
-            std::bind(&TFollowServiceHandler::rpc_retrieve_standard_account,
-                      this, std::ref(request_metadata),
-                      std::ref(it.first_elem)),
-            _rpc_logger,
-            "ls=follow lf=list_follows rs=account rf=retrieve_standard_account "
-            "rid=" +
-                request_metadata.id);
-      }));
-    }
+    _return =
+        expand_listed_follows(request_metadata, uniquepairs, "list_follows");
+  }
 
-    // Retrieve followees in separate threads.
-    std::vector<std::future<TAccount>> followee_futures;
-    for (auto it : uniquepairs) {
-      followee_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<TAccount>(
-            std::bind(&TFollowServiceHandler::rpc_retrieve_standard_account,
-                      this, std::ref(request_metadata),
-                      std::ref(it.second_elem)),
-            _rpc_logger,
-            "ls=follow lf=list_follows rs=account rf=retrieve_standard_account "
-            "rid=" +
-                request_metadata.id);
-      }));
-    }
+  void list_follows_page(TFollowPage& _return,
+                         const TRequestMetadata& request_metadata,
+                         const TFollowQuery& query, const int32_t limit,
+                         const std::string& cursor) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
+    // Fetch a page of unique pairs. Follows are unique pairs, so their pages
+    // have the same cursors.
+    auto uniquepair_query = build_uniquepair_query(query);
+    auto page = RPC_WRAPPER<TUniquepairPage>(
+        std::bind(&TFollowServiceHandler::rpc_fetch_page, this,
+                  std::ref(request_metadata), std::ref(uniquepair_query),
+                  std::ref(limit), std::ref(cursor)),
+        _rpc_logger,
+        "ls=follow lf=list_follows_page rs=uniquepair rf=fetch_page rid=" +
+            request_metadata.id);
 
-    // Build follows.
-    for (auto i = 0; i < uniquepairs.size(); i++) {
-      auto uniquepair = uniquepairs[i];
-      auto follower = follower_futures[i].get();
-      auto followee = followee_futures[i].get();
-      // Build follow (expanded mode).
-      TFollow follow;
-      follow.id = uniquepair.id;
-      follow.created_at = uniquepair.created_at;
-      follow.follower_id = uniquepair.first_elem;
-      follow.followee_id = uniquepair.second_elem;
-      follow.__set_follower(follower);
-      follow.__set_followee(followee);
-      _return.push_back(follow);
-    }
+    _return.follows = expand_listed_follows(request_metadata, page.uniquepairs,
+                                            "list_follows_page");
+    if (page.__isset.next_cursor) _return.__set_next_cursor(page.next_cursor);
   }
 
   bool check_follow(const TRequestMetadata& request_metadata,
-                    const int32_t follower_id, const int32_t followee_id) {
+                    const int64_t follower_id, const int64_t followee_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
     return RPC_WRAPPER<bool>(
         std::bind(&TFollowServiceHandler::rpc_find, this,
                   std::ref(request_metadata), "follow", std::ref(follower_id),
@@ -242,7 +257,9 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
   }
 
   int32_t count_followers(const TRequestMetadata& request_metadata,
-                          const int32_t account_id) {
+                          const int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Build query struct.
     TUniquepairQuery query;
     query.__set_domain("follow");
@@ -258,7 +275,9 @@ class TFollowServiceHandler : public MicroserviceConnectedServer,
   }
 
   int32_t count_followees(const TRequestMetadata& request_metadata,
-                          const int32_t account_id) {
+                          const int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Build query struct.
     TUniquepairQuery query;
     query.__set_domain("follow");
@@ -282,6 +301,17 @@ int main(int argc, char** argv) {
       ("port", "", cxxopts::value<int>())
       ("threads", "", cxxopts::value<int>()->default_value("0"))
       ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("max_parallelism", "", cxxopts::value<int>()->default_value("16"))
+      ("rpc_event_loops", "", cxxopts::value<int>()->default_value("1"))
       ("backend_filepath", "",
           cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
       ("microservice_connection_pool_min_size", "",
@@ -298,6 +328,15 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
+  int max_parallelism = result["max_parallelism"].as<int>();
+  int rpc_event_loops = result["rpc_event_loops"].as<int>();
   std::string backend_filepath = result["backend_filepath"].as<std::string>();
   int microservice_connection_pool_min_size =
       result["microservice_connection_pool_min_size"].as<int>();
@@ -308,20 +347,24 @@ int main(int argc, char** argv) {
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(
-      std::make_shared<TFollowServiceProcessor>(
-          std::make_shared<TFollowServiceHandler>(
-              backend_filepath, microservice_connection_pool_min_size,
-              microservice_connection_pool_max_size,
-              microservice_connection_pool_allow_ephemeral, logging)),
-      socket, std::make_shared<TBufferedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  EventLoop::configure(rpc_event_loops);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TFollowServiceProcessor>(
+            std::make_shared<TFollowServiceHandler>(
+                backend_filepath, microservice_connection_pool_min_size,
+                microservice_connection_pool_max_size,
+                microservice_connection_pool_allow_ephemeral, max_parallelism,
+                logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
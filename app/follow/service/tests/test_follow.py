@@ -128,6 +128,36 @@ class TestService(unittest.TestCase):
       self.assertEqual(1, len(retrieved_follows))
       self.assertEqual(follow.id, retrieved_follows[0].id)
 
+  def test_list_follows_page(self):
+    with FollowClient(IP_ADDRESS, FOLLOW_PORT) as client:
+      # Follow an account from accounts whose follows are on different
+      # shards.
+      follows = [
+          client.follow_account(
+              TRequestMetadata(id=random_id(), requester_id=account.id),
+              self._accounts[3].id) for account in self._accounts[:3]
+      ]
+      # Walk the pages of the followers of that account and check that they
+      # hold these follows, newest first, the last one without a cursor.
+      query = TFollowQuery(followee_id=self._accounts[3].id)
+      limit = 2
+      cursor = ""
+      retrieved_follows = []
+      while cursor is not None:
+        page = client.list_follows_page(
+            TRequestMetadata(id=random_id(), requester_id=self._accounts[3].id),
+            query, limit, cursor)
+        self.assertLessEqual(len(page.follows), limit)
+        retrieved_follows += page.follows
+        cursor = page.next_cursor
+      self.assertEqual([follow.id for follow in reversed(follows)],
+                       [follow.id for follow in retrieved_follows])
+      # Check that invalid cursors are rejected.
+      with self.assertRaises(TInvalidCursorException):
+        client.list_follows_page(
+            TRequestMetadata(id=random_id(), requester_id=self._accounts[3].id),
+            query, limit, "not a cursor")
+
   def test_check_follow(self):
     with FollowClient(IP_ADDRESS, FOLLOW_PORT) as client:
       # Check that the test follow exists.
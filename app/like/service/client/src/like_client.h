@@ -9,35 +9,38 @@
 using namespace gen;
 
 namespace like_service {
-class Client : public BaseClient<TLikeServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TLikeServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TLikeServiceClient>(ip_address, port, conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TLikeServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   TLike like_post(const TRequestMetadata& request_metadata,
-                  const int32_t post_id) {
+                  const int64_t post_id) {
     TLike _return;
     _client->like_post(_return, request_metadata, post_id);
     return _return;
   }
 
   TLike retrieve_standard_like(const TRequestMetadata& request_metadata,
-                               const int32_t like_id) {
+                               const int64_t like_id) {
     TLike _return;
     _client->retrieve_standard_like(_return, request_metadata, like_id);
     return _return;
   }
 
   TLike retrieve_expanded_like(const TRequestMetadata& request_metadata,
-                               const int32_t like_id) {
+                               const int64_t like_id) {
     TLike _return;
     _client->retrieve_expanded_like(_return, request_metadata, like_id);
     return _return;
   }
 
   void delete_like(const TRequestMetadata& request_metadata,
-                   const int32_t like_id) {
+                   const int64_t like_id) {
     _client->delete_like(request_metadata, like_id);
   }
 
@@ -49,13 +52,21 @@ class Client : public BaseClient<TLikeServiceClient> {
     return _return;
   }
 
+  TLikePage list_likes_page(const TRequestMetadata& request_metadata,
+                            const TLikeQuery& query,
+                            const int32_t limit, const std::string& cursor) {
+    TLikePage _return;
+    _client->list_likes_page(_return, request_metadata, query, limit, cursor);
+    return _return;
+  }
+
   int32_t count_likes_by_account(const TRequestMetadata& request_metadata,
-                                 const int32_t account_id) {
+                                 const int64_t account_id) {
     return _client->count_likes_by_account(request_metadata, account_id);
   }
 
   int32_t count_likes_of_post(const TRequestMetadata& request_metadata,
-                              const int32_t post_id) {
+                              const int64_t post_id) {
     return _client->count_likes_of_post(request_metadata, post_id);
   }
 };
@@ -7,9 +7,14 @@ from buzzblog.base_client import BaseClient
 
 class Client(BaseClient):
 
-  def __init__(self, ip_address, port, timeout=30000, connection_pool=None):
+  def __init__(self,
+               ip_address,
+               port,
+               timeout=30000,
+               connection_pool=None,
+               framed=False):
     super().__init__(TLikeService.Client, ip_address, port, timeout,
-                     connection_pool)
+                     connection_pool, framed)
 
   def like_post(self, request_metadata, post_id):
     return self._tclient.like_post(request_metadata=request_metadata,
@@ -33,6 +38,12 @@ class Client(BaseClient):
                                     limit=limit,
                                     offset=offset)
 
+  def list_likes_page(self, request_metadata, query, limit, cursor):
+    return self._tclient.list_likes_page(request_metadata=request_metadata,
+                                         query=query,
+                                         limit=limit,
+                                         cursor=cursor)
+
   def count_likes_by_account(self, request_metadata, account_id):
     return self._tclient.count_likes_by_account(
         request_metadata=request_metadata, account_id=account_id)
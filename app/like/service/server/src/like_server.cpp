@@ -1,16 +1,16 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
 #include <buzzblog/gen/TLikeService.h>
 #include <buzzblog/microservice_connected_server.h>
+#include <buzzblog/thrift_server.h>
 #include <buzzblog/utils.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
 #include <cxxopts.hpp>
-#include <future>
 #include <string>
 
 using namespace apache::thrift;
@@ -24,27 +24,81 @@ class TLikeServiceHandler : public MicroserviceConnectedServer,
                             public TLikeServiceIf {
  private:
   std::shared_ptr<spdlog::logger> _rpc_logger;
+  // Max number of items (e.g., likes of a list) expanded at once.
+  int _max_parallelism;
+
+  // Retrieves the account and post of a like concurrently.
+  Task<TLike> expand_like(const TRequestMetadata& request_metadata, TLike like,
+                          const std::string lf) {
+    auto res = co_await when_all(
+        CO_RPC_WRAPPER<TAccount>(
+            co_rpc_retrieve_standard_account(request_metadata, like.account_id),
+            _rpc_logger,
+            "ls=like lf=" + lf +
+                " rs=account rf=retrieve_standard_account rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<TPost>(
+            co_rpc_retrieve_expanded_post(request_metadata, like.post_id),
+            _rpc_logger,
+            "ls=like lf=" + lf + " rs=post rf=retrieve_expanded_post rid=" +
+                request_metadata.id));
+
+    // Build like (expanded mode).
+    like.__set_account(std::get<0>(res));
+    like.__set_post(std::get<1>(res));
+    co_return like;
+  }
+
+  // Returns the query of the unique pairs of the likes matching a query.
+  static TUniquepairQuery build_uniquepair_query(const TLikeQuery& query) {
+    TUniquepairQuery uniquepair_query;
+    uniquepair_query.__set_domain("like");
+    if (query.__isset.account_id)
+      uniquepair_query.__set_first_elem(query.account_id);
+    if (query.__isset.post_id)
+      uniquepair_query.__set_second_elem(query.post_id);
+    return uniquepair_query;
+  }
+
+  // Builds listed likes (expanded mode) from their unique pairs, retrieving
+  // their accounts and posts a bounded number of likes at a time.
+  std::vector<TLike> expand_listed_likes(
+      const TRequestMetadata& request_metadata,
+      const std::vector<TUniquepair>& uniquepairs, const std::string lf) {
+    std::vector<Task<TLike>> likes;
+    for (const auto& uniquepair : uniquepairs) {
+      TLike like;
+      like.id = uniquepair.id;
+      like.created_at = uniquepair.created_at;
+      like.account_id = uniquepair.first_elem;
+      like.post_id = uniquepair.second_elem;
+      likes.push_back(expand_like(request_metadata, like, lf));
+    }
+    return sync_wait(when_all(std::move(likes), _max_parallelism));
+  }
 
  public:
   TLikeServiceHandler(const std::string& backend_filepath,
                       const int microservice_connection_pool_min_size,
                       const int microservice_connection_pool_max_size,
                       const int microservice_connection_pool_allow_ephemeral,
-                      const int logging)
+                      const int max_parallelism, const int logging)
       : MicroserviceConnectedServer(
             "like", backend_filepath, microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
             microservice_connection_pool_allow_ephemeral != 0, logging) {
+    _max_parallelism = max_parallelism;
     if (logging) {
-      _rpc_logger = spdlog::basic_logger_mt("rpc_logger", "/tmp/rpc.log");
-      _rpc_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _rpc_logger = get_logger("rpc_logger", "/tmp/rpc.log");
     } else {
       _rpc_logger = nullptr;
     }
   }
 
   void like_post(TLike& _return, const TRequestMetadata& request_metadata,
-                 const int32_t post_id) {
+                 const int64_t post_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Add unique pair (account, post).
     TUniquepair uniquepair;
     try {
@@ -68,7 +122,9 @@ class TLikeServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_standard_like(TLike& _return,
                               const TRequestMetadata& request_metadata,
-                              const int32_t like_id) {
+                              const int64_t like_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Get unique pair.
     TUniquepair uniquepair;
     try {
@@ -91,39 +147,20 @@ class TLikeServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_expanded_like(TLike& _return,
                               const TRequestMetadata& request_metadata,
-                              const int32_t like_id) {
+                              const int64_t like_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Retrieve standard like.
     retrieve_standard_like(_return, request_metadata, like_id);
 
-    // Retrieve account in a separate thread.
-    auto account_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<TAccount>(
-          std::bind(&TLikeServiceHandler::rpc_retrieve_standard_account, this,
-                    std::ref(request_metadata), std::ref(_return.account_id)),
-          _rpc_logger,
-          "ls=like lf=retrieve_expanded_like rs=account "
-          "rf=retrieve_standard_account rid=" +
-              request_metadata.id);
-    });
-
-    // Retrieve post in a separate thread.
-    auto post_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<TPost>(
-          std::bind(&TLikeServiceHandler::rpc_retrieve_expanded_post, this,
-                    std::ref(request_metadata), std::ref(_return.post_id)),
-          _rpc_logger,
-          "ls=like lf=retrieve_expanded_like rs=post rf=retrieve_expanded_post "
-          "rid=" +
-              request_metadata.id);
-    });
-
-    // Build like (expanded mode).
-    _return.__set_account(account_future.get());
-    _return.__set_post(post_future.get());
+    // Retrieve account and post.
+    _return = sync_wait(
+        expand_like(request_metadata, _return, "retrieve_expanded_like"));
   }
 
   void delete_like(const TRequestMetadata& request_metadata,
-                   const int32_t like_id) {
+                   const int64_t like_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
     {
       // Get unique pair.
       TUniquepair uniquepair;
@@ -159,15 +196,10 @@ class TLikeServiceHandler : public MicroserviceConnectedServer,
                   const TRequestMetadata& request_metadata,
                   const TLikeQuery& query, const int32_t limit,
                   const int32_t offset) {
-    // Build query struct.
-    TUniquepairQuery uniquepair_query;
-    uniquepair_query.__set_domain("like");
-    if (query.__isset.account_id)
-      uniquepair_query.__set_first_elem(query.account_id);
-    if (query.__isset.post_id)
-      uniquepair_query.__set_second_elem(query.post_id);
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Fetch unique pairs.
+    auto uniquepair_query = build_uniquepair_query(query);
     auto uniquepairs = RPC_WRAPPER<std::vector<TUniquepair>>(
         std::bind(&TLikeServiceHandler::rpc_fetch, this,
                   std::ref(request_metadata), std::ref(uniquepair_query),
@@ -176,52 +208,35 @@ class TLikeServiceHandler : public MicroserviceConnectedServer,
         "ls=like lf=list_likes rs=uniquepair rf=fetch rid=" +
             request_metadata.id);
 
-    // Retrieve accounts in separate threads.
-    std::vector<std::future<TAccount>> account_futures;
-    for (auto it : uniquepairs) {
-      account_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<TAccount>(
-            std::bind(&TLikeServiceHandler::rpc_retrieve_standard_account, this,
-                      std::ref(request_metadata), std::ref(it.first_elem)),
-            _rpc_logger,
-            "ls=like lf=list_likes rs=account rf=retrieve_standard_account "
-            "rid=" +
-                request_metadata.id);
-      }));
-    }
+    _return = expand_listed_likes(request_metadata, uniquepairs, "list_likes");
+  }
 
-    // Retrieve posts in separate threads.
-    std::vector<std::future<TPost>> post_futures;
-    for (auto it : uniquepairs) {
-      post_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<TPost>(
-            std::bind(&TLikeServiceHandler::rpc_retrieve_expanded_post, this,
-                      std::ref(request_metadata), std::ref(it.second_elem)),
-            _rpc_logger,
-            "ls=like lf=list_likes rs=post rf=retrieve_expanded_post rid=" +
-                request_metadata.id);
-      }));
-    }
+  void list_likes_page(TLikePage& _return,
+                       const TRequestMetadata& request_metadata,
+                       const TLikeQuery& query, const int32_t limit,
+                       const std::string& cursor) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
-    // Build likes.
-    for (auto i = 0; i < uniquepairs.size(); i++) {
-      auto uniquepair = uniquepairs[i];
-      auto account = account_futures[i].get();
-      auto post = post_futures[i].get();
-      // Build like (expanded mode).
-      TLike like;
-      like.id = uniquepair.id;
-      like.created_at = uniquepair.created_at;
-      like.account_id = uniquepair.first_elem;
-      like.post_id = uniquepair.second_elem;
-      like.__set_account(account);
-      like.__set_post(post);
-      _return.push_back(like);
-    }
+    // Fetch a page of unique pairs. Likes are unique pairs, so their pages
+    // have the same cursors.
+    auto uniquepair_query = build_uniquepair_query(query);
+    auto page = RPC_WRAPPER<TUniquepairPage>(
+        std::bind(&TLikeServiceHandler::rpc_fetch_page, this,
+                  std::ref(request_metadata), std::ref(uniquepair_query),
+                  std::ref(limit), std::ref(cursor)),
+        _rpc_logger,
+        "ls=like lf=list_likes_page rs=uniquepair rf=fetch_page rid=" +
+            request_metadata.id);
+
+    _return.likes = expand_listed_likes(request_metadata, page.uniquepairs,
+                                        "list_likes_page");
+    if (page.__isset.next_cursor) _return.__set_next_cursor(page.next_cursor);
   }
 
   int32_t count_likes_by_account(const TRequestMetadata& request_metadata,
-                                 const int32_t account_id) {
+                                 const int64_t account_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Build query struct.
     TUniquepairQuery query;
     query.__set_domain("like");
@@ -237,7 +252,9 @@ class TLikeServiceHandler : public MicroserviceConnectedServer,
   }
 
   int32_t count_likes_of_post(const TRequestMetadata& request_metadata,
-                              const int32_t post_id) {
+                              const int64_t post_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Build query struct.
     TUniquepairQuery query;
     query.__set_domain("like");
@@ -261,6 +278,17 @@ int main(int argc, char** argv) {
       ("port", "", cxxopts::value<int>())
       ("threads", "", cxxopts::value<int>()->default_value("0"))
       ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("max_parallelism", "", cxxopts::value<int>()->default_value("16"))
+      ("rpc_event_loops", "", cxxopts::value<int>()->default_value("1"))
       ("backend_filepath", "",
           cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
       ("microservice_connection_pool_min_size", "",
@@ -277,6 +305,15 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
+  int max_parallelism = result["max_parallelism"].as<int>();
+  int rpc_event_loops = result["rpc_event_loops"].as<int>();
   std::string backend_filepath = result["backend_filepath"].as<std::string>();
   int microservice_connection_pool_min_size =
       result["microservice_connection_pool_min_size"].as<int>();
@@ -287,20 +324,24 @@ int main(int argc, char** argv) {
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(
-      std::make_shared<TLikeServiceProcessor>(
-          std::make_shared<TLikeServiceHandler>(
-              backend_filepath, microservice_connection_pool_min_size,
-              microservice_connection_pool_max_size,
-              microservice_connection_pool_allow_ephemeral, logging)),
-      socket, std::make_shared<TBufferedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  EventLoop::configure(rpc_event_loops);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TLikeServiceProcessor>(
+            std::make_shared<TLikeServiceHandler>(
+                backend_filepath, microservice_connection_pool_min_size,
+                microservice_connection_pool_max_size,
+                microservice_connection_pool_allow_ephemeral, max_parallelism,
+                logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
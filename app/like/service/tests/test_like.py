@@ -133,6 +133,35 @@ class TestService(unittest.TestCase):
       self.assertEqual(1, len(retrieved_likes))
       self.assertEqual(like.id, retrieved_likes[0].id)
 
+  def test_list_likes_page(self):
+    with LikeClient(IP_ADDRESS, LIKE_PORT) as client:
+      # Like a post from accounts whose likes are on different shards.
+      likes = [
+          client.like_post(
+              TRequestMetadata(id=random_id(), requester_id=account.id),
+              self._posts[2].id) for account in self._accounts
+      ]
+      # Walk the pages of the likes of that post and check that they hold
+      # these likes, newest first, the last one without a cursor.
+      query = TLikeQuery(post_id=self._posts[2].id)
+      limit = 2
+      cursor = ""
+      retrieved_likes = []
+      while cursor is not None:
+        page = client.list_likes_page(
+            TRequestMetadata(id=random_id(), requester_id=self._accounts[0].id),
+            query, limit, cursor)
+        self.assertLessEqual(len(page.likes), limit)
+        retrieved_likes += page.likes
+        cursor = page.next_cursor
+      self.assertEqual([like.id for like in reversed(likes)],
+                       [like.id for like in retrieved_likes])
+      # Check that invalid cursors are rejected.
+      with self.assertRaises(TInvalidCursorException):
+        client.list_likes_page(
+            TRequestMetadata(id=random_id(), requester_id=self._accounts[0].id),
+            query, limit, "not a cursor")
+
   def test_count_likes_by_account(self):
     with LikeClient(IP_ADDRESS, LIKE_PORT) as client:
       # Like a post.
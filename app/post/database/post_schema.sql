@@ -1,13 +1,22 @@
 -- Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 -- Systems
 
+-- Posts are partitioned by ranges of ids, which sort by creation time. The
+-- post service adds a partition for each time range (see `partition_days`)
+-- before posts are created in it; other posts go to the default partition.
 CREATE TABLE Posts(
-  id SERIAL PRIMARY KEY, 
+  id BIGINT PRIMARY KEY, 
   created_at INTEGER NOT NULL,
   active BOOLEAN DEFAULT true,
   text VARCHAR(256) NOT NULL,
-  author_id INTEGER NOT NULL
-);
+  author_id BIGINT NOT NULL
+) PARTITION BY RANGE (id);
 
-CREATE INDEX idx_created_at ON Posts(created_at);
+CREATE TABLE Posts_default PARTITION OF Posts DEFAULT;
+
+-- Posts are listed by descending id, which is reverse chronological order, and
+-- only if active, so that pages of the posts of an author are read in order off
+-- the index instead of sorting all of them.
+CREATE INDEX idx_active_author_id ON Posts(author_id, id) WHERE active = true;
+-- Posts are counted by author, active or not, off the index alone.
 CREATE INDEX idx_author_id ON Posts(author_id);
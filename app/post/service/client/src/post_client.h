@@ -9,11 +9,14 @@
 using namespace gen;
 
 namespace post_service {
-class Client : public BaseClient<TPostServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TPostServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TPostServiceClient>(ip_address, port, conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TPostServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   TPost create_post(const TRequestMetadata& request_metadata,
                     const std::string& text) {
@@ -23,21 +26,21 @@ class Client : public BaseClient<TPostServiceClient> {
   }
 
   TPost retrieve_standard_post(const TRequestMetadata& request_metadata,
-                               const int32_t post_id) {
+                               const int64_t post_id) {
     TPost _return;
     _client->retrieve_standard_post(_return, request_metadata, post_id);
     return _return;
   }
 
   TPost retrieve_expanded_post(const TRequestMetadata& request_metadata,
-                               const int32_t post_id) {
+                               const int64_t post_id) {
     TPost _return;
     _client->retrieve_expanded_post(_return, request_metadata, post_id);
     return _return;
   }
 
   void delete_post(const TRequestMetadata& request_metadata,
-                   const int32_t post_id) {
+                   const int64_t post_id) {
     _client->delete_post(request_metadata, post_id);
   }
 
@@ -49,8 +52,16 @@ class Client : public BaseClient<TPostServiceClient> {
     return _return;
   }
 
+  TPostPage list_posts_page(const TRequestMetadata& request_metadata,
+                            const TPostQuery& query,
+                            const int32_t limit, const std::string& cursor) {
+    TPostPage _return;
+    _client->list_posts_page(_return, request_metadata, query, limit, cursor);
+    return _return;
+  }
+
   int32_t count_posts_by_author(const TRequestMetadata& request_metadata,
-                                const int32_t author_id) {
+                                const int64_t author_id) {
     return _client->count_posts_by_author(request_metadata, author_id);
   }
 };
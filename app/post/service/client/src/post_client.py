@@ -7,9 +7,14 @@ from buzzblog.base_client import BaseClient
 
 class Client(BaseClient):
 
-  def __init__(self, ip_address, port, timeout=30000, connection_pool=None):
+  def __init__(self,
+               ip_address,
+               port,
+               timeout=30000,
+               connection_pool=None,
+               framed=False):
     super().__init__(TPostService.Client, ip_address, port, timeout,
-                     connection_pool)
+                     connection_pool, framed)
 
   def create_post(self, request_metadata, text):
     return self._tclient.create_post(request_metadata=request_metadata,
@@ -33,6 +38,12 @@ class Client(BaseClient):
                                     limit=limit,
                                     offset=offset)
 
+  def list_posts_page(self, request_metadata, query, limit, cursor):
+    return self._tclient.list_posts_page(request_metadata=request_metadata,
+                                         query=query,
+                                         limit=limit,
+                                         cursor=cursor)
+
   def count_posts_by_author(self, request_metadata, author_id):
     return self._tclient.count_posts_by_author(
         request_metadata=request_metadata, author_id=author_id)
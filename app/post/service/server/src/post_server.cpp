@@ -1,18 +1,29 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
+#include <buzzblog/executor.h>
 #include <buzzblog/gen/TPostService.h>
+#include <buzzblog/group_commit.h>
+#include <buzzblog/id_generator.h>
 #include <buzzblog/microservice_connected_server.h>
 #include <buzzblog/postgres_connected_server.h>
+#include <buzzblog/slow_query_log.h>
+#include <buzzblog/thrift_server.h>
 #include <buzzblog/utils.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
+#include <atomic>
+#include <ctime>
 #include <cxxopts.hpp>
 #include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
@@ -25,19 +36,230 @@ class TPostServiceHandler : public MicroserviceConnectedServer,
                             public PostgresConnectedServer,
                             public TPostServiceIf {
  private:
+  // Post to be created by a group commit.
+  struct PendingPost {
+    int64_t id;
+    std::string text;
+    int64_t author_id;
+    int64_t deadline_ms;
+  };
+
+  // Id and creation time of a created post.
+  struct CreatedPost {
+    int64_t id;
+    int32_t created_at;
+  };
+
   std::shared_ptr<spdlog::logger> _rpc_logger;
   std::shared_ptr<spdlog::logger> _query_logger;
+  // Number of shards of the database.
+  int _n_shards;
+  // Group committers of created posts, one per shard.
+  std::vector<std::unique_ptr<GroupCommitter<PendingPost, CreatedPost>>>
+      _create_committers;
+  // Time range (in milliseconds) of each partition of the Posts table, or 0
+  // if the service does not manage partitions.
+  int64_t _partition_ms;
+  // Time (ms since epoch) until which partitions need not be added.
+  std::atomic<int64_t> _partitions_checked_until_ms;
+  std::mutex _partitions_mutex;
+
+  // Returns the shard holding the posts of an author, or the post with the
+  // given id. Ids of posts are generated so that they are congruent to their
+  // shard modulo the number of shards.
+  int shard_of(const int64_t author_or_post_id) {
+    return (author_or_post_id % _n_shards + _n_shards) % _n_shards;
+  }
+
+  // Returns the start time (ms since epoch) of the partition holding the posts
+  // created at a given time.
+  int64_t partition_start_ms(const int64_t time_ms) {
+    return time_ms - time_ms % _partition_ms;
+  }
+
+  // Returns the command that creates the partition of the Posts table holding
+  // the posts created from a given time on, and attaches it, unless already
+  // done. Unlike creating a table as a partition, attaching it does not block
+  // reads and writes of the Posts table. Posts of the range that went to the
+  // default partition while it had no partition are moved to it first, since
+  // it cannot be attached while the default partition holds any of them.
+  std::string add_partition_command(const int64_t from_ms) {
+    std::time_t from_s = from_ms / 1000;
+    std::tm from_tm;
+    gmtime_r(&from_s, &from_tm);
+    char name[32];
+    std::strftime(name, sizeof(name), "posts_%Y%m%d", &from_tm);
+    std::string table(name);
+    auto from_id = std::to_string(IdGenerator::min_id_at(from_ms));
+    auto to_id =
+        std::to_string(IdGenerator::min_id_at(from_ms + _partition_ms));
+    auto in_range = "id >= " + from_id + " AND id < " + to_id;
+    return "DO $$ BEGIN "
+           // Wait for other servers adding partitions.
+           "PERFORM pg_advisory_xact_lock(hashtext('posts_partitions')); "
+           "IF to_regclass('" + table + "') IS NULL THEN "
+           "CREATE TABLE " + table + " (LIKE Posts INCLUDING DEFAULTS); "
+           "END IF; "
+           "IF NOT EXISTS (SELECT FROM pg_inherits "
+           "WHERE inhrelid = '" + table + "'::regclass) THEN "
+           // Attaching locks the default partition anyway.
+           "LOCK TABLE Posts_default IN ACCESS EXCLUSIVE MODE; "
+           "INSERT INTO " + table + " "
+           "SELECT * FROM Posts_default WHERE " + in_range + "; "
+           "DELETE FROM Posts_default WHERE " + in_range + "; "
+           "ALTER TABLE Posts ATTACH PARTITION " + table + " "
+           "FOR VALUES FROM (" + from_id + ") TO (" + to_id + "); "
+           "END IF; "
+           "END $$";
+  }
+
+  // Adds the partitions of the current and next time ranges on every shard,
+  // once per time range, so that partitions exist before posts are created in
+  // them. If that fails, posts go to the default partition and adding
+  // partitions is retried a minute later, unless the ranges overlap existing
+  // partitions (i.e., `partition_days` changed), which retrying cannot fix.
+  void add_partitions() {
+    if (_partition_ms == 0 || now_ms() < _partitions_checked_until_ms) return;
+    std::lock_guard<std::mutex> lock(_partitions_mutex);
+    auto now = now_ms();
+    if (now < _partitions_checked_until_ms) return;
+    auto start_ms = partition_start_ms(now);
+    try {
+      for (int shard = 0; shard < _n_shards; shard++) {
+        auto dbname = shard_dbname("post", shard);
+        run_command(dbname, add_partition_command(start_ms));
+        run_command(dbname, add_partition_command(start_ms + _partition_ms));
+      }
+      _partitions_checked_until_ms = start_ms + _partition_ms;
+    } catch (const pqxx::sql_error& e) {
+      // Overlapping partitions fail with invalid_object_definition.
+      bool overlap = e.sqlstate() == "42P17";
+      PostgresConnectedServer::stdout_log(
+          std::string("Failed to add partitions of Posts") +
+          (overlap ? " (overlapping existing partitions, not retried until "
+                     "the next range): "
+                   : ": ") +
+          e.what());
+      _partitions_checked_until_ms =
+          overlap ? start_ms + _partition_ms : now + 60000;
+    } catch (const std::exception& e) {
+      PostgresConnectedServer::stdout_log(
+          std::string("Failed to add partitions of Posts: ") + e.what());
+      _partitions_checked_until_ms = now + 60000;
+    }
+  }
+
+  // Lists the active posts of a shard (by an author, if set in the query) in
+  // reverse chronological order. Posts of the current and previous partitions
+  // are listed first, with a lower bound on their ids that lets Postgres skip
+  // older partitions. Older posts are only listed if recent ones do not fill
+  // the page.
+  std::vector<pqxx::row> list_shard(const std::string& dbname,
+                                    const TRequestMetadata& request_metadata,
+                                    const TPostQuery& query,
+                                    const int64_t limit, const int64_t offset,
+                                    const std::string& lf) {
+    auto list = [&](const std::string& name, const auto&... args) {
+      if (query.__isset.author_id)
+        return run_prepared(name + "_by_author", dbname, request_metadata, lf,
+                            query.author_id, args...);
+      return run_prepared(name, dbname, request_metadata, lf, args...);
+    };
+    if (_partition_ms == 0) {
+      auto db_res = list("list_posts", limit, offset);
+      return std::vector<pqxx::row>(db_res.begin(), db_res.end());
+    }
+    auto recent_id =
+        IdGenerator::min_id_at(partition_start_ms(now_ms()) - _partition_ms);
+    auto recent = list("list_recent_posts", recent_id, limit, offset);
+    std::vector<pqxx::row> rows(recent.begin(), recent.end());
+    if (int64_t(rows.size()) == limit) return rows;
+    // If no recent post is listed, it is unknown how many of them the offset
+    // skips, so the page is listed from all partitions.
+    auto older =
+        rows.empty() && offset > 0
+            ? list("list_posts", limit, offset)
+            : list("list_older_posts", recent_id,
+                   limit - int64_t(rows.size()), 0);
+    rows.insert(rows.end(), older.begin(), older.end());
+    return rows;
+  }
 
   bool validate_attributes(const std::string& text) {
     return (text.size() > 0 && text.size() <= 200);
   }
 
-  std::string build_where_clause(const TPostQuery& query) {
-    std::ostringstream where_clause;
-    where_clause << "active = true";
-    if (query.__isset.author_id)
-      where_clause << " AND author_id = " << query.author_id;
-    return where_clause.str();
+  // Creates a batch of posts on a shard with a single statement.
+  std::vector<CreatedPost> create_batch(const int shard,
+                                        const std::vector<PendingPost>& posts) {
+    std::vector<int64_t> ids;
+    std::vector<std::string> texts;
+    std::vector<int64_t> author_ids;
+    std::vector<int64_t> deadlines_ms;
+    for (const auto& post : posts) {
+      ids.push_back(post.id);
+      texts.push_back(post.text);
+      author_ids.push_back(post.author_id);
+      deadlines_ms.push_back(post.deadline_ms);
+    }
+    TRequestMetadata batch_metadata;
+    auto deadline_ms = latest_deadline(deadlines_ms);
+    if (deadline_ms > 0) batch_metadata.__set_deadline(deadline_ms);
+
+    // Execute query.
+    auto db_res =
+        run_prepared("create_posts", shard_dbname("post", shard),
+                     batch_metadata, "create_post", array_literal(ids),
+                     array_literal(texts), array_literal(author_ids));
+
+    // Match created rows to posts by id.
+    std::map<int64_t, int32_t> created_at;
+    for (auto row : db_res)
+      created_at[row["id"].as<int64_t>()] = row["created_at"].as<int>();
+    std::vector<CreatedPost> created;
+    for (const auto& post : posts)
+      created.push_back({post.id, created_at.at(post.id)});
+    return created;
+  }
+
+  // Retrieves the author and like activity of a post concurrently.
+  Task<TPost> expand_post(const TRequestMetadata& request_metadata, TPost post,
+                          const std::string lf) {
+    auto activity = co_await when_all(
+        CO_RPC_WRAPPER<TAccount>(
+            co_rpc_retrieve_standard_account(request_metadata, post.author_id),
+            _rpc_logger,
+            "ls=post lf=" + lf +
+                " rs=account rf=retrieve_standard_account rid=" +
+                request_metadata.id),
+        CO_RPC_WRAPPER<int32_t>(
+            co_rpc_count_likes_of_post(request_metadata, post.id), _rpc_logger,
+            "ls=post lf=" + lf + " rs=like rf=count_likes_of_post rid=" +
+                request_metadata.id));
+
+    // Build post (expanded mode).
+    post.__set_author(std::get<0>(activity));
+    post.__set_n_likes(std::get<1>(activity));
+    co_return post;
+  }
+
+  // Builds listed posts (expanded mode) from their rows, retrieving their
+  // authors and like activity a bounded number of posts at a time.
+  std::vector<TPost> expand_listed_posts(
+      const TRequestMetadata& request_metadata,
+      const std::vector<pqxx::row>& rows, const std::string lf) {
+    std::vector<Task<TPost>> posts;
+    for (const auto& row : rows) {
+      TPost post;
+      post.id = row["id"].as<int64_t>();
+      post.created_at = row["created_at"].as<int>();
+      post.active = row["active"].as<bool>();
+      post.text = row["text"].as<std::string>();
+      post.author_id = row["author_id"].as<int64_t>();
+      posts.push_back(expand_post(request_metadata, post, lf));
+    }
+    return sync_wait(
+        when_all(std::move(posts), Executor::instance().max_parallelism()));
   }
 
  public:
@@ -49,7 +271,10 @@ class TPostServiceHandler : public MicroserviceConnectedServer,
                       const int postgres_connection_pool_max_size,
                       const int postgres_connection_pool_allow_ephemeral,
                       const std::string& postgres_user,
-                      const std::string& postgres_password, const int logging)
+                      const std::string& postgres_password,
+                      const int group_commit_window_us,
+                      const int group_commit_max_batch_size,
+                      const int partition_days, const int logging)
       : MicroserviceConnectedServer(
             "post", backend_filepath, microservice_connection_pool_min_size,
             microservice_connection_pool_max_size,
@@ -58,25 +283,133 @@ class TPostServiceHandler : public MicroserviceConnectedServer,
                                 postgres_connection_pool_min_size,
                                 postgres_connection_pool_max_size,
                                 postgres_connection_pool_allow_ephemeral != 0,
-                                postgres_user, postgres_password, logging) {
+                                postgres_user, postgres_password, false,
+                                logging) {
+    std::shared_ptr<spdlog::logger> group_commit_logger;
     if (logging) {
-      _rpc_logger = spdlog::basic_logger_mt("rpc_logger", "/tmp/rpc.log");
-      _rpc_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
-      _query_logger = spdlog::basic_logger_mt("query_logger", "/tmp/query.log");
-      _query_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _rpc_logger = get_logger("rpc_logger", "/tmp/rpc.log");
+      _query_logger = get_logger("query_logger", "/tmp/query.log");
+      group_commit_logger =
+          get_logger("group_commit_logger", "/tmp/group_commit.log");
     } else {
       _rpc_logger = nullptr;
       _query_logger = nullptr;
+      group_commit_logger = nullptr;
+    }
+
+    _n_shards = shard_count("post");
+    _partition_ms = int64_t(partition_days) * 24 * 60 * 60 * 1000;
+    _partitions_checked_until_ms = 0;
+
+    // Create posts in groups, if enabled.
+    if (group_commit_window_us > 0) {
+      for (int shard = 0; shard < _n_shards; shard++)
+        _create_committers.push_back(
+            std::make_unique<GroupCommitter<PendingPost, CreatedPost>>(
+                "ls=post lf=create_post db=" + shard_dbname("post", shard),
+                group_commit_window_us, group_commit_max_batch_size,
+                [this, shard](const std::vector<PendingPost>& posts) {
+                  return create_batch(shard, posts);
+                },
+                group_commit_logger));
     }
+
+    // Declare prepared statements. Ids are generated by the service and sort by
+    // creation time.
+    prepare("create_post",
+            "INSERT INTO Posts (id, text, author_id, created_at) "
+            "VALUES ($1, $2, $3, extract(epoch from now())) "
+            "RETURNING id, created_at",
+            WRITE_QUERY);
+    prepare("create_posts",
+            "INSERT INTO Posts (id, text, author_id, created_at) "
+            "SELECT id, text, author_id, extract(epoch from now()) "
+            "FROM unnest($1::bigint[], $2::varchar[], $3::bigint[]) "
+            "AS t(id, text, author_id) "
+            "RETURNING id, created_at",
+            WRITE_QUERY);
+    prepare("retrieve_standard_post",
+            "SELECT created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE id = $1",
+            READ_QUERY);
+    prepare("retrieve_post_author",
+            "SELECT author_id "
+            "FROM Posts "
+            "WHERE id = $1",
+            READ_QUERY);
+    prepare("delete_post",
+            "UPDATE Posts "
+            "SET active = FALSE "
+            "WHERE id = $1 AND author_id = $2",
+            WRITE_QUERY);
+    prepare("list_posts",
+            "SELECT id, created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE active = true "
+            "ORDER BY id DESC "
+            "LIMIT $1 "
+            "OFFSET $2",
+            READ_QUERY);
+    prepare("list_posts_by_author",
+            "SELECT id, created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE active = true AND author_id = $1 "
+            "ORDER BY id DESC "
+            "LIMIT $2 "
+            "OFFSET $3",
+            READ_QUERY);
+    prepare("list_recent_posts",
+            "SELECT id, created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE active = true AND id >= $1 "
+            "ORDER BY id DESC "
+            "LIMIT $2 "
+            "OFFSET $3",
+            READ_QUERY);
+    prepare("list_recent_posts_by_author",
+            "SELECT id, created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE active = true AND author_id = $1 AND id >= $2 "
+            "ORDER BY id DESC "
+            "LIMIT $3 "
+            "OFFSET $4",
+            READ_QUERY);
+    prepare("list_older_posts",
+            "SELECT id, created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE active = true AND id < $1 "
+            "ORDER BY id DESC "
+            "LIMIT $2 "
+            "OFFSET $3",
+            READ_QUERY);
+    prepare("list_older_posts_by_author",
+            "SELECT id, created_at, active, text, author_id "
+            "FROM Posts "
+            "WHERE active = true AND author_id = $1 AND id < $2 "
+            "ORDER BY id DESC "
+            "LIMIT $3 "
+            "OFFSET $4",
+            READ_QUERY);
+    prepare("count_posts_by_author",
+            "SELECT COUNT(*) "
+            "FROM Posts "
+            "WHERE author_id = $1",
+            READ_QUERY);
   }
 
   void create_post(TPost& _return, const TRequestMetadata& request_metadata,
                    const std::string& text) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Validate attributes.
     if (!validate_attributes(text)) throw TPostInvalidAttributesException();
 
-    // Update trending score of hashtags in a separate thread.
-    auto trending_future = std::async(std::launch::async, [&] {
+    // Run concurrent calls on the shared executor.
+    TaskGroup task_group;
+
+    // Update trending score of hashtags concurrently.
+    auto trending_future = task_group.submit([&] {
       return VOID_RPC_WRAPPER(
           std::bind(&TPostServiceHandler::rpc_process_post, this,
                     std::ref(request_metadata), std::ref(text)),
@@ -85,24 +418,33 @@ class TPostServiceHandler : public MicroserviceConnectedServer,
               request_metadata.id);
     });
 
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "INSERT INTO Posts (text, author_id, created_at) "
-        "VALUES ('%s', %d, extract(epoch from now())) "
-        "RETURNING id, created_at";
-    sprintf(query_str, query_fmt, text.c_str(), request_metadata.requester_id);
-
-    // Execute query.
-    auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TPostServiceHandler::run_query, this, std::ref(query_str),
-                  "post"),
+    // Execute query on the shard of the author, along with concurrent ones if
+    // group commit is enabled.
+    int shard = shard_of(request_metadata.requester_id);
+    auto dbname = shard_dbname("post", shard);
+    auto post_id = IdGenerator::instance().next(shard, _n_shards);
+    add_partitions();
+    auto created = RPC_WRAPPER<CreatedPost>(
+        [&] {
+          if (!_create_committers.empty()) {
+            auto post = _create_committers[shard]->submit(
+                {post_id, text, request_metadata.requester_id,
+                 get_deadline(request_metadata)});
+            note_write(dbname, request_metadata);
+            return post;
+          }
+          auto db_res = run_prepared("create_post", dbname, request_metadata,
+                                     "create_post", post_id, text,
+                                     request_metadata.requester_id);
+          return CreatedPost{db_res[0][0].as<int64_t>(),
+                             db_res[0][1].as<int>()};
+        },
         _query_logger,
         "ls=post lf=create_post db=post qt=insert rid=" + request_metadata.id);
 
     // Build post (standard mode).
-    _return.id = db_res[0][0].as<int>();
-    _return.created_at = db_res[0][1].as<int>();
+    _return.id = created.id;
+    _return.created_at = created.created_at;
     _return.active = true;
     _return.text = text;
     _return.author_id = request_metadata.requester_id;
@@ -113,19 +455,17 @@ class TPostServiceHandler : public MicroserviceConnectedServer,
 
   void retrieve_standard_post(TPost& _return,
                               const TRequestMetadata& request_metadata,
-                              const int32_t post_id) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT created_at, active, text, author_id "
-        "FROM Posts "
-        "WHERE id = %d";
-    sprintf(query_str, query_fmt, post_id);
+                              const int64_t post_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TPostServiceHandler::run_query, this, std::ref(query_str),
-                  "post"),
+        [&] {
+          return run_prepared("retrieve_standard_post",
+                              shard_dbname("post", shard_of(post_id)),
+                              request_metadata, "retrieve_standard_post",
+                              post_id);
+        },
         _query_logger,
         "ls=post lf=retrieve_standard_post db=post qt=select rid=" +
             request_metadata.id);
@@ -138,149 +478,125 @@ class TPostServiceHandler : public MicroserviceConnectedServer,
     _return.created_at = db_res[0][0].as<int>();
     _return.active = db_res[0][1].as<bool>();
     _return.text = db_res[0][2].as<std::string>();
-    _return.author_id = db_res[0][3].as<int>();
+    _return.author_id = db_res[0][3].as<int64_t>();
   }
 
   void retrieve_expanded_post(TPost& _return,
                               const TRequestMetadata& request_metadata,
-                              const int32_t post_id) {
+                              const int64_t post_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
     // Retrieve standard post.
     retrieve_standard_post(_return, request_metadata, post_id);
 
-    // Retrieve author in a separate thread.
-    auto author_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<TAccount>(
-          std::bind(&TPostServiceHandler::rpc_retrieve_standard_account, this,
-                    std::ref(request_metadata), std::ref(_return.author_id)),
-          _rpc_logger,
-          "ls=post lf=retrieve_expanded_post rs=account "
-          "rf=retrieve_standard_account rid=" +
-              request_metadata.id);
-    });
-
-    // Retrieve like activity in a separate thread.
-    auto n_likes_future = std::async(std::launch::async, [&] {
-      return RPC_WRAPPER<int32_t>(
-          std::bind(&TPostServiceHandler::rpc_count_likes_of_post, this,
-                    std::ref(request_metadata), std::ref(post_id)),
-          _rpc_logger,
-          "ls=post lf=retrieve_expanded_post rs=like rf=count_likes_of_post "
-          "rid=" +
-              request_metadata.id);
-    });
-
-    // Build post (expanded mode).
-    _return.__set_author(author_future.get());
-    _return.__set_n_likes(n_likes_future.get());
+    // Retrieve author and like activity.
+    _return = sync_wait(
+        expand_post(request_metadata, _return, "retrieve_expanded_post"));
   }
 
   void delete_post(const TRequestMetadata& request_metadata,
-                   const int32_t post_id) {
-    {
-      // Retrieve standard post.
-      TPost post;
-      retrieve_standard_post(post, request_metadata, post_id);
-
-      // Check if requester is authorized.
-      if (request_metadata.requester_id != post.author_id)
-        throw TPostNotAuthorizedException();
-    }
-
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "UPDATE Posts "
-        "SET active = FALSE "
-        "WHERE id = %d";
-    sprintf(query_str, query_fmt, post_id);
-
-    // Execute query.
-    RPC_WRAPPER<pqxx::result>(
-        std::bind(&TPostServiceHandler::run_query, this, std::ref(query_str),
-                  "post"),
+                   const int64_t post_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
+    // Execute queries. The post is only deleted if the requester is its
+    // author, so both queries are sent at once.
+    auto db_res = RPC_WRAPPER<std::vector<pqxx::result>>(
+        [&] {
+          return run_queries(
+              {prepared_query("retrieve_post_author", post_id),
+               prepared_query("delete_post", post_id,
+                              request_metadata.requester_id)},
+              shard_dbname("post", shard_of(post_id)), request_metadata);
+        },
         _query_logger,
         "ls=post lf=delete_post db=post qt=update rid=" + request_metadata.id);
+
+    // Check if post exists.
+    if (db_res[0].begin() == db_res[0].end()) throw TPostNotFoundException();
+
+    // Check if requester is authorized.
+    if (request_metadata.requester_id != db_res[0][0][0].as<int64_t>())
+      throw TPostNotAuthorizedException();
   }
 
   void list_posts(std::vector<TPost>& _return,
                   const TRequestMetadata& request_metadata,
                   const TPostQuery& query, const int32_t limit,
                   const int32_t offset) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT id, created_at, active, text, author_id "
-        "FROM Posts "
-        "WHERE %s "
-        "ORDER BY created_at DESC "
-        "LIMIT %d "
-        "OFFSET %d";
-    sprintf(query_str, query_fmt, build_where_clause(query).c_str(), limit,
-            offset);
-
-    // Execute query.
-    auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TPostServiceHandler::run_query, this, std::ref(query_str),
-                  "post"),
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
+    // Execute query on the shard of the author, or on every shard. Every shard
+    // returns its first `offset + limit` posts, which are merged.
+    auto db_results = RPC_WRAPPER<std::vector<std::vector<pqxx::row>>>(
+        [&] {
+          if (query.__isset.author_id || _n_shards == 1)
+            return std::vector<std::vector<pqxx::row>>{list_shard(
+                shard_dbname("post", query.__isset.author_id
+                                         ? shard_of(query.author_id)
+                                         : 0),
+                request_metadata, query, limit, offset, "list_posts")};
+          return scatter("post", [&](const std::string& dbname) {
+            return list_shard(dbname, request_metadata, query,
+                              int64_t(limit) + offset, 0, "list_posts");
+          });
+        },
         _query_logger,
         "ls=post lf=list_posts db=post qt=select rid=" + request_metadata.id);
+    auto rows = db_results.size() == 1
+                    ? db_results[0]
+                    : merge_descending(db_results, "id", offset, limit);
 
-    // Retrieve authors in separate threads.
-    std::vector<std::future<TAccount>> author_futures;
-    for (auto row : db_res) {
-      author_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<TAccount>(
-            std::bind(&TPostServiceHandler::rpc_retrieve_standard_account, this,
-                      std::ref(request_metadata), row["author_id"].as<int>()),
-            _rpc_logger,
-            "ls=post lf=list_posts rs=account rf=retrieve_standard_account "
-            "rid=" +
-                request_metadata.id);
-      }));
-    }
-
-    // Retrieve like activity in separate threads.
-    std::vector<std::future<int>> n_likes_futures;
-    for (auto row : db_res) {
-      n_likes_futures.push_back(std::async(std::launch::async, [&] {
-        return RPC_WRAPPER<int32_t>(
-            std::bind(&TPostServiceHandler::rpc_count_likes_of_post, this,
-                      std::ref(request_metadata), row["id"].as<int>()),
-            _rpc_logger,
-            "ls=post lf=list_posts rs=like rf=count_likes_of_post rid=" +
-                request_metadata.id);
-      }));
-    }
+    _return = expand_listed_posts(request_metadata, rows, "list_posts");
+  }
 
-    // Build posts.
-    for (auto i = 0; i < db_res.size(); i++) {
-      // Build post (expanded mode).
-      TPost post;
-      post.id = db_res[i]["id"].as<int>();
-      post.created_at = db_res[i]["created_at"].as<int>();
-      post.active = db_res[i]["active"].as<bool>();
-      post.text = db_res[i]["text"].as<std::string>();
-      post.author_id = db_res[i]["author_id"].as<int>();
-      post.__set_author(author_futures[i].get());
-      post.__set_n_likes(n_likes_futures[i].get());
-      _return.push_back(post);
-    }
+  void list_posts_page(TPostPage& _return,
+                       const TRequestMetadata& request_metadata,
+                       const TPostQuery& query, const int32_t limit,
+                       const std::string& cursor) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
+    // Execute query on the shard of the author, or on every shard. Posts
+    // before the cursor are found by a seek on an index that orders them by
+    // id, so Postgres also skips partitions of later posts.
+    auto before_id = decode_cursor(cursor);
+    auto db_results = RPC_WRAPPER<std::vector<pqxx::result>>(
+        [&] {
+          if (query.__isset.author_id)
+            return std::vector<pqxx::result>{run_prepared(
+                "list_older_posts_by_author",
+                shard_dbname("post", shard_of(query.author_id)),
+                request_metadata, "list_posts_page", query.author_id,
+                before_id, limit, 0)};
+          return scatter("post", [&](const std::string& dbname) {
+            return run_prepared("list_older_posts", dbname, request_metadata,
+                                "list_posts_page", before_id, limit, 0);
+          });
+        },
+        _query_logger,
+        "ls=post lf=list_posts_page db=post qt=select rid=" +
+            request_metadata.id);
+    auto rows = merge_descending(db_results, "id", 0, limit);
+
+    // Build page.
+    _return.posts =
+        expand_listed_posts(request_metadata, rows, "list_posts_page");
+    if (limit > 0 && int32_t(rows.size()) == limit)
+      _return.__set_next_cursor(
+          encode_cursor(rows.back()["id"].as<int64_t>()));
   }
 
   int32_t count_posts_by_author(const TRequestMetadata& request_metadata,
-                                const int32_t author_id) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT COUNT(*) "
-        "FROM Posts "
-        "WHERE author_id = %d";
-    sprintf(query_str, query_fmt, author_id);
+                                const int64_t author_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TPostServiceHandler::run_query, this, std::ref(query_str),
-                  "post"),
+        [&] {
+          return run_prepared("count_posts_by_author",
+                              shard_dbname("post", shard_of(author_id)),
+                              request_metadata, "count_posts_by_author",
+                              author_id);
+        },
         _query_logger,
         "ls=post lf=count_posts_by_author db=post qt=select rid=" +
             request_metadata.id);
@@ -297,6 +613,21 @@ int main(int argc, char** argv) {
       ("port", "", cxxopts::value<int>())
       ("threads", "", cxxopts::value<int>()->default_value("0"))
       ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("executor_threads", "", cxxopts::value<int>()->default_value("64"))
+      ("executor_max_parallelism", "",
+          cxxopts::value<int>()->default_value("16"))
+      ("executor_max_queue_depth", "",
+          cxxopts::value<int>()->default_value("4096"))
+      ("rpc_event_loops", "", cxxopts::value<int>()->default_value("1"))
       ("backend_filepath", "",
           cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
       ("microservice_connection_pool_min_size", "",
@@ -315,6 +646,14 @@ int main(int argc, char** argv) {
           cxxopts::value<std::string>()->default_value("postgres"))
       ("postgres_password", "",
           cxxopts::value<std::string>()->default_value("postgres"))
+      ("slow_query_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("slow_query_explains_per_s", "",
+          cxxopts::value<int>()->default_value("1"))
+      ("group_commit_window_us", "", cxxopts::value<int>()->default_value("0"))
+      ("group_commit_max_batch_size", "",
+          cxxopts::value<int>()->default_value("64"))
+      ("node_id", "", cxxopts::value<std::string>())
+      ("partition_days", "", cxxopts::value<int>()->default_value("7"))
       ("logging", "", cxxopts::value<int>()->default_value("1"));
 
   // Parse command-line arguments.
@@ -323,6 +662,17 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
+  int executor_threads = result["executor_threads"].as<int>();
+  int executor_max_parallelism = result["executor_max_parallelism"].as<int>();
+  int executor_max_queue_depth = result["executor_max_queue_depth"].as<int>();
+  int rpc_event_loops = result["rpc_event_loops"].as<int>();
   std::string backend_filepath = result["backend_filepath"].as<std::string>();
   int microservice_connection_pool_min_size =
       result["microservice_connection_pool_min_size"].as<int>();
@@ -338,27 +688,42 @@ int main(int argc, char** argv) {
       result["postgres_connection_pool_allow_ephemeral"].as<int>();
   std::string postgres_user = result["postgres_user"].as<std::string>();
   std::string postgres_password = result["postgres_password"].as<std::string>();
+  int slow_query_ms = result["slow_query_ms"].as<int>();
+  int slow_query_explains_per_s = result["slow_query_explains_per_s"].as<int>();
+  int group_commit_window_us = result["group_commit_window_us"].as<int>();
+  int group_commit_max_batch_size =
+      result["group_commit_max_batch_size"].as<int>();
+  std::string node_id = result["node_id"].as<std::string>();
+  int partition_days = result["partition_days"].as<int>();
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(
-      std::make_shared<TPostServiceProcessor>(
-          std::make_shared<TPostServiceHandler>(
-              backend_filepath, microservice_connection_pool_min_size,
-              microservice_connection_pool_max_size,
-              microservice_connection_pool_allow_ephemeral,
-              postgres_connection_pool_min_size,
-              postgres_connection_pool_max_size,
-              postgres_connection_pool_allow_ephemeral, postgres_user,
-              postgres_password, logging)),
-      socket, std::make_shared<TBufferedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  SlowQueryLog::configure(slow_query_ms, slow_query_explains_per_s, logging);
+  IdGenerator::configure(IdGenerator::parse_node_id(node_id));
+  Executor::configure(executor_threads, executor_max_parallelism,
+                      executor_max_queue_depth, logging);
+  EventLoop::configure(rpc_event_loops);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TPostServiceProcessor>(
+            std::make_shared<TPostServiceHandler>(
+                backend_filepath, microservice_connection_pool_min_size,
+                microservice_connection_pool_max_size,
+                microservice_connection_pool_allow_ephemeral,
+                postgres_connection_pool_min_size,
+                postgres_connection_pool_max_size,
+                postgres_connection_pool_allow_ephemeral, postgres_user,
+                postgres_password, group_commit_window_us,
+                group_commit_max_batch_size, partition_days, logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
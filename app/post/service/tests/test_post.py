@@ -127,6 +127,41 @@ class TestService(unittest.TestCase):
       self.assertEqual(1, len(retrieved_posts))
       self.assertEqual(post.id, retrieved_posts[0].id)
 
+  def test_list_posts_page(self):
+    with PostClient(IP_ADDRESS, POST_PORT) as client:
+      # Create posts by authors whose posts are on different shards.
+      posts = [
+          client.create_post(
+              TRequestMetadata(id=random_id(), requester_id=account.id),
+              "Lorem ipsum") for account in self._accounts
+      ]
+      # Walk the first pages of all posts, merged across shards, and check
+      # that they start with these posts, newest first.
+      query = TPostQuery()
+      limit = 2
+      first_page = client.list_posts_page(
+          TRequestMetadata(id=random_id(), requester_id=self._accounts[0].id),
+          query, limit, "")
+      self.assertEqual([posts[2].id, posts[1].id],
+                       [post.id for post in first_page.posts])
+      self.assertIsNotNone(first_page.next_cursor)
+      second_page = client.list_posts_page(
+          TRequestMetadata(id=random_id(), requester_id=self._accounts[0].id),
+          query, limit, first_page.next_cursor)
+      self.assertEqual(posts[0].id, second_page.posts[0].id)
+      # Check that the last page has no cursor.
+      query = TPostQuery(author_id=self._accounts[2].id)
+      last_page = client.list_posts_page(
+          TRequestMetadata(id=random_id(), requester_id=self._accounts[2].id),
+          query, limit, "")
+      self.assertEqual([posts[2].id], [post.id for post in last_page.posts])
+      self.assertIsNone(last_page.next_cursor)
+      # Check that invalid cursors are rejected.
+      with self.assertRaises(TInvalidCursorException):
+        client.list_posts_page(
+            TRequestMetadata(id=random_id(), requester_id=self._accounts[0].id),
+            query, limit, "not a cursor")
+
   def test_count_posts_by_author(self):
     with PostClient(IP_ADDRESS, POST_PORT) as client:
       # Check the number of posts.
@@ -10,11 +10,14 @@
 using namespace gen;
 
 namespace trending_service {
-class Client : public BaseClient<TTrendingServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TTrendingServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TTrendingServiceClient>(ip_address, port, conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TTrendingServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   void process_post(const TRequestMetadata& request_metadata,
                     const std::string& text) {
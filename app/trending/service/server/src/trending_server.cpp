@@ -1,12 +1,13 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
 #include <buzzblog/gen/TTrendingService.h>
 #include <buzzblog/microservice_connected_server.h>
 #include <buzzblog/redis_connected_server.h>
+#include <buzzblog/thrift_server.h>
 #include <buzzblog/utils.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
@@ -42,10 +43,8 @@ class TTrendingServiceHandler : public MicroserviceConnectedServer,
             microservice_connection_pool_allow_ephemeral != 0, logging),
         RedisConnectedServer(backend_filepath, redis_connection_pool_size) {
     if (logging) {
-      _rpc_logger = spdlog::basic_logger_mt("rpc_logger", "/tmp/rpc.log");
-      _rpc_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
-      _redis_logger = spdlog::basic_logger_mt("redis_logger", "/tmp/redis.log");
-      _redis_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _rpc_logger = get_logger("rpc_logger", "/tmp/rpc.log");
+      _redis_logger = get_logger("redis_logger", "/tmp/redis.log");
     } else {
       _rpc_logger = nullptr;
       _redis_logger = nullptr;
@@ -54,6 +53,7 @@ class TTrendingServiceHandler : public MicroserviceConnectedServer,
 
   void process_post(const TRequestMetadata& request_metadata,
                     const std::string& text) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
     std::istringstream text_iss(text);
     do {
       std::string word;
@@ -80,6 +80,7 @@ class TTrendingServiceHandler : public MicroserviceConnectedServer,
   void fetch_trending_hashtags(std::vector<std::string>& _return,
                                const TRequestMetadata& request_metadata,
                                const int32_t limit) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
     _return = RPC_WRAPPER<std::vector<std::string>>(
         std::bind(&TTrendingServiceHandler::zrange<std::vector<std::string>>,
                   this, std::ref(request_metadata), "trending", "hashtags", 0,
@@ -98,6 +99,15 @@ int main(int argc, char** argv) {
       ("port", "", cxxopts::value<int>())
       ("threads", "", cxxopts::value<int>()->default_value("0"))
       ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
       ("backend_filepath", "",
           cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
       ("microservice_connection_pool_min_size", "",
@@ -116,6 +126,13 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
   std::string backend_filepath = result["backend_filepath"].as<std::string>();
   int microservice_connection_pool_min_size =
       result["microservice_connection_pool_min_size"].as<int>();
@@ -128,21 +145,23 @@ int main(int argc, char** argv) {
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(
-      std::make_shared<TTrendingServiceProcessor>(
-          std::make_shared<TTrendingServiceHandler>(
-              backend_filepath, microservice_connection_pool_min_size,
-              microservice_connection_pool_max_size,
-              microservice_connection_pool_allow_ephemeral,
-              redis_connection_pool_size, logging)),
-      socket, std::make_shared<TBufferedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TTrendingServiceProcessor>(
+            std::make_shared<TTrendingServiceHandler>(
+                backend_filepath, microservice_connection_pool_min_size,
+                microservice_connection_pool_max_size,
+                microservice_connection_pool_allow_ephemeral,
+                redis_connection_pool_size, logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
@@ -1,16 +1,27 @@
 -- Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 -- Systems
 
+-- Domains of unique pairs (e.g., "follow" and "like"), which unique pairs
+-- refer to by id, so that rows and index entries hold a small integer instead
+-- of a string. The uniquepair service caches the registry and adds domains to
+-- it as unique pairs of new domains are added.
+CREATE TABLE Domains(
+  id SMALLSERIAL PRIMARY KEY,
+  name VARCHAR(32) UNIQUE NOT NULL
+);
+
 CREATE TABLE Uniquepairs(
-  id SERIAL PRIMARY KEY, 
+  id BIGINT PRIMARY KEY, 
   created_at INTEGER NOT NULL,
-  domain VARCHAR(32) NOT NULL,
-  first_elem INTEGER NOT NULL,
-  second_elem INTEGER NOT NULL,
-  UNIQUE(domain, first_elem, second_elem)
+  domain_id SMALLINT NOT NULL,
+  first_elem BIGINT NOT NULL,
+  second_elem BIGINT NOT NULL,
+  -- Also finds and counts unique pairs by both elements off the index alone.
+  UNIQUE(domain_id, first_elem, second_elem) INCLUDE (id, created_at)
 );
 
-CREATE INDEX idx_created_at ON Uniquepairs(created_at);
-CREATE INDEX idx_first_elem ON Uniquepairs(domain, first_elem);
-CREATE INDEX idx_second_elem ON Uniquepairs(domain, second_elem);
-CREATE INDEX idx_first_and_second_elem ON Uniquepairs(domain, first_elem, second_elem);
+-- Unique pairs are fetched by descending id, which is reverse chronological
+-- order, so that pages are read in order off the index instead of sorting all
+-- unique pairs of an element, and counts are read off the index alone.
+CREATE INDEX idx_first_elem_id ON Uniquepairs(domain_id, first_elem, id);
+CREATE INDEX idx_second_elem_id ON Uniquepairs(domain_id, second_elem, id);
@@ -9,35 +9,37 @@
 using namespace gen;
 
 namespace uniquepair_service {
-class Client : public BaseClient<TUniquepairServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TUniquepairServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TUniquepairServiceClient>(ip_address, port,
-                                             conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TUniquepairServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   TUniquepair get(const TRequestMetadata& request_metadata,
-                  const int32_t uniquepair_id) {
+                  const int64_t uniquepair_id) {
     TUniquepair _return;
     _client->get(_return, request_metadata, uniquepair_id);
     return _return;
   }
 
   TUniquepair add(const TRequestMetadata& request_metadata,
-                  const std::string& domain, const int32_t first_elem,
-                  const int32_t second_elem) {
+                  const std::string& domain, const int64_t first_elem,
+                  const int64_t second_elem) {
     TUniquepair _return;
     _client->add(_return, request_metadata, domain, first_elem, second_elem);
     return _return;
   }
 
   void remove(const TRequestMetadata& request_metadata,
-              const int32_t uniquepair_id) {
+              const int64_t uniquepair_id) {
     _client->remove(request_metadata, uniquepair_id);
   }
 
   bool find(const TRequestMetadata& request_metadata, const std::string& domain,
-            const int32_t first_elem, const int32_t second_elem) {
+            const int64_t first_elem, const int64_t second_elem) {
     return _client->find(request_metadata, domain, first_elem, second_elem);
   }
 
@@ -49,6 +51,14 @@ class Client : public BaseClient<TUniquepairServiceClient> {
     return _return;
   }
 
+  TUniquepairPage fetch_page(const TRequestMetadata& request_metadata,
+                             const TUniquepairQuery& query,
+                             const int32_t limit, const std::string& cursor) {
+    TUniquepairPage _return;
+    _client->fetch_page(_return, request_metadata, query, limit, cursor);
+    return _return;
+  }
+
   int32_t count(const TRequestMetadata& request_metadata,
                 const TUniquepairQuery& query) {
     return _client->count(request_metadata, query);
@@ -7,9 +7,14 @@ from buzzblog.base_client import BaseClient
 
 class Client(BaseClient):
 
-  def __init__(self, ip_address, port, timeout=30000, connection_pool=None):
+  def __init__(self,
+               ip_address,
+               port,
+               timeout=30000,
+               connection_pool=None,
+               framed=False):
     super().__init__(TUniquepairService.Client, ip_address, port, timeout,
-                     connection_pool)
+                     connection_pool, framed)
 
   def get(self, request_metadata, uniquepair_id):
     return self._tclient.get(request_metadata=request_metadata,
@@ -37,5 +42,11 @@ class Client(BaseClient):
                                limit=limit,
                                offset=offset)
 
+  def fetch_page(self, request_metadata, query, limit, cursor):
+    return self._tclient.fetch_page(request_metadata=request_metadata,
+                                    query=query,
+                                    limit=limit,
+                                    cursor=cursor)
+
   def count(self, request_metadata, query):
     return self._tclient.count(request_metadata=request_metadata, query=query)
@@ -0,0 +1,131 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#ifndef UNIQUEPAIR_COLUMNAR__H
+#define UNIQUEPAIR_COLUMNAR__H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Writes unique pairs to a columnar file, in chunks of up to `chunk_size`
+ * pairs, so that memory use does not depend on the number of pairs. The file
+ * starts with the 8-byte magic "BBPAIRS1". Each chunk has its number of pairs
+ * (uint32), then the first elements of its pairs (int64 each), their second
+ * elements (int64 each), and their creation times (int32 each), all
+ * little-endian. A chunk of 0 pairs ends the file.
+ */
+class ColumnarWriter {
+ private:
+  std::ofstream _file;
+  size_t _chunk_size;
+  std::vector<int64_t> _first_elems;
+  std::vector<int64_t> _second_elems;
+  std::vector<int32_t> _created_ats;
+
+  // Writes the lowest `size` bytes of a value, little-endian.
+  void write(const uint64_t value, const int size) {
+    char bytes[8];
+    for (int i = 0; i < size; i++) bytes[i] = (value >> (8 * i)) & 0xff;
+    _file.write(bytes, size);
+  }
+
+  void write_chunk() {
+    write(_first_elems.size(), 4);
+    for (auto first_elem : _first_elems) write(first_elem, 8);
+    for (auto second_elem : _second_elems) write(second_elem, 8);
+    for (auto created_at : _created_ats) write(created_at, 4);
+    _first_elems.clear();
+    _second_elems.clear();
+    _created_ats.clear();
+  }
+
+ public:
+  ColumnarWriter(const std::string& filepath, const size_t chunk_size) {
+    _file.open(filepath, std::ios::binary | std::ios::trunc);
+    if (!_file) throw std::runtime_error("Could not open " + filepath);
+    _chunk_size = chunk_size;
+    _first_elems.reserve(chunk_size);
+    _second_elems.reserve(chunk_size);
+    _created_ats.reserve(chunk_size);
+    _file.write("BBPAIRS1", 8);
+  }
+
+  void add(const int64_t first_elem, const int64_t second_elem,
+           const int32_t created_at) {
+    _first_elems.push_back(first_elem);
+    _second_elems.push_back(second_elem);
+    _created_ats.push_back(created_at);
+    if (_first_elems.size() >= _chunk_size) write_chunk();
+  }
+
+  /* Writes the pairs left and the end of the file. */
+  void close() {
+    if (!_first_elems.empty()) write_chunk();
+    write(0, 4);
+    _file.close();
+    if (!_file) throw std::runtime_error("Could not write pairs");
+  }
+};
+
+/* Parses the output of `COPY (SELECT first_elem, second_elem, created_at ...)
+ * TO STDOUT (FORMAT binary)` one row at a time, as libpq returns it: the
+ * first row is preceded by the header of the output, and the last one is its
+ * trailer. Integers are big-endian, and each field is preceded by its length.
+ */
+class PairCopyParser {
+ private:
+  static constexpr char kSignature[] = "PGCOPY\n\377\r\n";
+
+  bool _header_read;
+
+  // Reads a signed big-endian integer of `size` bytes.
+  static int64_t read(const char*& data, const char* end, const int size) {
+    if (end - data < size) throw std::runtime_error("Truncated COPY row");
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) value = (value << 8) | uint8_t(*data++);
+    if (size < 8 && (value >> (8 * size - 1)) & 1)
+      value |= ~uint64_t(0) << (8 * size);
+    return int64_t(value);
+  }
+
+  // Reads a non-null integer field of `size` bytes.
+  static int64_t read_field(const char*& data, const char* end,
+                            const int size) {
+    if (read(data, end, 4) != size)
+      throw std::runtime_error("Unexpected COPY field length");
+    return read(data, end, size);
+  }
+
+ public:
+  PairCopyParser() { _header_read = false; }
+
+  void parse(const char* data, const int size, ColumnarWriter* writer) {
+    const char* end = data + size;
+    if (!_header_read) {
+      // Skip the signature, flags, and header extension.
+      if (size < int(sizeof(kSignature)) ||
+          std::memcmp(data, kSignature, sizeof(kSignature)) != 0)
+        throw std::runtime_error("Invalid COPY signature");
+      data += sizeof(kSignature);
+      read(data, end, 4);
+      auto extension_size = read(data, end, 4);
+      if (end - data < extension_size)
+        throw std::runtime_error("Truncated COPY header");
+      data += extension_size;
+      _header_read = true;
+    }
+    auto n_fields = read(data, end, 2);
+    if (n_fields == -1) return;  // Trailer.
+    if (n_fields != 3) throw std::runtime_error("Unexpected COPY row");
+    auto first_elem = read_field(data, end, 8);
+    auto second_elem = read_field(data, end, 8);
+    auto created_at = read_field(data, end, 4);
+    writer->add(first_elem, second_elem, created_at);
+  }
+};
+
+#endif
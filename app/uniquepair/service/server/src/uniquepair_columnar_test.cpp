@@ -0,0 +1,115 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "uniquepair_columnar.h"
+
+// Appends the lowest `size` bytes of a value, big-endian.
+void put_be(std::string* bytes, const uint64_t value, const int size) {
+  for (int i = size - 1; i >= 0; i--)
+    bytes->push_back((value >> (8 * i)) & 0xff);
+}
+
+// Appends the lowest `size` bytes of a value, little-endian.
+void put_le(std::string* bytes, const uint64_t value, const int size) {
+  for (int i = 0; i < size; i++) bytes->push_back((value >> (8 * i)) & 0xff);
+}
+
+// Returns the header of a binary COPY output, with a header extension.
+std::string copy_header() {
+  std::string bytes("PGCOPY\n\377\r\n", 11);
+  put_be(&bytes, 0, 4);
+  put_be(&bytes, 2, 4);
+  bytes += "xx";
+  return bytes;
+}
+
+// Returns a row of a binary COPY output.
+std::string copy_row(const int64_t first_elem, const int64_t second_elem,
+                     const int32_t created_at) {
+  std::string bytes;
+  put_be(&bytes, 3, 2);
+  put_be(&bytes, 8, 4);
+  put_be(&bytes, first_elem, 8);
+  put_be(&bytes, 8, 4);
+  put_be(&bytes, second_elem, 8);
+  put_be(&bytes, 4, 4);
+  put_be(&bytes, created_at, 4);
+  return bytes;
+}
+
+// Returns the trailer of a binary COPY output.
+std::string copy_trailer() {
+  std::string bytes;
+  put_be(&bytes, uint16_t(-1), 2);
+  return bytes;
+}
+
+// Parses COPY rows, as libpq returns them, into a columnar file with chunks
+// of `chunk_size` pairs, and returns the contents of the file.
+std::string round_trip(const std::vector<std::string>& rows,
+                       const size_t chunk_size) {
+  const std::string filepath = "/tmp/uniquepair_columnar_test.bin";
+  ColumnarWriter writer(filepath, chunk_size);
+  PairCopyParser parser;
+  for (const auto& row : rows) parser.parse(row.data(), row.size(), &writer);
+  writer.close();
+  std::ifstream file(filepath, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+int failures = 0;
+
+void check(const std::string& name, const std::string& actual,
+           const std::string& expected) {
+  if (actual == expected) return;
+  std::cerr << name << ": unexpected columnar file" << std::endl;
+  failures++;
+}
+
+int main() {
+  // An empty result is its header and trailer, in a single row.
+  std::string expected("BBPAIRS1", 8);
+  put_le(&expected, 0, 4);
+  check("empty", round_trip({copy_header() + copy_trailer()}, 2), expected);
+
+  // Several pairs, including negative values, span a partial last chunk.
+  expected = std::string("BBPAIRS1", 8);
+  put_le(&expected, 2, 4);
+  put_le(&expected, 1, 8);
+  put_le(&expected, -3, 8);
+  put_le(&expected, 2, 8);
+  put_le(&expected, 4, 8);
+  put_le(&expected, 1600000000, 4);
+  put_le(&expected, -5, 4);
+  put_le(&expected, 1, 4);
+  put_le(&expected, int64_t(1) << 40, 8);
+  put_le(&expected, -1, 8);
+  put_le(&expected, -2147483648, 4);
+  put_le(&expected, 0, 4);
+  check("rows",
+        round_trip({copy_header() + copy_row(1, 2, 1600000000),
+                    copy_row(-3, 4, -5),
+                    copy_row(int64_t(1) << 40, -1, -2147483648),
+                    copy_trailer()},
+                   2),
+        expected);
+
+  // Truncated rows are rejected.
+  try {
+    round_trip({copy_header() + copy_row(1, 2, 3).substr(0, 10)}, 2);
+    std::cerr << "truncated: no error" << std::endl;
+    failures++;
+  } catch (const std::runtime_error&) {
+  }
+
+  if (failures == 0) std::cout << "uniquepair_columnar_test: OK" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#include <buzzblog/async_rpc.h>
+#include <buzzblog/postgres_connected_server.h>
+
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+
+#include "uniquepair_columnar.h"
+
+using namespace gen;
+
+class UniquepairExporter : public PostgresConnectedServer {
+ public:
+  UniquepairExporter(const std::string& backend_filepath,
+                     const std::string& postgres_user,
+                     const std::string& postgres_password, const int logging)
+      : PostgresConnectedServer("uniquepair", backend_filepath, 0, 2, false,
+                                postgres_user, postgres_password, true,
+                                logging) {
+    // Read from the primary, like list_domains in the server, so that a
+    // lagging replica does not make a shard storing the domain look empty.
+    prepare("find_domain",
+            "SELECT id "
+            "FROM Domains "
+            "WHERE name = $1",
+            PRIMARY_READ_QUERY);
+  }
+
+  /* Writes the unique pairs of a domain to `writer`, one shard after another,
+   * and returns their number.
+   */
+  int64_t export_domain(const std::string& domain, ColumnarWriter* writer) {
+    int64_t n_pairs = 0;
+    for (int shard = 0; shard < shard_count("uniquepair"); shard++) {
+      auto dbname = shard_dbname("uniquepair", shard);
+      auto db_res = run_prepared("find_domain", dbname, TRequestMetadata(),
+                                 "export_domain", domain);
+      // Shards that never stored a pair of the domain do not know it.
+      if (db_res.begin() == db_res.end()) continue;
+      PairCopyParser parser;
+      n_pairs += copy_out(
+          dbname,
+          "COPY (SELECT first_elem, second_elem, created_at "
+          "FROM Uniquepairs WHERE domain_id = " +
+              std::to_string(db_res[0]["id"].as<int>()) +
+              ") TO STDOUT (FORMAT binary)",
+          [&](const char* row, int size) { parser.parse(row, size, writer); });
+    }
+    return n_pairs;
+  }
+};
+
+int main(int argc, char** argv) {
+  // Define command-line parameters.
+  cxxopts::Options options("uniquepair_export",
+                           "Export of the unique pairs of a domain");
+  options.add_options()
+      ("backend_filepath", "",
+          cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
+      ("postgres_user", "",
+          cxxopts::value<std::string>()->default_value("postgres"))
+      ("postgres_password", "",
+          cxxopts::value<std::string>()->default_value("postgres"))
+      ("domain", "", cxxopts::value<std::string>())
+      ("output", "", cxxopts::value<std::string>())
+      ("chunk_size", "", cxxopts::value<int>()->default_value("65536"))
+      ("logging", "", cxxopts::value<int>()->default_value("0"));
+
+  // Parse command-line arguments.
+  auto result = options.parse(argc, argv);
+  std::string backend_filepath = result["backend_filepath"].as<std::string>();
+  std::string postgres_user = result["postgres_user"].as<std::string>();
+  std::string postgres_password = result["postgres_password"].as<std::string>();
+  std::string domain = result["domain"].as<std::string>();
+  std::string output = result["output"].as<std::string>();
+  int chunk_size = result["chunk_size"].as<int>();
+  int logging = result["logging"].as<int>();
+
+  // Export unique pairs.
+  EventLoop::configure(1);
+  UniquepairExporter exporter(backend_filepath, postgres_user,
+                              postgres_password, logging);
+  ColumnarWriter writer(output, chunk_size);
+  auto n_pairs = exporter.export_domain(domain, &writer);
+  writer.close();
+  std::cout << "domain=" << domain << " pairs=" << n_pairs
+            << " output=" << output << std::endl;
+
+  return 0;
+}
@@ -1,17 +1,27 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
 #include <buzzblog/gen/TUniquepairService.h>
+#include <buzzblog/group_commit.h>
+#include <buzzblog/id_generator.h>
 #include <buzzblog/postgres_connected_server.h>
+#include <buzzblog/slow_query_log.h>
+#include <buzzblog/thrift_server.h>
 #include <buzzblog/utils.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
+#include <cstdint>
 #include <cxxopts.hpp>
-#include <sstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
@@ -23,16 +33,272 @@ using namespace gen;
 class TUniquepairServiceHandler : public PostgresConnectedServer,
                                   public TUniquepairServiceIf {
  private:
+  // Unique pair to be added by a group commit.
+  struct PendingPair {
+    int64_t id;
+    int domain_id;
+    int64_t first_elem;
+    int64_t second_elem;
+    int64_t deadline_ms;
+  };
+
+  // Outcome of adding a unique pair, which was not added if it existed.
+  struct AddedPair {
+    bool added;
+    int64_t id;
+    int32_t created_at;
+  };
+
+  // Time (in milliseconds) after loading the domain registry of a shard
+  // during which domains missing from it are taken as unregistered, instead
+  // of loading it again for every query on them.
+  static constexpr int64_t kDomainsReloadMs = 1000;
+
   std::shared_ptr<spdlog::logger> _query_logger;
+  // Number of shards of the database.
+  int _n_shards;
+  // Group committers of added pairs, one per shard.
+  std::vector<std::unique_ptr<GroupCommitter<PendingPair, AddedPair>>>
+      _add_committers;
+  // Cached domain registries of shards, by shard name: domain ids by name,
+  // domain names by id, and when they were last loaded (ms since epoch).
+  std::map<std::string, std::map<std::string, int>> _domain_ids;
+  std::map<std::string, std::map<int, std::string>> _domain_names;
+  std::map<std::string, int64_t> _domains_loaded_ms;
+  std::mutex _domains_mutex;
+
+  // Returns the shard holding the unique pairs with the given domain and first
+  // element.
+  int shard_of(const std::string& domain, const int64_t first_elem) {
+    // Hash with FNV-1a, which is the same across processes and builds.
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const uint8_t byte) {
+      hash = (hash ^ byte) * 1099511628211ULL;
+    };
+    for (char c : domain) mix(c);
+    for (int i = 0; i < 8; i++) mix(uint64_t(first_elem) >> (8 * i));
+    return hash % _n_shards;
+  }
+
+  // Returns the shard holding the unique pair with the given id. Ids are
+  // generated so that they are congruent to their shard modulo the number of
+  // shards.
+  int shard_of(const int64_t uniquepair_id) {
+    return (uniquepair_id % _n_shards + _n_shards) % _n_shards;
+  }
+
+  // Caches the domain registry of a shard, as listed by list_domains.
+  template <typename Result>
+  void cache_domains(const std::string& dbname, const Result& db_res) {
+    std::lock_guard<std::mutex> lock(_domains_mutex);
+    for (size_t i = 0; i < db_res.size(); i++) {
+      auto id = db_res[i]["id"].template as<int>();
+      auto name = db_res[i]["name"].template as<std::string>();
+      _domain_ids[dbname][name] = id;
+      _domain_names[dbname][id] = name;
+    }
+    _domains_loaded_ms[dbname] = now_ms();
+  }
+
+  // Returns the cached id of a domain in the registry of a shard, -1 if the
+  // domain is missing from the registry loaded in the last kDomainsReloadMs
+  // milliseconds, or nothing if the registry must be loaded again. Domains are
+  // never removed, so cached ids stay valid.
+  std::optional<int> cached_domain_id(const std::string& dbname,
+                                      const std::string& domain) {
+    std::lock_guard<std::mutex> lock(_domains_mutex);
+    auto& ids = _domain_ids[dbname];
+    auto it = ids.find(domain);
+    if (it != ids.end()) return it->second;
+    auto loaded = _domains_loaded_ms.find(dbname);
+    if (loaded != _domains_loaded_ms.end() &&
+        now_ms() - loaded->second < kDomainsReloadMs)
+      return -1;
+    return std::nullopt;
+  }
+
+  // Returns the id of a domain in the registry of a shard. Domains missing
+  // from the registry are added to it if `add` is set; otherwise, their id is
+  // -1, which no unique pair has.
+  int get_domain_id(const std::string& dbname, const std::string& domain,
+                    const TRequestMetadata& request_metadata,
+                    const std::string& lf, const bool add) {
+    auto cached_id = cached_domain_id(dbname, domain);
+    if (!cached_id) {
+      cache_domains(dbname,
+                    run_prepared("list_domains", dbname, request_metadata, lf));
+      cached_id = cached_domain_id(dbname, domain).value_or(-1);
+    }
+    if (*cached_id >= 0 || !add) return *cached_id;
+    auto db_res =
+        run_prepared("add_domain", dbname, request_metadata, lf, domain);
+    int id = db_res[0][0].as<int>();
+    std::lock_guard<std::mutex> lock(_domains_mutex);
+    _domain_ids[dbname][domain] = id;
+    _domain_names[dbname][id] = domain;
+    return id;
+  }
 
-  std::string build_where_clause(const TUniquepairQuery& query) {
-    std::ostringstream where_clause;
-    where_clause << "domain = '" << query.domain << "'";
+  // Returns the id of a domain in the registry of a shard, without adding
+  // it, as a coroutine that loads the registry on a non-blocking connection,
+  // so that queries on every shard load their registries concurrently.
+  // Parameters are copied, but the request metadata must outlive the task.
+  Task<int> co_get_domain_id(const std::string dbname, const std::string domain,
+                             const TRequestMetadata& request_metadata,
+                             const std::string lf) {
+    auto id = cached_domain_id(dbname, domain);
+    if (id) co_return *id;
+    cache_domains(dbname, co_await co_run_prepared("list_domains", dbname,
+                                                   request_metadata, lf));
+    co_return cached_domain_id(dbname, domain).value_or(-1);
+  }
+
+  // Returns the name of a domain from its id in the registry of a shard. The
+  // registry is loaded again if the id is not cached, however recently it was
+  // loaded, since unique pairs only refer to registered domains.
+  std::string get_domain_name(const std::string& dbname, const int id,
+                              const TRequestMetadata& request_metadata,
+                              const std::string& lf) {
+    for (bool loaded : {false, true}) {
+      {
+        std::lock_guard<std::mutex> lock(_domains_mutex);
+        auto& names = _domain_names[dbname];
+        auto it = names.find(id);
+        if (it != names.end()) return it->second;
+      }
+      if (!loaded)
+        cache_domains(dbname, run_prepared("list_domains", dbname,
+                                           request_metadata, lf));
+    }
+    throw std::runtime_error("Unknown domain id " + std::to_string(id) +
+                             " in " + dbname);
+  }
+
+  // Builds a unique pair of a domain from its row.
+  static TUniquepair build_uniquepair(const std::string& domain,
+                                      const AsyncPostgresRow& row) {
+    TUniquepair uniquepair;
+    uniquepair.id = row["id"].as<int64_t>();
+    uniquepair.created_at = row["created_at"].as<int>();
+    uniquepair.domain = domain;
+    uniquepair.first_elem = row["first_elem"].as<int64_t>();
+    uniquepair.second_elem = row["second_elem"].as<int64_t>();
+    return uniquepair;
+  }
+
+  // Returns the suffix of the name of the statement variant that filters
+  // unique pairs by domain and by the given elements.
+  static std::string filter_suffix(const bool by_first_elem,
+                                   const bool by_second_elem) {
+    if (by_first_elem && by_second_elem) return "_by_elems";
+    if (by_first_elem) return "_by_first_elem";
+    if (by_second_elem) return "_by_second_elem";
+    return "";
+  }
+
+  // Returns the condition that filters unique pairs by domain id and by the
+  // given elements, with parameters numbered from `param`.
+  static std::string filter_condition(const bool by_first_elem,
+                                      const bool by_second_elem, int param) {
+    std::string condition = "domain_id = $" + std::to_string(param++);
+    if (by_first_elem)
+      condition += " AND first_elem = $" + std::to_string(param++);
+    if (by_second_elem)
+      condition += " AND second_elem = $" + std::to_string(param++);
+    return condition;
+  }
+
+  // Runs the variant of a statement that filters unique pairs by the fields
+  // set in a query on a shard, with parameters following `args`, once the id
+  // of the domain on the shard is known. Parameters are copied, but the
+  // request metadata and query must outlive the task.
+  template <typename... Args>
+  Task<AsyncPostgresResult> run_filtered(
+      const std::string statement, const std::string dbname,
+      const TRequestMetadata& request_metadata, const std::string lf,
+      const TUniquepairQuery& query, const Args... args) {
+    auto name = statement + filter_suffix(query.__isset.first_elem,
+                                          query.__isset.second_elem);
+    auto domain_id =
+        co_await co_get_domain_id(dbname, query.domain, request_metadata, lf);
+    if (query.__isset.first_elem && query.__isset.second_elem)
+      co_return co_await co_run_prepared(name, dbname, request_metadata, lf,
+                                         args..., domain_id, query.first_elem,
+                                         query.second_elem);
     if (query.__isset.first_elem)
-      where_clause << " AND first_elem = " << query.first_elem;
+      co_return co_await co_run_prepared(name, dbname, request_metadata, lf,
+                                         args..., domain_id, query.first_elem);
     if (query.__isset.second_elem)
-      where_clause << " AND second_elem = " << query.second_elem;
-    return where_clause.str();
+      co_return co_await co_run_prepared(name, dbname, request_metadata, lf,
+                                         args..., domain_id,
+                                         query.second_elem);
+    co_return co_await co_run_prepared(name, dbname, request_metadata, lf,
+                                       args..., domain_id);
+  }
+
+  // Runs the variant of a statement that filters unique pairs by the fields
+  // set in a query, on the shard holding them if the query sets the first
+  // element, or on every shard otherwise. Statements run on non-blocking
+  // connections, so that queries on all shards take no thread but the
+  // caller's.
+  template <typename... Args>
+  std::vector<AsyncPostgresResult> run_sharded(
+      const std::string& statement, const TRequestMetadata& request_metadata,
+      const std::string& lf, const TUniquepairQuery& query,
+      const Args&... args) {
+    if (query.__isset.first_elem || _n_shards == 1) {
+      auto dbname = shard_dbname(
+          "uniquepair",
+          query.__isset.first_elem ? shard_of(query.domain, query.first_elem)
+                                   : 0);
+      return {sync_wait(run_filtered(statement, dbname, request_metadata, lf,
+                                     query, args...))};
+    }
+    return scatter_async("uniquepair", [&](const std::string& dbname) {
+      return run_filtered(statement, dbname, request_metadata, lf, query,
+                          args...);
+    });
+  }
+
+  // Adds a batch of unique pairs to a shard with a single statement. Pairs
+  // that already exist, including those repeated in the batch, are not added.
+  std::vector<AddedPair> add_batch(const int shard,
+                                   const std::vector<PendingPair>& pairs) {
+    std::vector<int64_t> ids;
+    std::vector<int> domain_ids;
+    std::vector<int64_t> first_elems;
+    std::vector<int64_t> second_elems;
+    std::vector<int64_t> deadlines_ms;
+    for (const auto& pair : pairs) {
+      ids.push_back(pair.id);
+      domain_ids.push_back(pair.domain_id);
+      first_elems.push_back(pair.first_elem);
+      second_elems.push_back(pair.second_elem);
+      deadlines_ms.push_back(pair.deadline_ms);
+    }
+    TRequestMetadata batch_metadata;
+    auto deadline_ms = latest_deadline(deadlines_ms);
+    if (deadline_ms > 0) batch_metadata.__set_deadline(deadline_ms);
+
+    // Execute query.
+    auto db_res = run_prepared(
+        "add_batch", shard_dbname("uniquepair", shard), batch_metadata, "add",
+        array_literal(ids), array_literal(domain_ids),
+        array_literal(first_elems), array_literal(second_elems));
+
+    // Match added rows to pairs by id.
+    std::map<int64_t, int32_t> created_at;
+    for (auto row : db_res)
+      created_at[row["id"].as<int64_t>()] = row["created_at"].as<int>();
+    std::vector<AddedPair> added;
+    for (const auto& pair : pairs) {
+      auto it = created_at.find(pair.id);
+      if (it == created_at.end())
+        added.push_back({false, 0, 0});
+      else
+        added.push_back({true, pair.id, it->second});
+    }
+    return added;
   }
 
  public:
@@ -42,34 +308,125 @@ class TUniquepairServiceHandler : public PostgresConnectedServer,
                             const int postgres_connection_pool_allow_ephemeral,
                             const std::string& postgres_user,
                             const std::string& postgres_password,
+                            const int group_commit_window_us,
+                            const int group_commit_max_batch_size,
                             const int logging)
       : PostgresConnectedServer("uniquepair", backend_filepath,
                                 postgres_connection_pool_min_size,
                                 postgres_connection_pool_max_size,
                                 postgres_connection_pool_allow_ephemeral != 0,
-                                postgres_user, postgres_password, logging) {
+                                postgres_user, postgres_password, true,
+                                logging) {
+    std::shared_ptr<spdlog::logger> group_commit_logger;
     if (logging) {
-      _query_logger = spdlog::basic_logger_mt("query_logger", "/tmp/query.log");
-      _query_logger->set_pattern("[%Y-%m-%d %H:%M:%S.%f] pid=%P tid=%t %v");
+      _query_logger = get_logger("query_logger", "/tmp/query.log");
+      group_commit_logger =
+          get_logger("group_commit_logger", "/tmp/group_commit.log");
     } else {
       _query_logger = nullptr;
+      group_commit_logger = nullptr;
+    }
+
+    _n_shards = shard_count("uniquepair");
+
+    // Add unique pairs in groups, if enabled.
+    if (group_commit_window_us > 0) {
+      for (int shard = 0; shard < _n_shards; shard++)
+        _add_committers.push_back(
+            std::make_unique<GroupCommitter<PendingPair, AddedPair>>(
+                "ls=uniquepair lf=add db=" + shard_dbname("uniquepair", shard),
+                group_commit_window_us, group_commit_max_batch_size,
+                [this, shard](const std::vector<PendingPair>& pairs) {
+                  return add_batch(shard, pairs);
+                },
+                group_commit_logger));
+    }
+
+    // Declare prepared statements. Ids are generated by the service and sort by
+    // creation time. Unique pairs refer to their domain by its id in the
+    // domain registry of their shard.
+    // Domains are listed on the primary, which has every domain that pairs
+    // read from replicas refer to.
+    prepare("list_domains",
+            "SELECT id, name "
+            "FROM Domains",
+            PRIMARY_READ_QUERY);
+    prepare("add_domain",
+            "INSERT INTO Domains (name) "
+            "VALUES ($1) "
+            "ON CONFLICT (name) DO UPDATE SET name = EXCLUDED.name "
+            "RETURNING id",
+            WRITE_QUERY);
+    prepare("get",
+            "SELECT created_at, domain_id, first_elem, second_elem "
+            "FROM Uniquepairs "
+            "WHERE id = $1",
+            READ_QUERY);
+    prepare("add",
+            "INSERT INTO Uniquepairs (id, domain_id, first_elem, second_elem, "
+            "created_at) "
+            "VALUES ($1, $2, $3, $4, extract(epoch from now())) "
+            "RETURNING id, created_at",
+            WRITE_QUERY);
+    prepare("add_batch",
+            "INSERT INTO Uniquepairs (id, domain_id, first_elem, second_elem, "
+            "created_at) "
+            "SELECT id, domain_id, first_elem, second_elem, "
+            "extract(epoch from now()) "
+            "FROM unnest($1::bigint[], $2::smallint[], $3::bigint[], "
+            "$4::bigint[]) AS t(id, domain_id, first_elem, second_elem) "
+            "ON CONFLICT DO NOTHING "
+            "RETURNING id, created_at",
+            WRITE_QUERY);
+    prepare("remove",
+            "DELETE FROM Uniquepairs "
+            "WHERE id = $1 "
+            "RETURNING id",
+            WRITE_QUERY);
+    prepare("find",
+            "SELECT id, created_at "
+            "FROM Uniquepairs "
+            "WHERE domain_id = $1 AND first_elem = $2 AND second_elem = $3",
+            READ_QUERY);
+    for (bool by_first_elem : {false, true}) {
+      for (bool by_second_elem : {false, true}) {
+        auto suffix = filter_suffix(by_first_elem, by_second_elem);
+        prepare("fetch" + suffix,
+                "SELECT id, created_at, first_elem, second_elem "
+                "FROM Uniquepairs "
+                "WHERE " + filter_condition(by_first_elem, by_second_elem, 3) +
+                " ORDER BY id DESC "
+                "LIMIT $1 "
+                "OFFSET $2",
+                READ_QUERY);
+        prepare("fetch_before" + suffix,
+                "SELECT id, created_at, first_elem, second_elem "
+                "FROM Uniquepairs "
+                "WHERE id < $1 AND " +
+                    filter_condition(by_first_elem, by_second_elem, 3) +
+                " ORDER BY id DESC "
+                "LIMIT $2",
+                READ_QUERY);
+        prepare("count" + suffix,
+                "SELECT COUNT(*) "
+                "FROM Uniquepairs "
+                "WHERE " + filter_condition(by_first_elem, by_second_elem, 1),
+                READ_QUERY);
+      }
     }
   }
 
   void get(TUniquepair& _return, const TRequestMetadata& request_metadata,
-           const int32_t uniquepair_id) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT created_at, domain, first_elem, second_elem "
-        "FROM Uniquepairs "
-        "WHERE id = %d";
-    sprintf(query_str, query_fmt, uniquepair_id);
+           const int64_t uniquepair_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
+    auto dbname = shard_dbname("uniquepair", shard_of(uniquepair_id));
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TUniquepairServiceHandler::run_query, this,
-                  std::ref(query_str), "uniquepair"),
+        [&] {
+          return run_prepared("get", dbname, request_metadata, "get",
+                              uniquepair_id);
+        },
         _query_logger,
         "ls=uniquepair lf=get db=uniquepair qt=select rid=" +
             request_metadata.id);
@@ -80,57 +437,72 @@ class TUniquepairServiceHandler : public PostgresConnectedServer,
     // Build unique pair.
     _return.id = uniquepair_id;
     _return.created_at = db_res[0][0].as<int>();
-    _return.domain = db_res[0][1].as<std::string>();
-    _return.first_elem = db_res[0][2].as<int>();
-    _return.second_elem = db_res[0][3].as<int>();
+    _return.domain = get_domain_name(dbname, db_res[0][1].as<int>(),
+                                     request_metadata, "get");
+    _return.first_elem = db_res[0][2].as<int64_t>();
+    _return.second_elem = db_res[0][3].as<int64_t>();
   }
 
   void add(TUniquepair& _return, const TRequestMetadata& request_metadata,
-           const std::string& domain, const int32_t first_elem,
-           const int32_t second_elem) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "INSERT INTO Uniquepairs (domain, first_elem, second_elem, created_at) "
-        "VALUES ('%s', %d, %d, extract(epoch from now())) "
-        "RETURNING id, created_at";
-    sprintf(query_str, query_fmt, domain.c_str(), first_elem, second_elem);
+           const std::string& domain, const int64_t first_elem,
+           const int64_t second_elem) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
-    // Execute query.
-    pqxx::result db_res;
-    try {
-      db_res = RPC_WRAPPER<pqxx::result>(
-          std::bind(&TUniquepairServiceHandler::run_query, this,
-                    std::ref(query_str), "uniquepair"),
-          _query_logger,
-          "ls=uniquepair lf=add db=uniquepair qt=insert rid=" +
-              request_metadata.id);
-    } catch (pqxx::sql_error& e) {
-      throw TUniquepairAlreadyExistsException();
-    }
+    // Execute query on the shard of the pair, along with concurrent ones if
+    // group commit is enabled.
+    int shard = shard_of(domain, first_elem);
+    auto dbname = shard_dbname("uniquepair", shard);
+    auto uniquepair_id = IdGenerator::instance().next(shard, _n_shards);
+    auto domain_id =
+        get_domain_id(dbname, domain, request_metadata, "add", true);
+    auto added = RPC_WRAPPER<AddedPair>(
+        [&] {
+          // Batches skip pairs that already exist, so the error of a batch is
+          // never about the pair and reaches every request of it unchanged.
+          if (!_add_committers.empty()) {
+            auto pair = _add_committers[shard]->submit(
+                {uniquepair_id, domain_id, first_elem, second_elem,
+                 get_deadline(request_metadata)});
+            note_write(dbname, request_metadata);
+            return pair;
+          }
+          try {
+            auto db_res = run_prepared("add", dbname, request_metadata, "add",
+                                       uniquepair_id, domain_id, first_elem,
+                                       second_elem);
+            return AddedPair{true, db_res[0][0].as<int64_t>(),
+                             db_res[0][1].as<int>()};
+          } catch (pqxx::unique_violation& e) {
+            return AddedPair{false, 0, 0};
+          }
+        },
+        _query_logger,
+        "ls=uniquepair lf=add db=uniquepair qt=insert rid=" +
+            request_metadata.id);
+
+    // Check if unique pair was added.
+    if (!added.added) throw TUniquepairAlreadyExistsException();
 
     // Build unique pair.
-    _return.id = db_res[0][0].as<int>();
-    _return.created_at = db_res[0][1].as<int>();
+    _return.id = added.id;
+    _return.created_at = added.created_at;
     _return.domain = domain;
     _return.first_elem = first_elem;
     _return.second_elem = second_elem;
   }
 
   void remove(const TRequestMetadata& request_metadata,
-              const int32_t uniquepair_id) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "DELETE FROM Uniquepairs "
-        "WHERE id = %d "
-        "RETURNING id";
-    sprintf(query_str, query_fmt, uniquepair_id);
+              const int64_t uniquepair_id) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TUniquepairServiceHandler::run_query, this,
-                  std::ref(query_str), "uniquepair"),
+        [&] {
+          return run_prepared("remove",
+                              shard_dbname("uniquepair",
+                                           shard_of(uniquepair_id)),
+                              request_metadata, "remove", uniquepair_id);
+        },
         _query_logger,
         "ls=uniquepair lf=remove db=uniquepair qt=delete rid=" +
             request_metadata.id);
@@ -140,19 +512,18 @@ class TUniquepairServiceHandler : public PostgresConnectedServer,
   }
 
   bool find(const TRequestMetadata& request_metadata, const std::string& domain,
-            const int32_t first_elem, const int32_t second_elem) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT id, created_at "
-        "FROM Uniquepairs "
-        "WHERE domain = '%s' AND first_elem = %d AND second_elem = %d";
-    sprintf(query_str, query_fmt, domain.c_str(), first_elem, second_elem);
+            const int64_t first_elem, const int64_t second_elem) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
+    auto dbname = shard_dbname("uniquepair", shard_of(domain, first_elem));
     auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TUniquepairServiceHandler::run_query, this,
-                  std::ref(query_str), "uniquepair"),
+        [&] {
+          return run_prepared(
+              "find", dbname, request_metadata, "find",
+              get_domain_id(dbname, domain, request_metadata, "find", false),
+              first_elem, second_elem);
+        },
         _query_logger,
         "ls=uniquepair lf=find db=uniquepair qt=select rid=" +
             request_metadata.id);
@@ -165,58 +536,75 @@ class TUniquepairServiceHandler : public PostgresConnectedServer,
              const TRequestMetadata& request_metadata,
              const TUniquepairQuery& query, const int32_t limit,
              const int32_t offset) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT id, created_at, first_elem, second_elem "
-        "FROM Uniquepairs "
-        "WHERE %s "
-        "ORDER BY created_at DESC "
-        "LIMIT %d "
-        "OFFSET %d";
-    sprintf(query_str, query_fmt, build_where_clause(query).c_str(), limit,
-            offset);
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
-    // Execute query.
-    auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TUniquepairServiceHandler::run_query, this,
-                  std::ref(query_str), "uniquepair"),
+    // Execute query. Unless it runs on a single shard, every shard returns
+    // its first `offset + limit` pairs, which are merged.
+    auto db_results = RPC_WRAPPER<std::vector<AsyncPostgresResult>>(
+        [&] {
+          if (query.__isset.first_elem || _n_shards == 1)
+            return run_sharded("fetch", request_metadata, "fetch", query,
+                               limit, offset);
+          return run_sharded("fetch", request_metadata, "fetch", query,
+                             int64_t(limit) + offset, 0);
+        },
         _query_logger,
         "ls=uniquepair lf=fetch db=uniquepair qt=select rid=" +
             request_metadata.id);
 
     // Build unique pairs.
-    for (auto row : db_res) {
-      // Build unique pair.
-      TUniquepair uniquepair;
-      uniquepair.id = row["id"].as<int>();
-      uniquepair.created_at = row["created_at"].as<int>();
-      uniquepair.domain = query.domain;
-      uniquepair.first_elem = row["first_elem"].as<int>();
-      uniquepair.second_elem = row["second_elem"].as<int>();
-      _return.push_back(uniquepair);
-    }
+    auto rows = db_results.size() == 1
+                    ? std::vector<AsyncPostgresRow>(db_results[0].begin(),
+                                                    db_results[0].end())
+                    : merge_descending(db_results, "id", offset, limit);
+    for (const auto& row : rows)
+      _return.push_back(build_uniquepair(query.domain, row));
+  }
+
+  void fetch_page(TUniquepairPage& _return,
+                  const TRequestMetadata& request_metadata,
+                  const TUniquepairQuery& query, const int32_t limit,
+                  const std::string& cursor) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
+
+    // Execute query. Unless it runs on a single shard, every shard returns
+    // its first `limit` pairs before the cursor, which are merged.
+    auto before_id = decode_cursor(cursor);
+    auto db_results = RPC_WRAPPER<std::vector<AsyncPostgresResult>>(
+        [&] {
+          return run_sharded("fetch_before", request_metadata, "fetch_page",
+                             query, before_id, limit);
+        },
+        _query_logger,
+        "ls=uniquepair lf=fetch_page db=uniquepair qt=select rid=" +
+            request_metadata.id);
+
+    // Build page.
+    auto rows = merge_descending(db_results, "id", 0, limit);
+    for (const auto& row : rows)
+      _return.uniquepairs.push_back(build_uniquepair(query.domain, row));
+    if (limit > 0 && int32_t(rows.size()) == limit)
+      _return.__set_next_cursor(
+          encode_cursor(rows.back()["id"].as<int64_t>()));
   }
 
   int32_t count(const TRequestMetadata& request_metadata,
                 const TUniquepairQuery& query) {
-    // Build query string.
-    char query_str[1024];
-    const char* query_fmt =
-        "SELECT COUNT(*) "
-        "FROM Uniquepairs "
-        "WHERE %s";
-    sprintf(query_str, query_fmt, build_where_clause(query).c_str());
+    auto admission = AdmissionController::instance().admit(request_metadata);
 
     // Execute query.
-    auto db_res = RPC_WRAPPER<pqxx::result>(
-        std::bind(&TUniquepairServiceHandler::run_query, this,
-                  std::ref(query_str), "uniquepair"),
+    auto db_results = RPC_WRAPPER<std::vector<AsyncPostgresResult>>(
+        [&] {
+          return run_sharded("count", request_metadata, "count", query);
+        },
         _query_logger,
         "ls=uniquepair lf=count db=uniquepair qt=select rid=" +
             request_metadata.id);
 
-    return db_res[0][0].as<int>();
+    // Add up counts of all shards.
+    int32_t count = 0;
+    for (const auto& db_res : db_results) count += db_res[0][0].as<int>();
+    return count;
   }
 };
 
@@ -228,6 +616,16 @@ int main(int argc, char** argv) {
       ("port", "", cxxopts::value<int>())
       ("threads", "", cxxopts::value<int>()->default_value("0"))
       ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("query_event_loops", "", cxxopts::value<int>()->default_value("1"))
       ("backend_filepath", "",
           cxxopts::value<std::string>()->default_value("/etc/opt/BuzzBlog/backend.yml"))
       ("postgres_connection_pool_min_size", "",
@@ -240,6 +638,13 @@ int main(int argc, char** argv) {
           cxxopts::value<std::string>()->default_value("postgres"))
       ("postgres_password", "",
           cxxopts::value<std::string>()->default_value("postgres"))
+      ("slow_query_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("slow_query_explains_per_s", "",
+          cxxopts::value<int>()->default_value("1"))
+      ("group_commit_window_us", "", cxxopts::value<int>()->default_value("0"))
+      ("group_commit_max_batch_size", "",
+          cxxopts::value<int>()->default_value("64"))
+      ("node_id", "", cxxopts::value<std::string>())
       ("logging", "", cxxopts::value<int>()->default_value("1"));
 
   // Parse command-line arguments.
@@ -248,6 +653,14 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
+  int query_event_loops = result["query_event_loops"].as<int>();
   std::string backend_filepath = result["backend_filepath"].as<std::string>();
   int postgres_connection_pool_min_size =
       result["postgres_connection_pool_min_size"].as<int>();
@@ -257,24 +670,36 @@ int main(int argc, char** argv) {
       result["postgres_connection_pool_allow_ephemeral"].as<int>();
   std::string postgres_user = result["postgres_user"].as<std::string>();
   std::string postgres_password = result["postgres_password"].as<std::string>();
+  int slow_query_ms = result["slow_query_ms"].as<int>();
+  int slow_query_explains_per_s = result["slow_query_explains_per_s"].as<int>();
+  int group_commit_window_us = result["group_commit_window_us"].as<int>();
+  int group_commit_max_batch_size =
+      result["group_commit_max_batch_size"].as<int>();
+  std::string node_id = result["node_id"].as<std::string>();
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(
-      std::make_shared<TUniquepairServiceProcessor>(
-          std::make_shared<TUniquepairServiceHandler>(
-              backend_filepath, postgres_connection_pool_min_size,
-              postgres_connection_pool_max_size,
-              postgres_connection_pool_allow_ephemeral, postgres_user,
-              postgres_password, logging)),
-      socket, std::make_shared<TBufferedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  SlowQueryLog::configure(slow_query_ms, slow_query_explains_per_s, logging);
+  IdGenerator::configure(IdGenerator::parse_node_id(node_id));
+  EventLoop::configure(query_event_loops);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TUniquepairServiceProcessor>(
+            std::make_shared<TUniquepairServiceHandler>(
+                backend_filepath, postgres_connection_pool_min_size,
+                postgres_connection_pool_max_size,
+                postgres_connection_pool_allow_ephemeral, postgres_user,
+                postgres_password, group_commit_window_us,
+                group_commit_max_batch_size, logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
@@ -100,6 +100,34 @@ class TestService(unittest.TestCase):
       self.assertEqual(1, len(uniquepairs))
       self.assertEqual(self._uniquepair.id, uniquepairs[0].id)
 
+  def test_fetch_page(self):
+    with UniquepairClient(IP_ADDRESS, UNIQUEPAIR_PORT) as client:
+      # Add unique pairs of a new domain, on different shards.
+      domain = random_id(size=8)
+      uniquepairs = [
+          client.add(TRequestMetadata(id=random_id()), domain, random_int(),
+                     random_int()) for i in range(3)
+      ]
+      # Walk the pages of the domain and check that they hold these unique
+      # pairs, newest first, the last one without a cursor.
+      query = TUniquepairQuery(domain=domain)
+      limit = 2
+      cursor = ""
+      retrieved_uniquepairs = []
+      while cursor is not None:
+        page = client.fetch_page(TRequestMetadata(id=random_id()), query, limit,
+                                 cursor)
+        self.assertLessEqual(len(page.uniquepairs), limit)
+        retrieved_uniquepairs += page.uniquepairs
+        cursor = page.next_cursor
+      self.assertEqual(
+          [uniquepair.id for uniquepair in reversed(uniquepairs)],
+          [uniquepair.id for uniquepair in retrieved_uniquepairs])
+      # Check that invalid cursors are rejected.
+      with self.assertRaises(TInvalidCursorException):
+        client.fetch_page(TRequestMetadata(id=random_id()), query, limit,
+                          "not a cursor")
+
   def test_count(self):
     with UniquepairClient(IP_ADDRESS, UNIQUEPAIR_PORT) as client:
       # Check the number of unique pairs.
@@ -9,12 +9,14 @@
 using namespace gen;
 
 namespace wordfilter_service {
-class Client : public BaseClient<TWordfilterServiceClient> {
+// Client that threads can share to keep several requests in flight on one
+// connection. Responses are matched to requests by sequence id.
+class Client : public BaseClient<TWordfilterServiceConcurrentClient> {
  public:
   Client(const std::string& ip_address, const int port,
-         const int conn_timeout_ms)
-      : BaseClient<TWordfilterServiceClient>(ip_address, port,
-                                             conn_timeout_ms) {}
+         const int conn_timeout_ms, const bool framed)
+      : BaseClient<TWordfilterServiceConcurrentClient>(
+            ip_address, port, conn_timeout_ms, framed) {}
 
   bool is_valid_word(const TRequestMetadata& request_metadata,
                      const std::string& word) {
@@ -7,9 +7,14 @@ from buzzblog.base_client import BaseClient
 
 class Client(BaseClient):
 
-  def __init__(self, ip_address, port, timeout=30000, connection_pool=None):
+  def __init__(self,
+               ip_address,
+               port,
+               timeout=30000,
+               connection_pool=None,
+               framed=False):
     super().__init__(TWordfilterService.Client, ip_address, port, timeout,
-                     connection_pool)
+                     connection_pool, framed)
 
   def is_valid_word(self, request_metadata, word):
     return self._tclient.is_valid_word(request_metadata=request_metadata,
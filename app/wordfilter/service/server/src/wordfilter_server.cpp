@@ -1,9 +1,10 @@
 // Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
 // Systems
 
+#include <buzzblog/admission_control.h>
 #include <buzzblog/gen/TWordfilterService.h>
+#include <buzzblog/thrift_server.h>
 #include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TServerSocket.h>
 
@@ -28,6 +29,7 @@ class TWordfilterServiceHandler : public TWordfilterServiceIf {
 
   bool is_valid_word(const TRequestMetadata& request_metadata,
                      const std::string& word) {
+    auto admission = AdmissionController::instance().admit(request_metadata);
     for (auto invalid_word : invalid_words)
       if (word == invalid_word) return false;
     return true;
@@ -51,19 +53,22 @@ class TWordfilterServiceHandler : public TWordfilterServiceIf {
 int main(int argc, char** argv) {
   // Define command-line parameters.
   cxxopts::Options options("wordfilter_server", "Wordfilter server");
-  options.add_options()(
-      "host", "", cxxopts::value<std::string>()->default_value("0.0.0.0"))(
-      "port", "",
-      cxxopts::value<
-          int>())("threads", "",
-                  cxxopts::value<int>()->default_value(
-                      "0"))("accept_backlog", "",
-                            cxxopts::value<int>()->default_value(
-                                "0"))("n_invalid_words", "",
-                                      cxxopts::value<int>()->default_value(
-                                          "0"))("logging", "",
-                                                cxxopts::value<int>()
-                                                    ->default_value("1"));
+  options.add_options()
+      ("host", "", cxxopts::value<std::string>()->default_value("0.0.0.0"))
+      ("port", "", cxxopts::value<int>())
+      ("threads", "", cxxopts::value<int>()->default_value("0"))
+      ("accept_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("server_mode", "",
+          cxxopts::value<std::string>()->default_value("threaded"))
+      ("io_threads", "", cxxopts::value<int>()->default_value("1"))
+      ("numa_node", "", cxxopts::value<int>()->default_value("-1"))
+      ("thread_stack_size", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_in_flight", "",
+          cxxopts::value<int>()->default_value("0"))
+      ("admission_max_backlog", "", cxxopts::value<int>()->default_value("0"))
+      ("admission_max_wait_ms", "", cxxopts::value<int>()->default_value("0"))
+      ("n_invalid_words", "", cxxopts::value<int>()->default_value("0"))
+      ("logging", "", cxxopts::value<int>()->default_value("1"));
 
   // Parse command-line arguments.
   auto result = options.parse(argc, argv);
@@ -71,21 +76,31 @@ int main(int argc, char** argv) {
   int port = result["port"].as<int>();
   int threads = result["threads"].as<int>();
   int acceptBacklog = result["accept_backlog"].as<int>();
+  std::string server_mode = result["server_mode"].as<std::string>();
+  int io_threads = result["io_threads"].as<int>();
+  int numa_node = result["numa_node"].as<int>();
+  int thread_stack_size = result["thread_stack_size"].as<int>();
+  int admission_max_in_flight = result["admission_max_in_flight"].as<int>();
+  int admission_max_backlog = result["admission_max_backlog"].as<int>();
+  int admission_max_wait_ms = result["admission_max_wait_ms"].as<int>();
   int n_invalid_words = result["n_invalid_words"].as<int>();
   int logging = result["logging"].as<int>();
 
   // Create server.
-  auto socket = std::make_shared<TServerSocket>(host, port);
-  if (acceptBacklog > 0) socket->setAcceptBacklog(acceptBacklog);
-  TThreadedServer server(std::make_shared<TWordfilterServiceProcessor>(
-                             std::make_shared<TWordfilterServiceHandler>(
-                                 n_invalid_words, logging)),
-                         socket, std::make_shared<TBufferedTransportFactory>(),
-                         std::make_shared<TBinaryProtocolFactory>());
-  if (threads > 0) server.setConcurrentClientLimit(threads);
+  set_thread_stack_size(thread_stack_size);
+  AdmissionController::configure(admission_max_in_flight, admission_max_backlog,
+                                 admission_max_wait_ms, logging);
+  auto server = build_server(
+      server_mode,
+      [&] {
+        return std::make_shared<TWordfilterServiceProcessor>(
+            std::make_shared<TWordfilterServiceHandler>(
+                n_invalid_words, logging));
+      },
+      host, port, threads, io_threads, acceptBacklog, numa_node);
 
   // Serve requests.
-  server.serve();
+  server->serve();
 
   return 0;
 }
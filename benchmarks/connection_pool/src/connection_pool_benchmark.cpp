@@ -0,0 +1,178 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#include <buzzblog/lockfree_connection_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cxxopts.hpp>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Stand-in for a connection, so that the benchmark measures only the pool.
+class Connection {
+ public:
+  void close() {}
+};
+
+/* Pool with a global mutex and a queue of shared pointers, as used by
+ * MicroserviceConnectionPool and PostgresConnectionPool before
+ * LockFreeConnectionPool.
+ */
+class MutexConnectionPool {
+ private:
+  int _pool_current_size;
+  int _pool_min_size;
+  int _pool_max_size;
+  int _backlog_len;
+  bool _allow_ephemeral;
+  std::queue<std::shared_ptr<Connection>> _conn_pool;
+  std::mutex _conn_pool_mutex;
+  std::condition_variable _conn_pool_condition;
+
+ public:
+  MutexConnectionPool(const int pool_min_size, const int pool_max_size,
+                      const bool allow_ephemeral) {
+    _pool_min_size = pool_min_size;
+    _pool_max_size = pool_max_size;
+    _allow_ephemeral = allow_ephemeral;
+    _pool_current_size = 0;
+    _backlog_len = 0;
+  }
+
+  std::shared_ptr<Connection> get_client() {
+    std::shared_ptr<Connection> conn = nullptr;
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    if (_pool_current_size < _pool_min_size) {
+      _pool_current_size++;
+    } else if (_conn_pool.size() > 0) {
+      conn = _conn_pool.front();
+      _conn_pool.pop();
+    } else if (_pool_current_size < _pool_max_size || _allow_ephemeral) {
+      _pool_current_size++;
+    } else {
+      ++_backlog_len;
+      while (_conn_pool.empty()) _conn_pool_condition.wait(lock);
+      _backlog_len--;
+      conn = _conn_pool.front();
+      _conn_pool.pop();
+    }
+    lock.unlock();
+    if (conn == nullptr) conn = std::make_shared<Connection>();
+    return conn;
+  }
+
+  void release_client(std::shared_ptr<Connection> conn) {
+    std::unique_lock<std::mutex> lock(_conn_pool_mutex);
+    if (_pool_current_size > _pool_max_size ||
+        (_pool_current_size > _pool_min_size && _conn_pool.size() > 1)) {
+      conn->close();
+      _pool_current_size--;
+    } else {
+      _conn_pool.push(conn);
+      _conn_pool_condition.notify_one();
+    }
+  }
+};
+
+// Keeps a connection busy for `hold_us` microseconds.
+void hold(const int hold_us) {
+  if (hold_us <= 0) return;
+  auto end_time =
+      std::chrono::steady_clock::now() + std::chrono::microseconds(hold_us);
+  while (std::chrono::steady_clock::now() < end_time)
+    ;
+}
+
+/* Runs `threads` threads that lease and release connections back-to-back for
+ * `duration` seconds, and prints throughput and lease latency percentiles.
+ */
+template <typename Lease>
+void run(const std::string& label, const int threads, const int duration,
+         const int hold_us, Lease lease) {
+  std::vector<std::vector<double>> latencies(threads);
+  std::atomic<bool> started(false);
+  auto end_time = std::chrono::steady_clock::now() +
+                  std::chrono::seconds(duration) + std::chrono::seconds(1);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back([&, i] {
+      while (!started.load()) std::this_thread::yield();
+      while (std::chrono::steady_clock::now() < end_time) {
+        auto start_time = std::chrono::steady_clock::now();
+        lease([&] {
+          std::chrono::duration<double> latency =
+              std::chrono::steady_clock::now() - start_time;
+          latencies[i].push_back(latency.count());
+          hold(hold_us);
+        });
+      }
+    });
+  }
+  end_time = std::chrono::steady_clock::now() + std::chrono::seconds(duration);
+  started = true;
+  for (auto& worker : workers) worker.join();
+
+  std::vector<double> all_latencies;
+  for (const auto& thread_latencies : latencies)
+    all_latencies.insert(all_latencies.end(), thread_latencies.begin(),
+                         thread_latencies.end());
+  std::sort(all_latencies.begin(), all_latencies.end());
+  auto percentile = [&](double p) {
+    if (all_latencies.empty()) return 0.0;
+    return all_latencies[std::min(all_latencies.size() - 1,
+                                  size_t(p * all_latencies.size()))] *
+           1000000;
+  };
+  std::cout << std::fixed << std::setprecision(3) << "pool=" << label
+            << " threads=" << threads << " leases=" << all_latencies.size()
+            << " throughput=" << all_latencies.size() / double(duration)
+            << "leases/s p50=" << percentile(0.50)
+            << "us p99=" << percentile(0.99)
+            << "us p999=" << percentile(0.999) << "us" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  // Define command-line parameters.
+  cxxopts::Options options("connection_pool_benchmark",
+                           "Contention microbenchmark for connection pools");
+  options.add_options()
+      ("threads", "", cxxopts::value<int>()->default_value("1024"))
+      ("duration", "", cxxopts::value<int>()->default_value("10"))
+      ("pool_min_size", "", cxxopts::value<int>()->default_value("32"))
+      ("pool_max_size", "", cxxopts::value<int>()->default_value("128"))
+      ("hold_us", "", cxxopts::value<int>()->default_value("0"));
+
+  // Parse command-line arguments.
+  auto result = options.parse(argc, argv);
+  int threads = result["threads"].as<int>();
+  int duration = result["duration"].as<int>();
+  int pool_min_size = result["pool_min_size"].as<int>();
+  int pool_max_size = result["pool_max_size"].as<int>();
+  int hold_us = result["hold_us"].as<int>();
+
+  MutexConnectionPool mutex_pool(pool_min_size, pool_max_size, false);
+  run("mutex", threads, duration, hold_us, [&](auto use) {
+    auto conn = mutex_pool.get_client();
+    use();
+    mutex_pool.release_client(conn);
+  });
+
+  LockFreeConnectionPool<Connection> lockfree_pool(
+      pool_min_size, pool_max_size, false,
+      [] { return std::make_unique<Connection>(); });
+  run("lockfree", threads, duration, hold_us, [&](auto use) {
+    auto conn = lockfree_pool.lease();
+    use();
+  });
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+// Systems
+
+#include <buzzblog/wordfilter_client.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv) {
+  // Define command-line parameters.
+  cxxopts::Options options("server_mode_benchmark",
+                           "Closed-loop load generator for server modes");
+  options.add_options()
+      ("host", "", cxxopts::value<std::string>()->default_value("localhost"))
+      ("port", "", cxxopts::value<int>()->default_value("9096"))
+      ("framed", "", cxxopts::value<int>()->default_value("0"))
+      ("connections", "", cxxopts::value<int>()->default_value("512"))
+      ("duration", "", cxxopts::value<int>()->default_value("30"))
+      ("label", "", cxxopts::value<std::string>()->default_value(""));
+
+  // Parse command-line arguments.
+  auto result = options.parse(argc, argv);
+  std::string host = result["host"].as<std::string>();
+  int port = result["port"].as<int>();
+  bool framed = result["framed"].as<int>() != 0;
+  int connections = result["connections"].as<int>();
+  int duration = result["duration"].as<int>();
+  std::string label = result["label"].as<std::string>();
+
+  // Each client thread owns one connection and sends requests back-to-back
+  // until the benchmark ends, recording the latency of every request.
+  std::vector<std::vector<double>> latencies(connections);
+  std::atomic<int> n_errors(0);
+  auto end_time =
+      std::chrono::steady_clock::now() + std::chrono::seconds(duration);
+  std::vector<std::thread> clients;
+  for (int i = 0; i < connections; i++) {
+    clients.emplace_back([&, i] {
+      try {
+        wordfilter_service::Client client(host, port, 30000, framed);
+        TRequestMetadata request_metadata;
+        request_metadata.id = "benchmark";
+        while (std::chrono::steady_clock::now() < end_time) {
+          auto start_time = std::chrono::steady_clock::now();
+          client.is_valid_word(request_metadata, "foobar");
+          std::chrono::duration<double> latency =
+              std::chrono::steady_clock::now() - start_time;
+          latencies[i].push_back(latency.count());
+        }
+      } catch (...) {
+        n_errors++;
+      }
+    });
+  }
+  for (auto& client : clients) client.join();
+
+  // Report throughput and latency percentiles.
+  std::vector<double> all_latencies;
+  for (const auto& thread_latencies : latencies)
+    all_latencies.insert(all_latencies.end(), thread_latencies.begin(),
+                         thread_latencies.end());
+  if (all_latencies.empty()) {
+    std::cout << "mode=" << label << " errors=" << n_errors.load()
+              << " requests=0" << std::endl;
+    return 1;
+  }
+  std::sort(all_latencies.begin(), all_latencies.end());
+  auto percentile = [&](double p) {
+    return all_latencies[std::min(all_latencies.size() - 1,
+                                  size_t(p * all_latencies.size()))] *
+           1000;
+  };
+  std::cout << std::fixed << std::setprecision(3) << "mode=" << label
+            << " connections=" << connections
+            << " requests=" << all_latencies.size()
+            << " errors=" << n_errors.load()
+            << " throughput=" << all_latencies.size() / double(duration)
+            << "req/s p50=" << percentile(0.50) << "ms p99=" << percentile(0.99)
+            << "ms p999=" << percentile(0.999) << "ms" << std::endl;
+
+  return 0;
+}
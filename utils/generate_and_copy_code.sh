@@ -60,7 +60,20 @@ do
   cp app/common/include/redis_connected_server.h app/$service/service/server/include/buzzblog
   cp app/common/include/microservice_connection_pool.h app/$service/service/server/include/buzzblog
   cp app/common/include/postgres_connection_pool.h app/$service/service/server/include/buzzblog
+  cp app/common/include/postgres_pipeline.h app/$service/service/server/include/buzzblog
+  cp app/common/include/group_commit.h app/$service/service/server/include/buzzblog
+  cp app/common/include/id_generator.h app/$service/service/server/include/buzzblog
+  cp app/common/include/lockfree_connection_pool.h app/$service/service/server/include/buzzblog
+  cp app/common/include/deadline.h app/$service/service/server/include/buzzblog
+  cp app/common/include/admission_control.h app/$service/service/server/include/buzzblog
   cp app/common/include/base_client.h app/$service/service/server/include/buzzblog
+  cp app/common/include/thrift_server.h app/$service/service/server/include/buzzblog
+  cp app/common/include/executor.h app/$service/service/server/include/buzzblog
+  cp app/common/include/async_rpc.h app/$service/service/server/include/buzzblog
+  cp app/common/include/async_connection_pool.h app/$service/service/server/include/buzzblog
+  cp app/common/include/async_postgres_connection_pool.h app/$service/service/server/include/buzzblog
+  cp app/common/include/slow_query_log.h app/$service/service/server/include/buzzblog
+  cp app/common/include/shard.h app/$service/service/server/include/buzzblog
   cp app/common/site-packages/base_client.py app/$service/service/tests/site-packages/buzzblog
 done
 
@@ -75,3 +88,28 @@ do
   cp app/$service/service/client/src/*.py app/apigateway/server/site-packages/buzzblog
   cp app/$service/service/client/src/*.py app/apigateway/tests/site-packages/buzzblog
 done
+
+# Copy benchmark client libraries.
+rm -rf benchmarks/server_mode/include
+mkdir -p benchmarks/server_mode/include/buzzblog/gen
+thrift -r --gen cpp -out benchmarks/server_mode/include/buzzblog/gen app/common/thrift/buzzblog.thrift
+cp app/common/include/base_client.h benchmarks/server_mode/include/buzzblog
+cp app/wordfilter/service/client/src/wordfilter_client.h benchmarks/server_mode/include/buzzblog
+rm -rf benchmarks/connection_pool/include
+mkdir -p benchmarks/connection_pool/include/buzzblog
+cp app/common/include/lockfree_connection_pool.h benchmarks/connection_pool/include/buzzblog
+cp app/common/include/deadline.h benchmarks/connection_pool/include/buzzblog
+rm -rf benchmarks/postgres_pipeline/include
+mkdir -p benchmarks/postgres_pipeline/include/buzzblog
+cp app/common/include/postgres_pipeline.h benchmarks/postgres_pipeline/include/buzzblog
+rm -rf benchmarks/post_feed/include
+mkdir -p benchmarks/post_feed/include/buzzblog
+cp app/common/include/id_generator.h benchmarks/post_feed/include/buzzblog
+cp app/common/include/deadline.h benchmarks/post_feed/include/buzzblog
+rm -rf benchmarks/query_plan/include benchmarks/query_plan/schemas
+mkdir -p benchmarks/query_plan/include/buzzblog benchmarks/query_plan/schemas
+cp app/common/include/id_generator.h benchmarks/query_plan/include/buzzblog
+cp app/common/include/deadline.h benchmarks/query_plan/include/buzzblog
+cp app/common/include/postgres_pipeline.h benchmarks/query_plan/include/buzzblog
+cp app/post/database/post_schema.sql benchmarks/query_plan/schemas
+cp app/uniquepair/database/uniquepair_schema.sql benchmarks/query_plan/schemas
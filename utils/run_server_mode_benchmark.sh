@@ -0,0 +1,92 @@
+#!/bin/bash
+
+# Copyright (C) 2022 Georgia Tech Center for Experimental Research in Computer
+# Systems
+
+# This script compares the throughput and tail latency of the Thrift server
+# modes ("threaded", "threadpool", and "nonblocking"). For each mode, it starts
+# a Wordfilter Service container and drives it with a closed-loop load
+# generator that keeps one outstanding request per connection.
+
+# Change to the parent directory.
+cd "$(dirname "$(dirname "$(readlink -fm "$0")")")"
+
+# Process command-line arguments.
+set -u
+connections=512
+duration=30
+threads=64
+while [[ $# > 1 ]]; do
+  case $1 in
+    --connections )
+      connections=$2
+      ;;
+    --duration )
+      duration=$2
+      ;;
+    --threads )
+      threads=$2
+      ;;
+    * )
+      echo "Invalid argument: $1"
+      exit 1
+  esac
+  shift
+  shift
+done
+
+# Generate Thrift code and copy service client libraries.
+utils/generate_and_copy_code.sh
+
+# Build the Docker images.
+cd app/wordfilter/service/server
+docker build -t wordfilter:latest .
+cd ../../../..
+cd benchmarks/server_mode
+docker build -t server_mode_benchmark:latest .
+cd ../..
+
+for server_mode in threaded threadpool nonblocking
+do
+  # In threaded mode, there is one server thread per connection. In the other
+  # modes, a fixed number of worker threads serve all connections (thread pool
+  # workers are pinned to connections, so they must cover all of them).
+  if [[ $server_mode == "threaded" ]]; then
+    server_threads=0
+  elif [[ $server_mode == "threadpool" ]]; then
+    server_threads=$connections
+  else
+    server_threads=$threads
+  fi
+  if [[ $server_mode == "nonblocking" ]]; then
+    framed=1
+  else
+    framed=0
+  fi
+  docker run \
+      --name wordfilter_service \
+      --publish 9096:9096 \
+      --env port=9096 \
+      --env threads=$server_threads \
+      --env accept_backlog=1024 \
+      --env server_mode=$server_mode \
+      --env io_threads=4 \
+      --env thread_stack_size=256 \
+      --env n_invalid_words=128 \
+      --env logging=0 \
+      --detach \
+      wordfilter:latest
+  sleep 4
+  docker run \
+      --rm \
+      --network host \
+      server_mode_benchmark:latest \
+      --host localhost \
+      --port 9096 \
+      --framed $framed \
+      --connections $connections \
+      --duration $duration \
+      --label $server_mode
+  docker container stop wordfilter_service
+  docker container rm wordfilter_service
+done
@@ -82,6 +82,7 @@ docker run \
     --env postgres_connection_pool_allow_ephemeral=1 \
     --env postgres_user=postgres \
     --env postgres_password=postgres \
+    --env node_id=0 \
     --env logging=1 \
     --volume $(pwd)/conf/backend.yml:/etc/opt/BuzzBlog/backend.yml \
     --detach \
@@ -159,6 +160,7 @@ docker run \
     --env postgres_connection_pool_allow_ephemeral=1 \
     --env postgres_user=postgres \
     --env postgres_password=postgres \
+    --env node_id=0 \
     --env logging=1 \
     --volume $(pwd)/conf/backend.yml:/etc/opt/BuzzBlog/backend.yml \
     --detach \
@@ -195,6 +197,7 @@ docker run \
     --env postgres_connection_pool_allow_ephemeral=1 \
     --env postgres_user=postgres \
     --env postgres_password=postgres \
+    --env node_id=0 \
     --env logging=1 \
     --volume $(pwd)/conf/backend.yml:/etc/opt/BuzzBlog/backend.yml \
     --detach \